@@ -21,13 +21,33 @@ INCLUDEPATH += $$PWD/src/gui_qt
 # For OpenCV.
 LIBS += -lopencv_core -lopencv_imgproc -lopencv_highgui
 
+# For FFmpeg, which decodes the videos' audio.
+LIBS += -lavformat -lavcodec -lavutil
+
 SOURCES +=  src/main.cpp \
+    src/common.cpp \
     src/video/video_activity.cpp \
+    src/video/video_decoder.cpp \
+    src/video/motion_detector.cpp \
+    src/video/video_probe.cpp \
+    src/video/packet_prefilter.cpp \
+    src/video/analysis_stats.cpp \
+    src/video/activity_mask.cpp \
+    src/video/thumbnail_sheet.cpp \
+    src/video/segment_exporter.cpp \
+    src/video/stream_activity.cpp \
+    src/video/frame_diff.cpp \
+    src/video/activity_cache.cpp \
+    src/video/activity_timeline.cpp \
+    src/video/analysis_queue.cpp \
     src/video/video_object.cpp \
     src/video/video_info.cpp \
     src/video/video_player.cpp \
     src/audio/audio_file.cpp \
+    src/audio/audio_decoder.cpp \
     src/gui_qt/qt_main_window.cpp \
+    src/gui_qt/qt_thresholds_dialog.cpp \
+    src/gui_qt/qt_mask_overlay.cpp \
     src/messager/messager.cpp \
     src/gui_qt/qt_activity_strip.cpp
 
@@ -36,10 +56,27 @@ HEADERS  +=  src/common.h \
     src/video/video_player.h \
     src/video/video_info.h \
     src/video/video_activity.h \
+    src/video/video_decoder.h \
+    src/video/motion_detector.h \
+    src/video/video_probe.h \
+    src/video/packet_prefilter.h \
+    src/video/analysis_stats.h \
+    src/video/activity_mask.h \
+    src/video/thumbnail_sheet.h \
+    src/video/segment_exporter.h \
+    src/video/stream_activity.h \
+    src/video/frame_diff.h \
+    src/video/activity_cache.h \
+    src/video/activity_timeline.h \
+    src/video/analysis_queue.h \
     src/video/video_object.h \
     src/audio/audio_file.h \
+    src/audio/audio_decoder.h \
     src/gui_qt/qt_main_window.h \
+    src/gui_qt/qt_thresholds_dialog.h \
+    src/gui_qt/qt_mask_overlay.h \
     src/messager/messager.h \
+    src/messager/message_sink.h \
     src/gui_qt/qt_activity_strip.h
 
 FORMS    += \
@@ -49,6 +86,7 @@ FORMS    += \
 QMAKE_CXXFLAGS += -g
 QMAKE_CXXFLAGS += -ansi
 QMAKE_CXXFLAGS += -O2
+QMAKE_CXXFLAGS += -ftree-vectorize
 QMAKE_CXXFLAGS += -Wall
 QMAKE_CXXFLAGS += -pipe
 QMAKE_CXXFLAGS += -pedantic
@@ -0,0 +1,72 @@
+#-------------------------------------------------
+#
+# The command-line analysis tool. Builds only the analysis engine, with no
+# dependency on Qt's GUI or multimedia modules.
+#
+#-------------------------------------------------
+
+QT       = core concurrent
+
+TARGET = avscissors-cli
+TEMPLATE = app
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+OBJECTS_DIR = generated_files/cli
+MOC_DIR = generated_files/cli
+
+# For OpenCV.
+LIBS += -lopencv_core -lopencv_imgproc -lopencv_highgui
+
+# For FFmpeg, which decodes the videos' audio.
+LIBS += -lavformat -lavcodec -lavutil
+
+SOURCES +=  src/cli/cli_main.cpp \
+    src/cli/console.cpp \
+    src/common.cpp \
+    src/video/video_activity.cpp \
+    src/video/video_decoder.cpp \
+    src/video/motion_detector.cpp \
+    src/video/video_probe.cpp \
+    src/video/packet_prefilter.cpp \
+    src/video/analysis_stats.cpp \
+    src/video/activity_mask.cpp \
+    src/video/thumbnail_sheet.cpp \
+    src/video/segment_exporter.cpp \
+    src/video/stream_activity.cpp \
+    src/video/frame_diff.cpp \
+    src/video/activity_cache.cpp \
+    src/video/activity_timeline.cpp \
+    src/video/video_info.cpp \
+    src/audio/audio_file.cpp \
+    src/audio/audio_decoder.cpp
+
+HEADERS  +=  src/common.h \
+    src/cli/console.h \
+    src/types.h \
+    src/messager/message_sink.h \
+    src/video/video_info.h \
+    src/video/video_activity.h \
+    src/video/video_decoder.h \
+    src/video/motion_detector.h \
+    src/video/video_probe.h \
+    src/video/packet_prefilter.h \
+    src/video/analysis_stats.h \
+    src/video/activity_mask.h \
+    src/video/thumbnail_sheet.h \
+    src/video/segment_exporter.h \
+    src/video/stream_activity.h \
+    src/video/frame_diff.h \
+    src/video/activity_cache.h \
+    src/video/activity_timeline.h \
+    src/audio/audio_file.h \
+    src/audio/audio_decoder.h
+
+# C++. For GCC/Clang.
+QMAKE_CXXFLAGS += -g
+QMAKE_CXXFLAGS += -ansi
+QMAKE_CXXFLAGS += -O2
+QMAKE_CXXFLAGS += -ftree-vectorize
+QMAKE_CXXFLAGS += -Wall
+QMAKE_CXXFLAGS += -pipe
+QMAKE_CXXFLAGS += -pedantic
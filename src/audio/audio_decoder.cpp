@@ -0,0 +1,221 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors.
+ *
+ * Decodes the audio track of a media file in-process via FFmpeg's libraries,
+ * streaming the samples out in chunks as signed 16-bit mono. Nothing is written
+ * to disk, and no more than one decoded frame's worth of samples is held at a
+ * time.
+ *
+ */
+
+extern "C"
+{
+    #include <libavformat/avformat.h>
+    #include <libavcodec/avcodec.h>
+    #include <libavutil/avutil.h>
+}
+
+#include <algorithm>
+#include "../../src/audio/audio_decoder.h"
+#include "../../src/common.h"
+
+// The number of audio channels in the given frame. The channel layout API got
+// reworked in newer versions of FFmpeg.
+//
+static int num_channels(const AVFrame *const frame)
+{
+    #if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(57, 28, 100)
+        return frame->ch_layout.nb_channels;
+    #else
+        return frame->channels;
+    #endif
+}
+
+// Returns the given sample of the given channel as a value in the range of a
+// signed 16-bit integer.
+//
+static int sample_as_i16(const AVFrame *const frame, const int channel, const int sampleIdx)
+{
+    const int numChannels = num_channels(frame);
+    const AVSampleFormat format = AVSampleFormat(frame->format);
+    const bool isPlanar = av_sample_fmt_is_planar(format);
+    const u8 *const plane = frame->extended_data[isPlanar? channel : 0];
+    const int idx = (isPlanar? sampleIdx : ((sampleIdx * numChannels) + channel));
+
+    switch (format)
+    {
+        case AV_SAMPLE_FMT_U8:
+        case AV_SAMPLE_FMT_U8P:  return ((int(plane[idx]) - 128) << 8);
+        case AV_SAMPLE_FMT_S16:
+        case AV_SAMPLE_FMT_S16P: return ((const i16*)plane)[idx];
+        case AV_SAMPLE_FMT_S32:
+        case AV_SAMPLE_FMT_S32P: return (((const i32*)plane)[idx] >> 16);
+        case AV_SAMPLE_FMT_FLT:
+        case AV_SAMPLE_FMT_FLTP: return int(std::max(-1.0f, std::min(1.0f, ((const float*)plane)[idx])) * 32767);
+        case AV_SAMPLE_FMT_DBL:
+        case AV_SAMPLE_FMT_DBLP: return int(std::max(-1.0, std::min(1.0, ((const double*)plane)[idx])) * 32767);
+        default: k_assert(0, "Unsupported audio sample format."); return 0;
+    }
+}
+
+audio_decoder_c::audio_decoder_c(const QString &filename)
+{
+    #if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58, 9, 100)
+        av_register_all();
+    #endif
+
+    if (avformat_open_input(&this->formatContext, filename.toUtf8().constData(), nullptr, nullptr) < 0)
+    {
+        NBENE(("Failed to open '%s' for audio decoding.", filename.toUtf8().constData()));
+        this->formatContext = nullptr;
+        return;
+    }
+
+    if (avformat_find_stream_info(this->formatContext, nullptr) < 0)
+    {
+        NBENE(("Failed to find stream information in '%s'.", filename.toUtf8().constData()));
+        return;
+    }
+
+    this->streamIdx = av_find_best_stream(this->formatContext, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
+    if (this->streamIdx < 0)
+    {
+        INFO(("No audio stream found in '%s'.", filename.toUtf8().constData()));
+        return;
+    }
+
+    // Open a decoder for the audio stream.
+    {
+        const AVCodecParameters *const codecParams = this->formatContext->streams[this->streamIdx]->codecpar;
+        const AVCodec *const codec = avcodec_find_decoder(codecParams->codec_id);
+
+        if (codec == nullptr)
+        {
+            NBENE(("No decoder available for the audio stream in '%s'.", filename.toUtf8().constData()));
+            this->streamIdx = -1;
+            return;
+        }
+
+        this->codecContext = avcodec_alloc_context3(codec);
+
+        if ((this->codecContext == nullptr) ||
+            (avcodec_parameters_to_context(this->codecContext, codecParams) < 0) ||
+            (avcodec_open2(this->codecContext, codec, nullptr) < 0))
+        {
+            NBENE(("Failed to open the audio decoder for '%s'.", filename.toUtf8().constData()));
+            avcodec_free_context(&this->codecContext);
+            this->streamIdx = -1;
+            return;
+        }
+    }
+
+    // Let the demuxer drop packets of streams we're not interested in.
+    for (uint i = 0; i < this->formatContext->nb_streams; i++)
+    {
+        if (int(i) != this->streamIdx)
+        {
+            this->formatContext->streams[i]->discard = AVDISCARD_ALL;
+        }
+    }
+
+    return;
+}
+
+audio_decoder_c::~audio_decoder_c()
+{
+    avcodec_free_context(&this->codecContext);
+    avformat_close_input(&this->formatContext);
+
+    return;
+}
+
+bool audio_decoder_c::is_valid() const
+{
+    return bool(this->codecContext != nullptr);
+}
+
+uint audio_decoder_c::sample_rate() const
+{
+    k_assert(this->is_valid(), "Was asked for the sample rate of an invalid audio stream.");
+
+    return this->codecContext->sample_rate;
+}
+
+// Decodes the audio stream from start to end, passing the decoded samples to the
+// given sink as they come. Returns false if decoding failed or was stopped by the
+// sink before reaching the end of the stream.
+//
+bool audio_decoder_c::decode(const audio_sample_sink_f &sampleSink)
+{
+    k_assert(this->is_valid(), "Was asked to decode an invalid audio stream.");
+
+    AVPacket *packet = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+    bool keepGoing = true;
+    bool streamEnded = false;
+
+    k_assert(((packet != nullptr) && (frame != nullptr)), "Failed to allocate memory for audio decoding.");
+
+    while (keepGoing && !streamEnded)
+    {
+        // Feed the decoder with the stream's next packet; or, at the end of the
+        // stream, with a null packet so that it'll flush out what it has left.
+        const int readRet = av_read_frame(this->formatContext, packet);
+        if (readRet < 0)
+        {
+            avcodec_send_packet(this->codecContext, nullptr);
+            streamEnded = true;
+        }
+        else
+        {
+            if (packet->stream_index == this->streamIdx)
+            {
+                avcodec_send_packet(this->codecContext, packet);
+            }
+
+            av_packet_unref(packet);
+        }
+
+        while (keepGoing && (avcodec_receive_frame(this->codecContext, frame) == 0))
+        {
+            keepGoing = this->pass_frame_to_sink(frame, sampleSink);
+            av_frame_unref(frame);
+        }
+    }
+
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+
+    return keepGoing;
+}
+
+// Down-mixes the given frame's samples into mono and hands them to the sink.
+// Returns the sink's verdict on whether to continue decoding.
+//
+bool audio_decoder_c::pass_frame_to_sink(const AVFrame *const frame, const audio_sample_sink_f &sampleSink)
+{
+    const int numChannels = num_channels(frame);
+
+    if ((numChannels <= 0) ||
+        (frame->nb_samples <= 0))
+    {
+        return true;
+    }
+
+    this->monoSamples.resize(frame->nb_samples);
+
+    for (int i = 0; i < frame->nb_samples; i++)
+    {
+        int sum = 0;
+
+        for (int c = 0; c < numChannels; c++)
+        {
+            sum += sample_as_i16(frame, c, i);
+        }
+
+        this->monoSamples[i] = i16(sum / numChannels);
+    }
+
+    return sampleSink(this->monoSamples.constData(), this->monoSamples.size());
+}
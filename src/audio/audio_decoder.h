@@ -0,0 +1,47 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors.
+ *
+ */
+
+#ifndef AUDIO_DECODER_H
+#define AUDIO_DECODER_H
+
+#include <QVector>
+#include <QString>
+#include <functional>
+#include "../../src/types.h"
+
+struct AVFormatContext;
+struct AVCodecContext;
+struct AVFrame;
+
+// Receives chunks of decoded mono samples. Return false to stop decoding.
+typedef std::function<bool(const i16 *const samples, const uint numSamples)> audio_sample_sink_f;
+
+class audio_decoder_c
+{
+public:
+    audio_decoder_c(const QString &filename);
+    ~audio_decoder_c(void);
+
+    bool is_valid(void) const;
+
+    uint sample_rate(void) const;
+
+    bool decode(const audio_sample_sink_f &sampleSink);
+
+private:
+    bool pass_frame_to_sink(const AVFrame *const frame, const audio_sample_sink_f &sampleSink);
+
+    AVFormatContext *formatContext = nullptr;
+    AVCodecContext *codecContext = nullptr;
+
+    // The index in the container of the audio stream we're decoding.
+    int streamIdx = -1;
+
+    // Decoded samples get down-mixed into here before being passed on.
+    QVector<i16> monoSamples;
+};
+
+#endif
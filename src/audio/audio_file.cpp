@@ -8,22 +8,35 @@
  * does with the options "-flags bitexact -map_metadata -1 -acodec pcm_s16le -ac 1" should
  * work.
  *
+ * Files of more than 4 GB of samples, whose sizes don't fit the 32-bit fields of
+ * a plain WAV file, are read either as RF64, or - as written by encoders that
+ * don't know the size in advance - with the data chunk taken to run to the end
+ * of the file.
+ *
+ * Only the file's headers are read in up front. The sample data is by default then
+ * memory-mapped rather than loaded, so that even very long audio tracks don't need
+ * to be held in memory in full.
+ *
  */
 
-#include <QByteArray>
+#include <QtEndian>
 #include <QDebug>
 #include <QFile>
-#include "../../src/messager/messager.h"
+#include <cstring>
+#include <algorithm>
+#include "../../src/messager/message_sink.h"
 #include "../../src/audio/audio_file.h"
 #include "../../src/common.h"
 
-audio_file_c::audio_file_c(const QString audioFilename, const messager_c *const messager) :
-    filename(audioFilename)
+audio_file_c::audio_file_c(const QString audioFilename, const message_sink_c *const messager,
+                           const access_mode_e accessMode) :
+    filename(audioFilename),
+    file(audioFilename)
 {
     connect(    this, &audio_file_c::message_to_user,
-            messager, &messager_c::new_message);
+            messager, &message_sink_c::new_message);
 
-    this->extract_audio_data();
+    this->extract_audio_data(accessMode);
 
     return;
 }
@@ -35,103 +48,191 @@ audio_file_c::~audio_file_c()
         delete [] this->waveform;
     }
 
+    if (this->mappedData != nullptr)
+    {
+        this->file.unmap(this->mappedData);
+    }
+
     return;
 }
 
-// Expects a WAV file.
+// Copies up to the given number of samples, starting from the given offset, into
+// the given buffer. Returns the number of samples copied.
 //
-void audio_file_c::extract_audio_data(void)
+uint audio_file_c::read_samples(const u64 offs, const uint count, i16 *const dst) const
 {
-    QFile file(this->filename);
-    if (!file.open(QIODevice::ReadOnly))
+    k_assert(this->has_valid_audio_data(), "Was asked to read samples from an invalid audio file.");
+
+    if (offs >= this->numSamples)
     {
-        emit message_to_user("Could not read the audio data.");
-        NBENE(("Failed to open audio file '%s'", this->filename.toLatin1().constData()));
-        return;
+        return 0;
     }
 
-    QByteArray fileData = file.readAll();
-    if (fileData.isEmpty())
+    const uint numToRead = uint(std::min(u64(count), (this->numSamples - offs)));
+    memcpy(dst, (this->samples + offs), (numToRead * sizeof(i16)));
+
+    return numToRead;
+}
+
+// Expects a WAV file.
+//
+void audio_file_c::extract_audio_data(const access_mode_e accessMode)
+{
+    if (!this->file.open(QIODevice::ReadOnly))
     {
         emit message_to_user("Could not read the audio data.");
-        NBENE(("Failed to load audio data from '%s'", this->filename.toLatin1().constData()));
+        NBENE(("Failed to open audio file '%s'", this->filename.toLatin1().constData()));
         return;
     }
-    file.close();
 
-    // Parse the data.
-    /// TODO: Add some more checks and verification, e.g. that the RIFF chunk is
-    /// as we expect it to.
+    // Parse the headers, walking through the file's chunks until we find the
+    // sample data.
+    qint64 dataOffset = 0;
+    qint64 dataSize = 0;
     {
-        QDataStream dataStream(fileData);
+        // The 64-bit size of the data chunk, in RF64 files.
+        qint64 rf64DataSize = -1;
 
-        // Riff chunk.
+        char riffHeader[12];
+        if ((this->file.read(riffHeader, 12) != 12) ||
+            ((memcmp(riffHeader, "RIFF", 4) != 0) && (memcmp(riffHeader, "RF64", 4) != 0)) ||
+            (memcmp((riffHeader + 8), "WAVE", 4) != 0))
         {
-            if ((dataStream.skipRawData(4) == -1) ||    // Should be "RIFF".
-                (dataStream.skipRawData(4) == -1) ||    // Should be chunk size.
-                (dataStream.skipRawData(4) == -1))      // Should be "WAVE".
-            {
-                NBENE(("Failed when reading the audio RIFF chunk."));
-                emit message_to_user("Could not read the audio data.");
-                return;
-            }
+            NBENE(("Failed when reading the audio RIFF chunk."));
+            emit message_to_user("Could not read the audio data.");
+            return;
         }
 
-        // Fmt chunk.
+        bool haveFmtChunk = false;
+
+        while (true)
         {
-            if ((dataStream.skipRawData(4) == -1) ||    // Should be "fmt ".
-                (dataStream.skipRawData(4) == -1) ||    // Should be chunk size.
-                (dataStream.skipRawData(2) == -1) ||    // Should be audio format.
-                (dataStream.readRawData((char*)&this->numChannels, 2) == -1) ||
-                (dataStream.readRawData((char*)&this->sampleRate, 4) == -1) ||
-                (dataStream.skipRawData(4) == -1) ||    // Should be byte rate.
-                (dataStream.readRawData((char*)&this->blockAlign, 2) == -1) ||
-                (dataStream.readRawData((char*)&this->bitsPerSample, 2) == -1))
+            char chunkHeader[8];
+            if (this->file.read(chunkHeader, 8) != 8)
             {
-                NBENE(("Failed when reading the audio fmt chunk."));
+                NBENE(("Failed to find the audio data chunk."));
                 emit message_to_user("Could not read the audio data.");
                 return;
             }
 
-            // Assert some hard-coded assumptions we have about how the audio should be.
-            if ((this->numChannels != 1) ||     // Expect a mono audio file.
-                (this->bitsPerSample != 16))    // Expect 16-bit audio samples.
-            {
-                emit message_to_user("Could not read the audio data.");
-                return;
-            }
-        }
+            const qint64 chunkSize = qFromLittleEndian<quint32>((const uchar*)(chunkHeader + 4));
 
-        // Data chunk.
-        {
-            if ((dataStream.skipRawData(4) == -1) ||    // Should be "data".
-                (dataStream.readRawData((char*)&this->numSamples, 4) == -1))
+            if (memcmp(chunkHeader, "ds64", 4) == 0)
             {
-                NBENE(("Failed when reading the audio data chunk."));
-                emit message_to_user("Could not read the audio data.");
-                return;
-            }
+                uchar ds64[16];
+                if ((chunkSize < 16) ||
+                    (this->file.read((char*)ds64, 16) != 16))
+                {
+                    NBENE(("Failed when reading the audio ds64 chunk."));
+                    emit message_to_user("Could not read the audio data.");
+                    return;
+                }
 
-            // The actual sample data.
+                rf64DataSize = qint64(qFromLittleEndian<quint64>(ds64 + 8));
+                this->file.seek(this->file.pos() + (chunkSize - 16) + (chunkSize & 1));
+            }
+            else if (memcmp(chunkHeader, "fmt ", 4) == 0)
             {
-                this->numSamples /= this->blockAlign;
-                this->waveform = new short[this->numSamples];
-
-                if (dataStream.readRawData((char*)this->waveform, (this->numSamples * this->blockAlign)) == -1)
+                uchar fmt[16];
+                if ((chunkSize < 16) ||
+                    (this->file.read((char*)fmt, 16) != 16))
                 {
-                    NBENE(("Failed when reading the audio samples."));
+                    NBENE(("Failed when reading the audio fmt chunk."));
                     emit message_to_user("Could not read the audio data.");
+                    return;
+                }
 
-                    delete [] this->waveform;
-                    this->waveform = nullptr;
+                this->numChannels = qFromLittleEndian<qint16>(fmt + 2);
+                this->sampleRate = qFromLittleEndian<quint32>(fmt + 4);
+                this->blockAlign = qFromLittleEndian<qint16>(fmt + 12);
+                this->bitsPerSample = qFromLittleEndian<qint16>(fmt + 14);
 
+                // Assert some hard-coded assumptions we have about how the audio should be.
+                if ((this->numChannels != 1) ||     // Expect a mono audio file.
+                    (this->bitsPerSample != 16) ||  // Expect 16-bit audio samples.
+                    (this->blockAlign != ((this->numChannels * this->bitsPerSample) / 8)))
+                {
+                    NBENE(("Unsupported or malformed audio fmt chunk."));
+                    emit message_to_user("Could not read the audio data.");
+                    return;
+                }
+
+                haveFmtChunk = true;
+                this->file.seek(this->file.pos() + (chunkSize - 16) + (chunkSize & 1));
+            }
+            else if (memcmp(chunkHeader, "data", 4) == 0)
+            {
+                if (!haveFmtChunk)
+                {
+                    NBENE(("Found the audio data chunk before the fmt chunk."));
+                    emit message_to_user("Could not read the audio data.");
                     return;
                 }
+
+                dataOffset = this->file.pos();
+
+                // A size of 0xffffffff stands in for one that's too large for the
+                // field (with the actual size in the ds64 chunk for RF64), or that
+                // the encoder didn't know.
+                dataSize = (this->file.size() - dataOffset);
+                if (chunkSize != 0xffffffff)
+                {
+                    dataSize = std::min(chunkSize, dataSize);
+                }
+                else if (rf64DataSize >= 0)
+                {
+                    dataSize = std::min(rf64DataSize, dataSize);
+                }
+
+                break;
+            }
+            // Skip chunks we don't care about. Chunks are padded to an even size.
+            else
+            {
+                this->file.seek(this->file.pos() + chunkSize + (chunkSize & 1));
+            }
+        }
+    }
+
+    // Make the sample data available.
+    {
+        this->numSamples = u64(dataSize / this->blockAlign);
+
+        // Mapping requires the samples to be suitably aligned in the file.
+        const bool canMap = bool((accessMode == access_mode_e::MemoryMapped) &&
+                                 ((dataOffset % sizeof(i16)) == 0));
+
+        if (canMap)
+        {
+            this->mappedData = this->file.map(dataOffset, (qint64(this->numSamples) * this->blockAlign));
+        }
+
+        if (this->mappedData != nullptr)
+        {
+            this->samples = (const i16*)this->mappedData;
+        }
+        else
+        {
+            this->waveform = new i16[this->numSamples];
+
+            this->file.seek(dataOffset);
+            if (this->file.read((char*)this->waveform, (qint64(this->numSamples) * this->blockAlign)) != (qint64(this->numSamples) * this->blockAlign))
+            {
+                NBENE(("Failed when reading the audio samples."));
+                emit message_to_user("Could not read the audio data.");
+
+                delete [] this->waveform;
+                this->waveform = nullptr;
+
+                return;
             }
+
+            this->samples = this->waveform;
+            this->file.close();
         }
     }
 
-    this->durationMs = ((this->numSamples / (real)this->sampleRate) * 1000.0);
+    this->durationMs = u64((this->numSamples / (real)this->sampleRate) * 1000.0);
 
     return;
 }
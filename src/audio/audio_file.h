@@ -9,53 +9,74 @@
 
 #include <QObject>
 #include <QString>
+#include <QFile>
 #include "../../src/common.h"
 
-class messager_c;
+class message_sink_c;
 
 class audio_file_c : public QObject
 {
     Q_OBJECT
 
 public:
-    audio_file_c(const QString audioFilename, const messager_c *const messager);
+    // How the file's samples are made available once it's been opened.
+    enum class access_mode_e
+    {
+        InMemory,       // Read all of the samples into memory.
+        MemoryMapped,   // Map the file's sample data into memory, letting the OS page it in as it's accessed.
+    };
+
+    audio_file_c(const QString audioFilename, const message_sink_c *const messager,
+                 const access_mode_e accessMode = access_mode_e::MemoryMapped);
     ~audio_file_c(void);
 
-    uint num_samples(void) const
+    u64 num_samples(void) const
     {
         return this->numSamples;
     }
 
-    short sample_at(const uint offs) const
+    uint sample_rate(void) const
+    {
+        return this->sampleRate;
+    }
+
+    short sample_at(const u64 offs) const
     {
         k_assert(offs < numSamples, "Accessing audio data out of bounds.");
 
-        return waveform[offs];
+        return samples[offs];
     }
 
+    uint read_samples(const u64 offs, const uint count, i16 *const dst) const;
+
     bool has_valid_audio_data(void) const
     {
-        return bool(waveform != nullptr);
+        return bool(samples != nullptr);
     }
 
 signals:
     void message_to_user(const QString message);
 
 private:
-    void extract_audio_data();
+    void extract_audio_data(const access_mode_e accessMode);
 
     const QString filename;
 
-    // The raw audio samples. (Assumes them to be signed 16-bit.)
-    short *waveform = nullptr;
-    uint numSamples;
+    QFile file;
+
+    // The raw audio samples. (Assumes them to be signed 16-bit.) Points either to
+    // the waveform buffer or into the memory-mapped file.
+    const i16 *samples = nullptr;
+    i16 *waveform = nullptr;
+    uchar *mappedData = nullptr;
+    u64 numSamples = 0;
 
     // Properties of the audio stream.
-    uint durationMs;
-    short numChannels;
-    uint sampleRate;
-    short bitsPerSample;
-    short blockAlign;
+    u64 durationMs = 0;
+    short numChannels = 0;
+    uint sampleRate = 0;
+    short bitsPerSample = 0;
+    short blockAlign = 0;
 };
 
 #endif
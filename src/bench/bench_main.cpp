@@ -0,0 +1,416 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors
+ *
+ * A benchmark of AV Scissors' analysis engine, for tracking its throughput as the
+ * detectors, decoders and comparison kernels change. Runs the video and audio
+ * analyses on each of the given video files, or - if none are given - on a corpus
+ * of synthetic clips of various resolutions, lengths and densities of activity,
+ * and writes out as JSON how long each stage took, the resulting frames and audio
+ * samples per second, and the peak memory use.
+ *
+ * Usage: avscissors-bench [options] [<file>...]
+ *
+ * Each file's analysis runs in a child process of its own (this same program, with
+ * --run-case), so that its peak memory use is its own, and so that nothing it
+ * leaves cached in memory carries over to the next file. The activity cache isn't
+ * used.
+ *
+ * The stages timed are the probing of the file's metadata, and the video and audio
+ * analyses, which run concurrently; a track's analysis is taken to be done once
+ * none of its frames remain unanalyzed. The time the analysis spent in each of its
+ * own stages (decoding, comparing, etc.) gets written out as well.
+ *
+ */
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QTemporaryDir>
+#include <QProcess>
+#include <QThread>
+#include <QFile>
+#include <QDir>
+#if defined(_WIN32)
+    #include <windows.h>
+    #include <psapi.h>
+#else
+    #include <sys/resource.h>
+#endif
+#include "../../src/bench/synthetic_corpus.h"
+#include "../../src/video/video_activity.h"
+#include "../../src/video/frame_diff.h"
+#include "../../src/video/video_info.h"
+#include "../../src/cli/console.h"
+#include "../../src/common.h"
+
+// Returns the most memory, in kilobytes, that this process has had resident at
+// once so far.
+//
+static qint64 peak_rss_kb(void)
+{
+    #if defined(_WIN32)
+        PROCESS_MEMORY_COUNTERS counters;
+        if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        {
+            return -1;
+        }
+
+        return qint64(counters.PeakWorkingSetSize / 1024);
+    #else
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0)
+        {
+            return -1;
+        }
+
+        // macOS reports bytes, Linux kilobytes.
+        #if defined(__APPLE__)
+            return qint64(usage.ru_maxrss / 1024);
+        #else
+            return qint64(usage.ru_maxrss);
+        #endif
+    #endif
+}
+
+// Analyzes the given file, timing the stages of its analysis. Returns the
+// measurements, or an empty object if the file couldn't be analyzed.
+//
+static QJsonObject run_case(const QString &filename, const video_activity_settings_s &settings)
+{
+    typedef activity_timeline_c::activity_type_e activity_type_e;
+
+    const console_message_sink_c messageSink(filename);
+    QElapsedTimer timer;
+    QJsonObject result;
+
+    timer.start();
+    const video_info_c videoInfo(filename, &messageSink);
+    const real probeSeconds = (timer.nsecsElapsed() / 1e9);
+
+    if (!videoInfo.is_valid_video())
+    {
+        return result;
+    }
+
+    const uint numFrames = videoInfo.num_frames();
+    real videoSeconds = -1;
+    real audioSeconds = -1;
+
+    timer.restart();
+    const video_activity_c videoActivity(videoInfo, &messageSink, settings);
+
+    // Poll the tracks for when they've been fully analyzed.
+    while (true)
+    {
+        const bool isFinished = videoActivity.strip_build_has_finished();
+        const real elapsedSeconds = (timer.nsecsElapsed() / 1e9);
+
+        if ((videoSeconds < 0) &&
+            (isFinished || !videoActivity.frame_activity(0).range_contains(0, numFrames, activity_type_e::Uninitialized)))
+        {
+            videoSeconds = elapsedSeconds;
+        }
+
+        if ((audioSeconds < 0) &&
+            (isFinished || !videoActivity.frame_activity(1).range_contains(0, numFrames, activity_type_e::Uninitialized)))
+        {
+            audioSeconds = elapsedSeconds;
+        }
+
+        if (isFinished)
+        {
+            break;
+        }
+
+        QCoreApplication::processEvents();
+        QThread::msleep(5);
+    }
+
+    const real totalSeconds = (timer.nsecsElapsed() / 1e9);
+    const bool hasAudio = videoActivity.has_valid_audio();
+    const std::vector<std::pair<uint, uint>> videoSegments = videoActivity.frame_activity(0).active_segments();
+
+    uint numActiveFrames = 0;
+    for (const auto &segment: videoSegments)
+    {
+        numActiveFrames += (segment.second - segment.first);
+    }
+
+    result["file"] = filename;
+    result["width"] = int(videoInfo.width());
+    result["height"] = int(videoInfo.height());
+    result["hasAudio"] = hasAudio;
+    result["frames"] = double(numFrames);
+    result["frameRate"] = videoInfo.frame_rate();
+    result["durationSeconds"] = (videoInfo.duration_ms() / 1000.0);
+    result["probeSeconds"] = probeSeconds;
+    result["videoSeconds"] = videoSeconds;
+    result["totalSeconds"] = totalSeconds;
+    result["videoFramesPerSecond"] = (numFrames / std::max(1e-9, videoSeconds));
+    result["videoActiveFraction"] = (numActiveFrames / real(numFrames));
+    result["peakRssKb"] = double(peak_rss_kb());
+
+    // How long the analysis spent in each of its stages.
+    {
+        QJsonObject stages;
+
+        for (uint i = 0; i < uint(analysis_stats_c::stage_e::NumStages); i++)
+        {
+            const auto stage = analysis_stats_c::stage_e(i);
+            const analysis_stats_c::stage_totals_s totals = videoActivity.stats().stage_totals(stage);
+
+            if (totals.count > 0)
+            {
+                QJsonObject stageResult;
+                stageResult["count"] = double(totals.count);
+                stageResult["seconds"] = (totals.nanoseconds / 1e9);
+
+                stages[analysis_stats_c::stage_name(stage)] = stageResult;
+            }
+        }
+
+        result["stages"] = stages;
+    }
+
+    if (hasAudio)
+    {
+        const real numSamples = (videoActivity.audio_sample_rate() * (numFrames / videoInfo.frame_rate()));
+
+        result["audioSeconds"] = audioSeconds;
+        result["audioSamplesPerSecond"] = (numSamples / std::max(1e-9, audioSeconds));
+    }
+    else
+    {
+        result["audioSeconds"] = QJsonValue();
+        result["audioSamplesPerSecond"] = QJsonValue();
+    }
+
+    return result;
+}
+
+// Parses a comma-separated list of numbers, appending them to the given list.
+// Returns false if any of them isn't a positive number.
+//
+static bool parse_number_list(const QString &string, QVector<real> &numbers)
+{
+    for (const QString &item: string.split(','))
+    {
+        bool isValid = false;
+        const real number = item.toDouble(&isValid);
+
+        if (!isValid ||
+            (number < 0))
+        {
+            return false;
+        }
+
+        numbers << number;
+    }
+
+    return !numbers.isEmpty();
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("avscissors-bench");
+
+    // Keep the engine's logging out of the results written into stdout - both
+    // ours and, with --run-case, the child processes' (which we parse).
+    kLogStream = stderr;
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Benchmarks the activity analysis on the given video files, or on a synthetic corpus.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("files", "The video files to benchmark on. If none are given, a synthetic corpus is generated.", "[<file>...]");
+
+    const QCommandLineOption outputOption(QStringList() << "o" << "output", "Write the results to this file rather than stdout.", "file");
+    const QCommandLineOption corpusDirOption("corpus-dir", "Keep the synthetic corpus in this directory, reusing clips already in it, rather than in a temporary one.", "directory");
+    const QCommandLineOption heightsOption("heights", "The heights of the synthetic clips, at 16:9 (default 360,720,1080).", "list", "360,720,1080");
+    const QCommandLineOption lengthsOption("lengths", "The lengths, in seconds, of the synthetic clips (default 30).", "list", "30");
+    const QCommandLineOption densitiesOption("densities", "The fractions of the synthetic clips that show activity (default 0,0.1,0.5).", "list", "0,0.1,0.5");
+    const QCommandLineOption fourccOption("fourcc", "The codec, as FOURCC, to encode the synthetic clips with (default MJPG).", "fourcc", "MJPG");
+    const QCommandLineOption threadsOption(QStringList() << "j" << "threads", "Number of threads for video analysis; 0 (default) for one per CPU core.", "count", "0");
+    const QCommandLineOption sequentialOption("sequential", "Analyze each video in a single sequential pass.");
+    const QCommandLineOption proxyOption("proxy", "Compare downscaled luma rather than full-color frames.");
+    const QCommandLineOption runCaseOption("run-case", "Internal: benchmark a single file in this process.");
+
+    parser.addOption(outputOption);
+    parser.addOption(corpusDirOption);
+    parser.addOption(heightsOption);
+    parser.addOption(lengthsOption);
+    parser.addOption(densitiesOption);
+    parser.addOption(fourccOption);
+    parser.addOption(threadsOption);
+    parser.addOption(sequentialOption);
+    parser.addOption(proxyOption);
+    parser.addOption(runCaseOption);
+
+    parser.process(app);
+
+    QStringList filenames = parser.positionalArguments();
+    bool threadCountIsValid = false;
+    const uint numThreads = parser.value(threadsOption).toUInt(&threadCountIsValid);
+    QVector<real> heights, lengths, densities;
+
+    if (!threadCountIsValid ||
+        !parse_number_list(parser.value(heightsOption), heights) ||
+        !parse_number_list(parser.value(lengthsOption), lengths) ||
+        !parse_number_list(parser.value(densitiesOption), densities) ||
+        (parser.isSet(runCaseOption) && (filenames.size() != 1)))
+    {
+        fprintf(stderr, "%s\n", parser.helpText().toLocal8Bit().constData());
+        return int(exit_code_e::BadArguments);
+    }
+
+    // The options that get passed on to the child processes.
+    QStringList settingsArguments = QStringList() << "--threads" << QString::number(numThreads);
+    if (parser.isSet(sequentialOption)) settingsArguments << "--sequential";
+    if (parser.isSet(proxyOption)) settingsArguments << "--proxy";
+
+    if (parser.isSet(runCaseOption))
+    {
+        video_activity_settings_s settings;
+        settings.numVideoAnalysisThreads = numThreads;
+        settings.useActivityCache = false;
+        if (parser.isSet(sequentialOption))
+        {
+            settings.videoAnalysisMode = video_activity_settings_s::video_analysis_mode_e::Sequential;
+        }
+        if (parser.isSet(proxyOption))
+        {
+            settings.videoComparisonMode = video_activity_settings_s::video_comparison_mode_e::Proxy;
+        }
+
+        const QJsonObject result = run_case(filenames.first(), settings);
+        if (result.isEmpty())
+        {
+            return int(exit_code_e::FileFailed);
+        }
+
+        fprintf(stdout, "%s\n", QJsonDocument(result).toJson(QJsonDocument::Compact).constData());
+
+        return int(exit_code_e::Ok);
+    }
+
+    QJsonArray cases;
+    exit_code_e exitCode = exit_code_e::Ok;
+
+    // Make up the synthetic corpus, if no files were given.
+    QTemporaryDir temporaryDir;
+    QVector<synthetic_clip_s> clips;
+    if (filenames.isEmpty())
+    {
+        const QString corpusDir = parser.isSet(corpusDirOption)? parser.value(corpusDirOption) : temporaryDir.path();
+
+        if (!QDir().mkpath(corpusDir))
+        {
+            fprintf(stderr, "Failed to create the corpus directory.\n");
+            return int(exit_code_e::OutputFailed);
+        }
+
+        for (const real height: heights)
+        {
+            for (const real length: lengths)
+            {
+                for (const real density: densities)
+                {
+                    synthetic_clip_s clip;
+                    clip.resolution = QSize((int(height * 16 / 9) & ~1), int(height));
+                    clip.lengthSeconds = uint(length);
+                    clip.activityDensity = density;
+                    clip.fourcc = parser.value(fourccOption);
+
+                    const QString filename = QDir(corpusDir).filePath(synthetic_clip_file_name(clip));
+
+                    if (!QFile::exists(filename))
+                    {
+                        fprintf(stderr, "Generating '%s'...\n", filename.toLocal8Bit().constData());
+
+                        // Whether the clip got an audio track is taken from its
+                        // analysis, below, so that it holds for reused clips too.
+                        bool hasAudio = false;
+                        if (!synthetic_clip_write(clip, filename, hasAudio))
+                        {
+                            fprintf(stderr, "Failed to generate '%s'.\n", filename.toLocal8Bit().constData());
+                            exitCode = exit_code_e::FileFailed;
+                            continue;
+                        }
+                    }
+
+                    filenames << filename;
+                    clips << clip;
+                }
+            }
+        }
+    }
+
+    // Benchmark each file in a process of its own.
+    for (int i = 0; i < filenames.size(); i++)
+    {
+        fprintf(stderr, "Benchmarking '%s'...\n", filenames.at(i).toLocal8Bit().constData());
+
+        QProcess child;
+        child.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+        child.start(QCoreApplication::applicationFilePath(), (QStringList() << "--run-case" << settingsArguments << filenames.at(i)));
+
+        QJsonObject result;
+        if (child.waitForFinished(-1) &&
+            (child.exitStatus() == QProcess::NormalExit) &&
+            (child.exitCode() == int(exit_code_e::Ok)))
+        {
+            // The result is the last line the child wrote.
+            const QByteArray output = child.readAllStandardOutput().trimmed();
+            result = QJsonDocument::fromJson(output.mid(output.lastIndexOf('\n') + 1)).object();
+        }
+
+        if (result.isEmpty())
+        {
+            fprintf(stderr, "Failed to benchmark '%s'.\n", filenames.at(i).toLocal8Bit().constData());
+            exitCode = exit_code_e::FileFailed;
+            continue;
+        }
+
+        if (i < clips.size())
+        {
+            QJsonObject clip;
+            clip["activityDensity"] = clips.at(i).activityDensity;
+            clip["fourcc"] = clips.at(i).fourcc;
+            clip["hasAudio"] = result.value("hasAudio");
+
+            result["synthetic"] = clip;
+        }
+
+        cases << result;
+    }
+
+    // Write out the results.
+    {
+        QJsonObject settings;
+        settings["threads"] = int(numThreads);
+        settings["sequential"] = parser.isSet(sequentialOption);
+        settings["proxy"] = parser.isSet(proxyOption);
+
+        QJsonObject report;
+        report["frameDiffKernel"] = QString(frame_diff_kernel_name());
+        report["idealThreadCount"] = QThread::idealThreadCount();
+        report["settings"] = settings;
+        report["cases"] = cases;
+
+        const QByteArray output = QJsonDocument(report).toJson();
+
+        QFile outFile;
+        if (!open_output(outFile, parser.value(outputOption)) ||
+            (outFile.write(output) != output.size()))
+        {
+            fprintf(stderr, "Failed to write the results.\n");
+            return int(exit_code_e::OutputFailed);
+        }
+    }
+
+    return int(exitCode);
+}
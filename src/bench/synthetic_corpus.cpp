@@ -0,0 +1,244 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors
+ *
+ * Generates synthetic video clips with a known amount of activity in them, for
+ * benchmarking the analysis on.
+ *
+ * A clip shows a static, textured scene under a little sensor-like noise (too
+ * little to count as activity), with a box moving across it during the clip's
+ * stretches of activity. Its audio track is likewise quiet noise, with a loud
+ * tone during those same stretches. The stretches are a few seconds each, spread
+ * evenly across the clip, and together make up the asked-for share of it.
+ *
+ * The video gets written via OpenCV. For the audio, the FFmpeg program is asked
+ * to mux a generated WAV file into the clip; if it's not available, the clip goes
+ * without audio.
+ *
+ */
+
+#include <QByteArray>
+#include <QVector>
+#include <QFile>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include "../../src/bench/synthetic_corpus.h"
+#include "../../src/common.h"
+
+// The length, in seconds, of each stretch of activity.
+static const real ACTIVITY_STRETCH_SECONDS = 2;
+
+// The sample rate of the clips' audio.
+static const uint AUDIO_SAMPLE_RATE = 48000;
+
+// The largest amount, in 8-bit levels, by which the frames' noise varies a pixel.
+// Kept well below the analysis's threshold of difference.
+static const int NOISE_AMPLITUDE = 4;
+
+// Returns true if the given time, in seconds, falls within one of the clip's
+// stretches of activity.
+//
+static bool is_active_at(const synthetic_clip_s &clip, const real seconds)
+{
+    if (clip.activityDensity <= 0)
+    {
+        return false;
+    }
+
+    // Each stretch of activity begins a period, whose length is such that the
+    // stretches make up the right share of the clip.
+    const real period = (ACTIVITY_STRETCH_SECONDS / std::min(real(1), clip.activityDensity));
+
+    return (std::fmod(seconds, period) < ACTIVITY_STRETCH_SECONDS);
+}
+
+// Returns a name for the clip's file, unique to its parameters.
+//
+QString synthetic_clip_file_name(const synthetic_clip_s &clip)
+{
+    return QString("synthetic_%1x%2_%3s_%4fps_%5pct_%6.avi").arg(clip.resolution.width())
+                                                            .arg(clip.resolution.height())
+                                                            .arg(clip.lengthSeconds)
+                                                            .arg(clip.frameRate)
+                                                            .arg(int(std::round(clip.activityDensity * 100)))
+                                                            .arg(clip.fourcc.toLower());
+}
+
+static bool write_video(const synthetic_clip_s &clip, const QString &filename)
+{
+    const QByteArray fourcc = clip.fourcc.toLatin1().leftJustified(4, ' ');
+    const cv::Size size(clip.resolution.width(), clip.resolution.height());
+    const uint numFrames = uint(clip.lengthSeconds * clip.frameRate);
+
+    cv::VideoWriter writer(filename.toStdString(), cv::VideoWriter::fourcc(fourcc[0], fourcc[1], fourcc[2], fourcc[3]),
+                           clip.frameRate, size, true);
+    if (!writer.isOpened())
+    {
+        return false;
+    }
+
+    // The static scene: a gradient with a blotchy texture on it.
+    cv::Mat scene(size, CV_8UC3);
+    {
+        cv::Mat texture(size, CV_8UC3);
+        cv::randu(texture, cv::Scalar(0, 0, 0), cv::Scalar(255, 255, 255));
+        cv::GaussianBlur(texture, texture, cv::Size(0, 0), 8);
+
+        for (int y = 0; y < scene.rows; y++)
+        {
+            u8 *const row = scene.ptr<u8>(y);
+            const u8 *const textureRow = texture.ptr<u8>(y);
+
+            for (int x = 0; x < (scene.cols * 3); x++)
+            {
+                row[x] = u8(((x / 3) * 128 / scene.cols) + (textureRow[x] / 2));
+            }
+        }
+    }
+
+    const int boxSize = std::max(8, (size.height / 6));
+    cv::Mat frame, noise(size, CV_8UC3);
+
+    for (uint i = 0; i < numFrames; i++)
+    {
+        const real seconds = (i / clip.frameRate);
+
+        // Sensor noise, centered on the scene's values.
+        cv::randu(noise, cv::Scalar(0, 0, 0), cv::Scalar(NOISE_AMPLITUDE, NOISE_AMPLITUDE, NOISE_AMPLITUDE));
+        cv::add(scene, noise, frame);
+
+        if (is_active_at(clip, seconds))
+        {
+            const int travel = std::max(1, (size.width - boxSize));
+            const int x = int(std::fmod((seconds * size.width / ACTIVITY_STRETCH_SECONDS), travel));
+            const int y = ((size.height - boxSize) / 2);
+
+            cv::rectangle(frame, cv::Rect(x, y, boxSize, boxSize), cv::Scalar(255, 255, 255), -1);
+        }
+
+        writer.write(frame);
+    }
+
+    return true;
+}
+
+// Writes the clip's audio as a mono, 16-bit WAV file.
+//
+static bool write_audio(const synthetic_clip_s &clip, const QString &filename)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        return false;
+    }
+
+    const u32 numSamples = u32(clip.lengthSeconds * AUDIO_SAMPLE_RATE);
+    const u32 dataSize = (numSamples * sizeof(i16));
+
+    // The RIFF header and the fmt chunk.
+    {
+        const auto put_u32 = [](QByteArray &bytes, const u32 value)
+        {
+            for (uint i = 0; i < 4; i++) bytes.append(char((value >> (i * 8)) & 0xff));
+        };
+        const auto put_u16 = [](QByteArray &bytes, const u16 value)
+        {
+            for (uint i = 0; i < 2; i++) bytes.append(char((value >> (i * 8)) & 0xff));
+        };
+
+        QByteArray header;
+        header.append("RIFF");
+        put_u32(header, (36 + dataSize));
+        header.append("WAVE");
+        header.append("fmt ");
+        put_u32(header, 16);
+        put_u16(header, 1);                              // PCM.
+        put_u16(header, 1);                              // Mono.
+        put_u32(header, AUDIO_SAMPLE_RATE);
+        put_u32(header, (AUDIO_SAMPLE_RATE * sizeof(i16)));
+        put_u16(header, sizeof(i16));
+        put_u16(header, 16);
+        header.append("data");
+        put_u32(header, dataSize);
+
+        if (file.write(header) != header.size())
+        {
+            return false;
+        }
+    }
+
+    // The samples, a second at a time.
+    {
+        QVector<i16> samples(AUDIO_SAMPLE_RATE);
+
+        for (u32 i = 0; i < numSamples; i += AUDIO_SAMPLE_RATE)
+        {
+            const u32 count = std::min(AUDIO_SAMPLE_RATE, (numSamples - i));
+
+            for (u32 s = 0; s < count; s++)
+            {
+                const real seconds = ((i + s) / real(AUDIO_SAMPLE_RATE));
+                const int noise = ((rand() % 201) - 100);
+                const int tone = is_active_at(clip, seconds)? int(12000 * std::sin(seconds * 2 * 3.14159265358979 * 440)) : 0;
+
+                samples[s] = i16(noise + tone);
+            }
+
+            if (file.write((const char*)samples.constData(), (count * sizeof(i16))) != qint64(count * sizeof(i16)))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// Writes the given clip into a file of the given name. Sets hasAudio according to
+// whether the clip could be given an audio track. Returns false if the clip
+// couldn't be written.
+//
+bool synthetic_clip_write(const synthetic_clip_s &clip, const QString &filename, bool &hasAudio)
+{
+    const QString videoFilename = (filename + ".video.avi");
+    const QString audioFilename = (filename + ".audio.wav");
+
+    hasAudio = false;
+
+    if (!write_video(clip, videoFilename))
+    {
+        NBENE(("Failed to write the synthetic clip '%s'.", filename.toUtf8().constData()));
+        return false;
+    }
+
+    if (write_audio(clip, audioFilename))
+    {
+        const QString cmd = QString("ffmpeg -loglevel error -i \"%1\" -i \"%2\" -c:v copy -c:a pcm_s16le -shortest -y \"%3\"")
+                            .arg(videoFilename)
+                            .arg(audioFilename)
+                            .arg(filename);
+
+        hasAudio = (system(cmd.toStdString().c_str()) == 0);
+    }
+
+    QFile(audioFilename).remove();
+
+    if (hasAudio)
+    {
+        QFile(videoFilename).remove();
+    }
+    else
+    {
+        QFile::remove(filename);
+
+        if (!QFile::rename(videoFilename, filename))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
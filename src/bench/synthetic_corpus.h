@@ -0,0 +1,33 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors
+ *
+ */
+
+#ifndef SYNTHETIC_CORPUS_H
+#define SYNTHETIC_CORPUS_H
+
+#include <QString>
+#include <QSize>
+#include "../../src/types.h"
+
+// Describes a synthetic clip for benchmarking the analysis on.
+struct synthetic_clip_s
+{
+    QSize resolution = QSize(1280, 720);
+    uint lengthSeconds = 30;
+    real frameRate = 30;
+
+    // The fraction of the clip's frames that show activity, both visual and
+    // acoustic.
+    real activityDensity = 0.1;
+
+    // The FOURCC of the codec to encode the video with.
+    QString fourcc = "MJPG";
+};
+
+QString synthetic_clip_file_name(const synthetic_clip_s &clip);
+
+bool synthetic_clip_write(const synthetic_clip_s &clip, const QString &filename, bool &hasAudio);
+
+#endif
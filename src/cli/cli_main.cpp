@@ -0,0 +1,513 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors.
+ *
+ * A command-line front-end to AV Scissors' analysis engine, for running the
+ * analysis headlessly, e.g. in batch on a server. Analyzes each of the given
+ * video files in turn and writes out their segments of activity as JSON or CSV.
+ *
+ * Usage: avscissors-cli [options] <file>...
+ *
+ * With --stats, also prints out for each file how long each stage of its analysis
+ * took; and with --trace-dir, writes a trace of each file's analysis, for viewing
+ * in chrome://tracing or Perfetto.
+ *
+ * With --export-dir, also cuts each file's segments of activity (on either track)
+ * out of it, without re-encoding, into a highlights file in the given directory;
+ * or, with --export-as, writes them as an EDL or an FFmpeg concat script instead.
+ * Files with no activity get nothing exported.
+ *
+ * With --stream, analyzes instead a single source that's still being written or
+ * broadcast - a growing file, or an RTSP/HTTP camera feed - and writes out each
+ * start and end of activity as a line of JSON as soon as it happens, until the
+ * source ends.
+ *
+ * The results go into stdout, unless written into a file with -o; everything
+ * else, including the engine's logging, goes into stderr.
+ *
+ * Exits with 0 if all files were analyzed; 1 if the arguments were invalid; 2 if
+ * any of the files couldn't be analyzed (the rest still get written out); and 3
+ * if the output, or any of the exports, couldn't be written.
+ *
+ */
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QTextStream>
+#include <QThread>
+#include <QFileInfo>
+#include <QFile>
+#include <QDir>
+#include "../../src/video/segment_exporter.h"
+#include "../../src/video/stream_activity.h"
+#include "../../src/video/video_activity.h"
+#include "../../src/video/video_info.h"
+#include "../../src/cli/console.h"
+#include "../../src/common.h"
+
+// The results of analyzing one file.
+struct file_result_s
+{
+    QString filename;
+    bool isValid = false;
+    bool hasAudio = false;
+    real frameRate = 0;
+    uint numFrames = 0;
+
+    // The segments of activity on each track, as [start, end) frame indices.
+    std::vector<std::pair<uint, uint>> videoSegments;
+    std::vector<std::pair<uint, uint>> audioSegments;
+
+    // The segments of activity on either track.
+    std::vector<std::pair<uint, uint>> segments;
+};
+
+// Prints out to stderr how many times each stage of the given analysis ran, and
+// for how long in all.
+//
+static void print_stage_stats(const QString &filename, const video_activity_c &videoActivity)
+{
+    const analysis_stats_c &stats = videoActivity.stats();
+
+    fprintf(stderr, "%s: analysis took %.3f s\n", filename.toLocal8Bit().constData(), stats.elapsed_seconds());
+
+    for (uint i = 0; i < uint(analysis_stats_c::stage_e::NumStages); i++)
+    {
+        const auto stage = analysis_stats_c::stage_e(i);
+        const analysis_stats_c::stage_totals_s totals = stats.stage_totals(stage);
+
+        if (totals.count == 0)
+        {
+            continue;
+        }
+
+        fprintf(stderr, "%s:   %-16s %10.3f s in %llu calls (%.1f us each)\n",
+                filename.toLocal8Bit().constData(), analysis_stats_c::stage_name(stage),
+                (totals.nanoseconds / 1e9), (unsigned long long)totals.count,
+                ((totals.nanoseconds / 1e3) / totals.count));
+    }
+
+    return;
+}
+
+// Runs the analysis on the given file, blocking until it's done.
+//
+static file_result_s analyze_file(const QString &filename, const video_activity_settings_s &settings, const bool printStats)
+{
+    file_result_s result;
+    result.filename = filename;
+
+    const console_message_sink_c messageSink(filename);
+    const video_info_c videoInfo(filename, &messageSink);
+
+    if (!videoInfo.is_valid_video())
+    {
+        return result;
+    }
+
+    const video_activity_c videoActivity(videoInfo, &messageSink, settings);
+
+    // The workers' messages get delivered through the event loop, so keep it
+    // going while we wait.
+    while (!videoActivity.strip_build_has_finished())
+    {
+        QCoreApplication::processEvents();
+        QThread::msleep(50);
+    }
+    QCoreApplication::processEvents();
+
+    if (printStats)
+    {
+        print_stage_stats(filename, videoActivity);
+    }
+
+    result.isValid = true;
+    result.hasAudio = videoActivity.has_valid_audio();
+    result.frameRate = videoInfo.frame_rate();
+    result.numFrames = videoInfo.num_frames();
+    result.videoSegments = videoActivity.frame_activity(0).active_segments();
+    if (result.hasAudio)
+    {
+        result.audioSegments = videoActivity.frame_activity(1).active_segments();
+    }
+    result.segments = videoActivity.active_segments(2);
+
+    return result;
+}
+
+static QJsonArray segments_to_json(const std::vector<std::pair<uint, uint>> &segments, const real frameRate)
+{
+    QJsonArray array;
+
+    for (const auto &segment: segments)
+    {
+        QJsonObject object;
+        object["startFrame"] = int(segment.first);
+        object["endFrame"] = int(segment.second);
+        object["startSeconds"] = (segment.first / frameRate);
+        object["endSeconds"] = (segment.second / frameRate);
+
+        array.append(object);
+    }
+
+    return array;
+}
+
+static QByteArray results_to_json(const QVector<file_result_s> &results)
+{
+    QJsonArray files;
+
+    for (const auto &result: results)
+    {
+        QJsonObject file;
+        file["file"] = result.filename;
+        file["valid"] = result.isValid;
+
+        if (result.isValid)
+        {
+            file["frameRate"] = result.frameRate;
+            file["numFrames"] = int(result.numFrames);
+            file["video"] = segments_to_json(result.videoSegments, result.frameRate);
+            file["audio"] = result.hasAudio? QJsonValue(segments_to_json(result.audioSegments, result.frameRate))
+                                           : QJsonValue();
+        }
+
+        files.append(file);
+    }
+
+    QJsonObject root;
+    root["files"] = files;
+
+    return QJsonDocument(root).toJson(QJsonDocument::Indented);
+}
+
+// One line per segment of activity, with a header line.
+//
+static QByteArray results_to_csv(const QVector<file_result_s> &results)
+{
+    QByteArray csv;
+    QTextStream stream(&csv);
+
+    stream << "file,track,start_frame,end_frame,start_seconds,end_seconds\n";
+
+    for (const auto &result: results)
+    {
+        QString quotedFilename = result.filename;
+        quotedFilename.replace("\"", "\"\"");
+        quotedFilename = QString("\"%1\"").arg(quotedFilename);
+
+        const auto write_segments = [&](const char *const track, const std::vector<std::pair<uint, uint>> &segments)
+        {
+            for (const auto &segment: segments)
+            {
+                stream << quotedFilename << ',' << track << ','
+                       << segment.first << ',' << segment.second << ','
+                       << QString::number((segment.first / result.frameRate), 'f', 3) << ','
+                       << QString::number((segment.second / result.frameRate), 'f', 3) << '\n';
+            }
+        };
+
+        write_segments("video", result.videoSegments);
+        write_segments("audio", result.audioSegments);
+    }
+
+    stream.flush();
+
+    return csv;
+}
+
+// Parses the given mask regions, each given as "x,y,width,height" in fractions
+// of the frame's dimensions, appending them to the list of regions. Returns false
+// if any of them is malformed.
+//
+static bool parse_mask_regions(const QStringList &texts, const bool areExclusions, QVector<activity_mask_region_s> &regions)
+{
+    for (const QString &text: texts)
+    {
+        const QStringList values = text.split(',');
+        real coords[4] = {0, 0, 0, 0};
+
+        if (values.size() != 4)
+        {
+            return false;
+        }
+
+        for (int i = 0; i < 4; i++)
+        {
+            bool isValid = false;
+            coords[i] = values.at(i).toDouble(&isValid);
+
+            if (!isValid ||
+                (coords[i] < 0) ||
+                (coords[i] > 1))
+            {
+                return false;
+            }
+        }
+
+        activity_mask_region_s region;
+        region.x = coords[0];
+        region.y = coords[1];
+        region.width = coords[2];
+        region.height = coords[3];
+        region.isExclusion = areExclusions;
+
+        regions << region;
+    }
+
+    return true;
+}
+
+// Runs a streaming analysis of the given source until the source ends, writing
+// each event of activity into the output as soon as it's raised, as a line of
+// JSON. Nothing else goes into the output (the engine's logging goes into
+// stderr; see main()), so consumers can parse each line as it comes.
+//
+static exit_code_e stream_source(const QString &source, const stream_activity_settings_s &settings, QFile &outFile)
+{
+    const console_message_sink_c messageSink(source);
+    stream_activity_c streamActivity(source, &messageSink, settings);
+    bool outputFailed = false;
+
+    const auto write_event = [&](const char *const type, const uint frameIdx, const QDateTime &detectedAt)
+    {
+        QJsonObject event;
+        event["event"] = type;
+        event["frame"] = int(frameIdx);
+        event["time"] = detectedAt.toString(Qt::ISODate);
+
+        const QByteArray line = (QJsonDocument(event).toJson(QJsonDocument::Compact) + "\n");
+
+        outputFailed |= (outFile.write(line) != line.size());
+        outFile.flush();
+    };
+
+    // The events get queued over to this thread, and written out as the event
+    // loop gets to them.
+    QObject::connect(&streamActivity, &stream_activity_c::activity_started, QCoreApplication::instance(),
+                     [&](const uint frameIdx, const QDateTime detectedAt){ write_event("start", frameIdx, detectedAt); });
+    QObject::connect(&streamActivity, &stream_activity_c::activity_ended, QCoreApplication::instance(),
+                     [&](const uint frameIdx, const QDateTime detectedAt){ write_event("end", frameIdx, detectedAt); });
+
+    while (!streamActivity.has_finished() &&
+           !outputFailed)
+    {
+        QCoreApplication::processEvents();
+        QThread::msleep(50);
+    }
+    QCoreApplication::processEvents();
+
+    if (outputFailed)
+    {
+        return exit_code_e::OutputFailed;
+    }
+
+    return ((streamActivity.frame_activity().size() > 0)? exit_code_e::Ok : exit_code_e::FileFailed);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("avscissors-cli");
+
+    // Keep the engine's logging out of the results written into stdout.
+    kLogStream = stderr;
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Finds the segments of audio and video activity in video files.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("files", "The video files to analyze.", "<file>...");
+
+    const QCommandLineOption formatOption(QStringList() << "f" << "format", "Output format: json (default) or csv.", "format", "json");
+    const QCommandLineOption outputOption(QStringList() << "o" << "output", "Write the results to this file rather than stdout.", "file");
+    const QCommandLineOption threadsOption(QStringList() << "j" << "threads", "Number of threads for video analysis; 0 (default) for one per CPU core.", "count", "0");
+    const QCommandLineOption sequentialOption("sequential", "Analyze each video in a single sequential pass.");
+    const QCommandLineOption noCacheOption("no-cache", "Don't read from or write to the activity cache.");
+    const QCommandLineOption prefilterOption("prefilter", "Decode only the stretches of video whose compressed frames suggest activity. Faster on mostly static footage, but may miss slight activity.");
+    const QCommandLineOption sampleStrideOption("sample-stride", "Compare frames this many seconds apart, refining only the intervals across which they differ. Faster, but may miss activity that begins and ends between two samples.", "seconds");
+    const QCommandLineOption refineDepthOption("refine-depth", "With --sample-stride, how many times to halve an interval in looking for where activity begins (default 5).", "count", "5");
+    const QCommandLineOption holdOption("hold", "How long, in seconds, activity carries over to the frames after it; 0 (default) for 1/50th of the video's length.", "seconds", "0");
+    const QCommandLineOption detectorOption("detector", "How to tell whether a frame shows activity: difference (default), by comparing it with the previous frame; or background, by comparing it with a running average of the frames before it, which is less prone to noise and flicker (and implies --proxy).", "detector", "difference");
+    const QCommandLineOption pixelThresholdOption("pixel-threshold", "How much, from 1 to 254, a pixel's color needs to change for the pixel to count as changed (default 30).", "value", "30");
+    const QCommandLineOption audioThresholdOption("audio-threshold", "How many median absolute deviations above its median loudness a frame's audio needs to be to count as active (default 5).", "deviations", "5");
+    const QCommandLineOption includeOption("include", "Look for visual activity only in this region of the frame, given as x,y,width,height in fractions of the frame's width and height, e.g. 0,0.5,1,0.5 for its bottom half. Can be given more than once.", "region");
+    const QCommandLineOption excludeOption("exclude", "Ignore visual activity in this region of the frame, given as for --include. Can be given more than once.", "region");
+    const QCommandLineOption proxyOption("proxy", "Compare downscaled luma rather than full-color frames.");
+    const QCommandLineOption statsOption("stats", "Print to stderr how long each stage of each file's analysis took.");
+    const QCommandLineOption traceDirOption("trace-dir", "Write a trace of each file's analysis into this directory, as <file name>.trace.json, for viewing in chrome://tracing or Perfetto. Implies --no-cache.", "directory");
+    const QCommandLineOption exportDirOption("export-dir", "Cut each file's segments of activity out of it, without re-encoding, into this directory, as <file name>.highlights.<extension>.", "directory");
+    const QCommandLineOption exportAsOption("export-as", "With --export-dir, what to export the segments as: highlights (default), a file of just the segments; edl, an MPlayer/mpv/Kodi edit list skipping the rest; or ffconcat, an FFmpeg concat script.", "format", "highlights");
+    const QCommandLineOption streamOption("stream", "Analyze a single growing file or RTSP/HTTP stream live, writing out each start and end of activity as a line of JSON.");
+    const QCommandLineOption hwdecOption("hwdec", "Video decode backend: software (default), auto, vaapi, nvdec, qsv or videotoolbox. The hardware backends imply --proxy.", "backend", "software");
+
+    parser.addOption(formatOption);
+    parser.addOption(outputOption);
+    parser.addOption(threadsOption);
+    parser.addOption(sequentialOption);
+    parser.addOption(noCacheOption);
+    parser.addOption(prefilterOption);
+    parser.addOption(sampleStrideOption);
+    parser.addOption(refineDepthOption);
+    parser.addOption(holdOption);
+    parser.addOption(detectorOption);
+    parser.addOption(pixelThresholdOption);
+    parser.addOption(audioThresholdOption);
+    parser.addOption(includeOption);
+    parser.addOption(excludeOption);
+    parser.addOption(proxyOption);
+    parser.addOption(hwdecOption);
+    parser.addOption(statsOption);
+    parser.addOption(traceDirOption);
+    parser.addOption(exportDirOption);
+    parser.addOption(exportAsOption);
+    parser.addOption(streamOption);
+    parser.process(app);
+
+    const QStringList filenames = parser.positionalArguments();
+    const QString format = parser.value(formatOption).toLower();
+    bool threadCountIsValid = false;
+    const uint numThreads = parser.value(threadsOption).toUInt(&threadCountIsValid);
+    const QStringList decodeBackendNames = QStringList() << "software" << "auto" << "vaapi" << "nvdec" << "qsv" << "videotoolbox";
+    const int decodeBackendIdx = decodeBackendNames.indexOf(parser.value(hwdecOption).toLower());
+    const QStringList detectorNames = QStringList() << "difference" << "background";
+    const int detectorIdx = detectorNames.indexOf(parser.value(detectorOption).toLower());
+    const QStringList exportFormatNames = QStringList() << "edl" << "ffconcat" << "highlights";
+    const int exportFormatIdx = exportFormatNames.indexOf(parser.value(exportAsOption).toLower());
+    bool sampleStrideIsValid = true;
+    const double sampleStride = parser.isSet(sampleStrideOption)? parser.value(sampleStrideOption).toDouble(&sampleStrideIsValid) : 0;
+    bool refineDepthIsValid = false;
+    const uint refineDepth = parser.value(refineDepthOption).toUInt(&refineDepthIsValid);
+    bool holdIsValid = false;
+    const double holdSeconds = parser.value(holdOption).toDouble(&holdIsValid);
+    bool pixelThresholdIsValid = false;
+    const uint pixelThreshold = parser.value(pixelThresholdOption).toUInt(&pixelThresholdIsValid);
+    bool audioThresholdIsValid = false;
+    const double audioThreshold = parser.value(audioThresholdOption).toDouble(&audioThresholdIsValid);
+    QVector<activity_mask_region_s> maskRegions;
+    const bool maskIsValid = (parse_mask_regions(parser.values(includeOption), false, maskRegions) &&
+                              parse_mask_regions(parser.values(excludeOption), true, maskRegions));
+
+    if (filenames.isEmpty() ||
+        !threadCountIsValid ||
+        !sampleStrideIsValid || (parser.isSet(sampleStrideOption) && (sampleStride <= 0)) ||
+        !refineDepthIsValid ||
+        !holdIsValid || (holdSeconds < 0) ||
+        !pixelThresholdIsValid || (pixelThreshold < 1) || (pixelThreshold > 254) ||
+        !audioThresholdIsValid || (audioThreshold <= 0) ||
+        !maskIsValid ||
+        (decodeBackendIdx < 0) ||
+        (detectorIdx < 0) ||
+        (exportFormatIdx < 0) ||
+        (parser.isSet(exportDirOption) && !QDir(parser.value(exportDirOption)).exists()) ||
+        (parser.isSet(streamOption) && (filenames.size() != 1)) ||
+        (parser.isSet(traceDirOption) && !QDir(parser.value(traceDirOption)).exists()) ||
+        ((format != "json") && (format != "csv")))
+    {
+        fprintf(stderr, "%s\n", parser.helpText().toLocal8Bit().constData());
+        return int(exit_code_e::BadArguments);
+    }
+
+    if (parser.isSet(streamOption))
+    {
+        QFile outFile;
+        if (!open_output(outFile, parser.value(outputOption)))
+        {
+            fprintf(stderr, "Failed to open the output.\n");
+            return int(exit_code_e::OutputFailed);
+        }
+
+        stream_activity_settings_s streamSettings;
+        streamSettings.pixelDiffThreshold = u8(pixelThreshold);
+        streamSettings.maskRegions = maskRegions;
+
+        return int(stream_source(filenames.first(), streamSettings, outFile));
+    }
+
+    video_activity_settings_s settings;
+    settings.numVideoAnalysisThreads = numThreads;
+    settings.useActivityCache = !(parser.isSet(noCacheOption) || parser.isSet(traceDirOption));
+    settings.usePacketPrefilter = parser.isSet(prefilterOption);
+    if (parser.isSet(sequentialOption))
+    {
+        settings.videoAnalysisMode = video_activity_settings_s::video_analysis_mode_e::Sequential;
+    }
+    if (parser.isSet(sampleStrideOption))
+    {
+        settings.videoAnalysisMode = video_activity_settings_s::video_analysis_mode_e::Sampled;
+        settings.sampleStrideSeconds = sampleStride;
+    }
+    settings.sampleRefinementDepth = refineDepth;
+    settings.activityHoldSeconds = holdSeconds;
+    settings.pixelDiffThreshold = u8(pixelThreshold);
+    settings.audioThresholdDeviations = audioThreshold;
+    settings.maskRegions = maskRegions;
+
+    // The detectors' names are listed in the order of the enumeration.
+    settings.motionDetector = video_activity_settings_s::motion_detector_e(detectorIdx);
+
+    // The backends' names are listed in the order of the enumeration.
+    settings.videoDecodeBackend = video_activity_settings_s::video_decode_backend_e(decodeBackendIdx);
+    if (parser.isSet(proxyOption) ||
+        (settings.videoDecodeBackend != video_activity_settings_s::video_decode_backend_e::Software))
+    {
+        settings.videoComparisonMode = video_activity_settings_s::video_comparison_mode_e::Proxy;
+    }
+
+    // Analyze the files.
+    QVector<file_result_s> results;
+    exit_code_e exitCode = exit_code_e::Ok;
+    for (const QString &filename: filenames)
+    {
+        video_activity_settings_s fileSettings = settings;
+        if (parser.isSet(traceDirOption))
+        {
+            fileSettings.traceFileName = QDir(parser.value(traceDirOption)).filePath(QFileInfo(filename).fileName() + ".trace.json");
+        }
+
+        results << analyze_file(filename, fileSettings, parser.isSet(statsOption));
+
+        if (!results.last().isValid)
+        {
+            exitCode = exit_code_e::FileFailed;
+        }
+        else if (parser.isSet(exportDirOption) &&
+                 results.last().segments.empty())
+        {
+            fprintf(stderr, "%s: no activity to export.\n", filename.toLocal8Bit().constData());
+        }
+        else if (parser.isSet(exportDirOption))
+        {
+            // The formats' names are listed in the order of the enumeration.
+            const auto exportFormat = segment_exporter_c::export_format_e(exportFormatIdx);
+            const QString exportFilename = QDir(parser.value(exportDirOption)).filePath(QFileInfo(segment_exporter_c::default_out_file_name(filename, exportFormat)).fileName());
+
+            segment_exporter_c exporter(filename, results.last().segments, exportFilename, exportFormat);
+
+            if (!exporter.run())
+            {
+                fprintf(stderr, "%s: failed to export the segments into '%s'.\n", filename.toLocal8Bit().constData(), exportFilename.toLocal8Bit().constData());
+                exitCode = exit_code_e::OutputFailed;
+            }
+        }
+    }
+
+    // Write out the results.
+    {
+        const QByteArray output = (format == "csv")? results_to_csv(results)
+                                                   : results_to_json(results);
+
+        QFile outFile;
+        if (!open_output(outFile, parser.value(outputOption)) ||
+            (outFile.write(output) != output.size()))
+        {
+            fprintf(stderr, "Failed to write the results.\n");
+            return int(exit_code_e::OutputFailed);
+        }
+    }
+
+    return int(exitCode);
+}
@@ -0,0 +1,36 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors
+ *
+ */
+
+#include <cstdio>
+#include "../../src/cli/console.h"
+
+console_message_sink_c::console_message_sink_c(const QString &filename) :
+    filename(filename)
+{
+    return;
+}
+
+void console_message_sink_c::new_message(const QString &message)
+{
+    fprintf(stderr, "%s: %s\n", this->filename.toLocal8Bit().constData(), message.toLocal8Bit().constData());
+
+    return;
+}
+
+// Opens the given file for writing the results into; or stdout, if no file is
+// given.
+//
+bool open_output(QFile &outFile, const QString &filename)
+{
+    if (filename.isEmpty())
+    {
+        return outFile.open(stdout, QIODevice::WriteOnly);
+    }
+
+    outFile.setFileName(filename);
+
+    return outFile.open(QIODevice::WriteOnly | QIODevice::Truncate);
+}
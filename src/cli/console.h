@@ -0,0 +1,41 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors
+ *
+ * What the command-line tool and the benchmark have in common as console programs:
+ * their exit codes, their printing out of the engine's messages, and their writing
+ * of their results into stdout or a file.
+ *
+ */
+
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <QString>
+#include <QFile>
+#include "../../src/messager/message_sink.h"
+
+enum class exit_code_e
+{
+    Ok = 0,
+    BadArguments = 1,
+    FileFailed = 2,
+    OutputFailed = 3,
+};
+
+// Prints the engine's user-facing messages to stderr, tagged with the name of the
+// file they concern.
+class console_message_sink_c : public message_sink_c
+{
+public:
+    console_message_sink_c(const QString &filename);
+
+    void new_message(const QString &message) override;
+
+private:
+    const QString filename;
+};
+
+bool open_output(QFile &outFile, const QString &filename);
+
+#endif
@@ -0,0 +1,37 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors.
+ *
+ */
+
+#include <cstdarg>
+#include "../src/common.h"
+
+assertion_notifier_f kAssertionNotifier = nullptr;
+
+FILE *kLogStream = stdout;
+
+// Prints the given printf()-style message into the log stream, for INFO() and
+// DEBUG().
+//
+void k_print_log(const char *const format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vfprintf(kLogStream, format, args);
+    va_end(args);
+
+    return;
+}
+
+// Prints the given printf()-style message into stderr, for NBENE().
+//
+void k_print_error(const char *const format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+
+    return;
+}
@@ -7,20 +7,35 @@
 #ifndef COMMON_H
 #define COMMON_H
 
-#include <QMessageBox>
 #include <cassert>
+#include <cstdio>
 #include "../src/types.h"
 
 const char PROGRAM_TITLE[] = "\"AV Scissors\" by Tarpeeksi Hyvae Soft";
 
+// Gets called with the error string of a failed assertion, before the program
+// is brought down. The GUI sets this to show a message box; elsewhere, it's left
+// null, and assertion failures only get printed out.
+typedef void (*assertion_notifier_f)(const char *const errorString);
+extern assertion_notifier_f kAssertionNotifier;
+
 #define k_assert(condition, error_string)   if (!(condition))\
                                             {\
-                                                QMessageBox::critical(nullptr, "AV Scissors assertion failure", error_string); /*Notify in a user-friendly way.*/\
+                                                fprintf(stderr, "[ASSERT] {%s:%i} %s\n", __FILE__, __LINE__, error_string);\
+                                                if (kAssertionNotifier != nullptr) kAssertionNotifier(error_string); /*Notify in a user-friendly way.*/\
                                                 assert(condition && error_string);\
                                             }
 
-#define INFO(args)  (printf("[info ] {%s:%i} ", __FILE__, __LINE__), printf args, printf("\n"), fflush(stdout))
-#define DEBUG(args) (printf("[debug] {%s:%i} ", __FILE__, __LINE__), printf args, printf("\n"), fflush(stdout))
-#define NBENE(args) (fprintf(stderr, "[ERROR] {%s:%i} ", __FILE__, __LINE__), printf args, printf("\n"), fflush(stdout))
+// Where INFO() and DEBUG() print to. The GUI leaves this as stdout; the command-
+// line tools, whose stdout carries their results, point it to stderr. NBENE()
+// always prints to stderr.
+extern FILE *kLogStream;
+
+void k_print_log(const char *const format, ...);
+void k_print_error(const char *const format, ...);
+
+#define INFO(args)  (fprintf(kLogStream, "[info ] {%s:%i} ", __FILE__, __LINE__), k_print_log args, fprintf(kLogStream, "\n"), fflush(kLogStream))
+#define DEBUG(args) (fprintf(kLogStream, "[debug] {%s:%i} ", __FILE__, __LINE__), k_print_log args, fprintf(kLogStream, "\n"), fflush(kLogStream))
+#define NBENE(args) (fprintf(stderr, "[ERROR] {%s:%i} ", __FILE__, __LINE__), k_print_error args, fprintf(stderr, "\n"), fflush(stderr))
 
 #endif
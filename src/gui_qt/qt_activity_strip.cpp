@@ -20,6 +20,8 @@
 #include <QResizeEvent>
 #include <QImage>
 #include <QDebug>
+#include <algorithm>
+#include <cmath>
 #include "../../src/gui_qt/qt_activity_strip.h"
 #include "../../src/common.h"
 
@@ -58,7 +60,7 @@ void ActivityStrip::set_colors(const QColor activeColor, const QColor inactiveCo
 // Give the strip a pointer to the activity data from which it will create its
 // graphic.
 //
-void ActivityStrip::set_strip_data_ptr(const QVector<video_activity_c::activity_type_e> *const data)
+void ActivityStrip::set_strip_data_ptr(activity_timeline_c *const data)
 {
     this->activityData = data;
     if (this->activityData == nullptr)
@@ -90,45 +92,98 @@ void ActivityStrip::regenerate_activity_strip(void)
         return;
     }
 
+    // We'll be drawing all of the data, so any changes made to it so far will be
+    // included.
+    this->activityData->take_dirty_ranges();
+
     // Generate the strip image. Note that we generate it with a height of 1 pixel
     // only - it'll be scaled to fit the strip vertically when assigned as a QPixmap.
+    this->stripImage = QImage(this->size().width(), 1, QImage::Format_ARGB32_Premultiplied);
+    this->draw_strip_columns(0, this->stripImage.width());
+
+    this->setPixmap(QPixmap::fromImage(this->stripImage).scaled(this->size()));
+
+    return;
+}
+
+// Redraws those columns of the strip whose activity data has changed since the
+// strip was last drawn. Meant to be called periodically while the activity data
+// is being built.
+//
+void ActivityStrip::update_activity_strip(void)
+{
+    if (this->activityData == nullptr)
+    {
+        return;
+    }
+
+    if (this->stripImage.width() != this->size().width())
+    {
+        this->regenerate_activity_strip();
+        return;
+    }
+
+    const auto dirtyRanges = this->activityData->take_dirty_ranges();
+
+    if (dirtyRanges.empty() ||
+        (this->stripImage.width() <= 0))
     {
-        QImage stripImage(this->size().width(), 1, QImage::Format_ARGB32_Premultiplied);
+        return;
+    }
 
-        const real binWidth = (activityData->size() / real(stripImage.size().width()));
+    const real binWidth = (activityData->size() / real(this->stripImage.width()));
+    const uint binNumFrames = std::ceil(binWidth);
 
-        for (int x = 0; x < stripImage.size().width(); x++)
+    for (const auto &range: dirtyRanges)
+    {
+        // The columns whose bins overlap the range, plus possibly one extra on each
+        // side to be safe from rounding.
+        const int firstX = std::max(0, int(std::floor((range.first - real(binNumFrames)) / binWidth)));
+        const int endX = std::min(this->stripImage.width(), int(std::floor(range.second / binWidth) + 1));
+
+        this->draw_strip_columns(firstX, endX);
+    }
+
+    this->setPixmap(QPixmap::fromImage(this->stripImage).scaled(this->size()));
+
+    return;
+}
+
+// Draws the strip image's pixel columns [firstX, endX) from the activity data.
+//
+void ActivityStrip::draw_strip_columns(const int firstX, const int endX)
+{
+    // Each pixel column covers a bin of frames, whose activity we query from the
+    // activity data's summary pyramid rather than frame by frame, so that the
+    // cost of drawing the strip depends on its width, not the video's length.
+    const real binWidth = (activityData->size() / real(this->stripImage.width()));
+    const uint binNumFrames = std::ceil(binWidth);
+
+    for (int x = firstX; x < endX; x++)
+    {
+        const uint frameIdx = (x * binWidth);
+
+        // Decide the color to draw the current vertical stripe in the strip with,
+        // based on whether there's activity in the data at the corresponding index.
+        QColor c = this->unknownColor;
         {
-            const uint frameIdx = (x * binWidth);
+            c = activityData->range_contains(frameIdx, (frameIdx + binNumFrames), video_activity_c::activity_type_e::Uninitialized)? this->unknownColor
+                                                                                                                                   : this->inactiveColor;
 
-            // Decide the color to draw the current vertical stripe in the strip with,
-            // based on whether there's activity in the data at the corresponding index.
-            QColor c = this->unknownColor;
+            if (activityData->at(0) == video_activity_c::activity_type_e::NoData)
             {
-                c = (activityData->at(frameIdx) == video_activity_c::activity_type_e::Uninitialized)? this->unknownColor
-                                                                                                    : this->inactiveColor;
-
-                if (activityData->at(0) == video_activity_c::activity_type_e::NoData)
-                {
-                    c = noDataColor;
-                }
-                else
+                c = noDataColor;
+            }
+            else
+            {
+                if (activityData->range_contains(frameIdx, (frameIdx + binNumFrames), video_activity_c::activity_type_e::Active))
                 {
-                    for (uint i = 0; i < binWidth; i++)
-                    {
-                        if (activityData->at(frameIdx + i) == video_activity_c::activity_type_e::Active)
-                        {
-                            c = this->activeColor;
-                            break;
-                        }
-                    }
+                    c = this->activeColor;
                 }
             }
-
-            stripImage.setPixel(x, 0, qRgb(c.red(), c.green(), c.blue()));
         }
 
-        this->setPixmap(QPixmap::fromImage(stripImage).scaled(this->size()));
+        this->stripImage.setPixel(x, 0, qRgb(c.red(), c.green(), c.blue()));
     }
 
     return;
@@ -22,19 +22,27 @@ public:
 
     void regenerate_activity_strip(void);
 
+    void update_activity_strip(void);
+
     QColor activity_color(void) const;
 
 signals:
 
 public slots:
-    void set_strip_data_ptr(const QVector<video_activity_c::activity_type_e> *const _data);
+    void set_strip_data_ptr(activity_timeline_c *const _data);
 
 private:
     void resizeEvent(QResizeEvent *event);
 
+    void draw_strip_columns(const int firstX, const int endX);
+
     // A pointer to the activity data from which this strip will generate its
     // user-facing graphic.
-    const QVector<video_activity_c::activity_type_e> *activityData = nullptr;
+    activity_timeline_c *activityData = nullptr;
+
+    // The strip's graphic at one pixel tall, kept so that it can be updated in
+    // parts as the activity data changes.
+    QImage stripImage;
 
     // Graph colors. These may be changed by the user, later.
     QColor activeColor = QColor("green");
@@ -12,17 +12,27 @@
 #include <QMouseEvent>
 #include <QDropEvent>
 #include <QMimeData>
+#include <QMenuBar>
+#include <QMenu>
+#include <QFileDialog>
 #include <QFileInfo>
+#include <QStatusBar>
 #include <QShortcut>
 #include <QPainter>
 #include <QPixmap>
+#include <QImage>
 #include <QDebug>
 #include <QTimer>
 #include <QLabel>
+#include <cmath>
+#include "../../src/gui_qt/qt_thresholds_dialog.h"
+#include "../../src/gui_qt/qt_mask_overlay.h"
 #include "../../src/gui_qt/qt_main_window.h"
+#include "../../src/video/analysis_queue.h"
 #include "../../src/video/video_activity.h"
 #include "../../src/video/video_object.h"
 #include "../../src/video/video_player.h"
+#include "../../src/video/video_probe.h"
 #include "../../src/messager/messager.h"
 #include "../../src/video/video_info.h"
 #include "../../src/common.h"
@@ -38,6 +48,89 @@ MainWindow::MainWindow(QWidget *parent) :
 
     messager = new messager_c(ui->centralWidget);
 
+    this->analysisQueue = new analysis_queue_c(messager, this);
+
+    // Redraw the activity strips of the video being shown when its activity gets
+    // re-judged under new thresholds.
+    connect(this->analysisQueue, &analysis_queue_c::activity_rethresholded,
+                           this, [this](video_object_c *const video)
+    {
+        if (video == this->video)
+        {
+            this->update_activity_strips();
+        }
+    });
+
+    // Create the menus, from which the current video's segments of activity can be
+    // exported, the thresholds of the analysis adjusted, and the regions of the
+    // frames it's restricted to drawn.
+    {
+        QMenu *const fileMenu = this->menuBar()->addMenu("File");
+        connect(fileMenu->addAction("Export highlights..."), &QAction::triggered,
+                                                       this, [this]
+        {
+            this->export_segments(segment_exporter_c::export_format_e::Highlights);
+        });
+
+        connect(fileMenu->addAction("Export EDL..."), &QAction::triggered,
+                                                this, [this]
+        {
+            this->export_segments(segment_exporter_c::export_format_e::Edl);
+        });
+
+        connect(fileMenu->addAction("Export FFmpeg concat list..."), &QAction::triggered,
+                                                               this, [this]
+        {
+            this->export_segments(segment_exporter_c::export_format_e::Ffconcat);
+        });
+
+        fileMenu->addSeparator();
+
+        connect(fileMenu->addAction("Cancel export"), &QAction::triggered,
+                                                this, &MainWindow::cancel_export);
+
+        this->thresholdsDialog = new ThresholdsDialog(this->analysisQueue, this);
+
+        QMenu *const analysisMenu = this->menuBar()->addMenu("Analysis");
+        connect(analysisMenu->addAction("Thresholds..."), &QAction::triggered,
+                                                    this, [this]
+        {
+            // The video activity can only be re-judged under new thresholds from
+            // the frames' scores, which the analyses don't keep until asked to.
+            if (!this->analysisQueue->thresholds().keepFrameScores)
+            {
+                this->restart_analyses([this]{ this->analysisQueue->keep_frame_scores(); });
+            }
+
+            this->thresholdsDialog->show();
+            this->thresholdsDialog->raise();
+        });
+
+        analysisMenu->addSeparator();
+
+        connect(analysisMenu->addAction("Draw inclusion region"), &QAction::triggered,
+                                                            this, [this]
+        {
+            this->maskOverlay->set_drawing_mode(MaskOverlay::drawing_mode_e::inclusion);
+        });
+
+        connect(analysisMenu->addAction("Draw exclusion region"), &QAction::triggered,
+                                                            this, [this]
+        {
+            this->maskOverlay->set_drawing_mode(MaskOverlay::drawing_mode_e::exclusion);
+        });
+
+        connect(analysisMenu->addAction("Clear regions"), &QAction::triggered,
+                                                    this, [this]
+        {
+            if (!this->maskOverlay->regions().isEmpty())
+            {
+                this->maskOverlay->set_regions({});
+                this->apply_mask_regions({});
+            }
+        });
+    }
+
     // Style and initialize the playback controls area, including activity strips.
     {
         ui->widget_activityStrips->setStyleSheet("background-color: #404040;");
@@ -50,6 +143,23 @@ MainWindow::MainWindow(QWidget *parent) :
         this->mouseOverIndicator->setParent(ui->widget_activityStrips);
         this->mouseOverIndicator->setAttribute(Qt::WA_TransparentForMouseEvents);
         this->mouseOverIndicator->setVisible(false);
+
+        this->thumbnailPreview = new QLabel(ui->centralWidget);
+        this->thumbnailPreview->setStyleSheet("border: 1px solid #eeeeee;");
+        this->thumbnailPreview->setAttribute(Qt::WA_TransparentForMouseEvents);
+        this->thumbnailPreview->setVisible(false);
+    }
+
+    // Create the status bar, for showing the progress of the analysis.
+    {
+        this->statusBar()->setStyleSheet("background-color: #404040; color: #c0c0c0;");
+        this->statusBar()->setSizeGripEnabled(false);
+
+        this->analysisStatusLabel = new QLabel(this);
+        this->statusBar()->addWidget(this->analysisStatusLabel, 1);
+
+        this->exportStatusLabel = new QLabel(this);
+        this->statusBar()->addPermanentWidget(this->exportStatusLabel);
     }
 
     // Create the video player we'll use to display videos to the user.
@@ -63,12 +173,22 @@ MainWindow::MainWindow(QWidget *parent) :
                          messager, &messager_c::new_message);
     }
 
+    // Create the overlay for drawing the regions of the frames to which the
+    // analysis is restricted.
+    {
+        this->maskOverlay = new MaskOverlay(ui->widget_videoCanvas);
+
+        connect(this->maskOverlay, &MaskOverlay::regions_changed,
+                             this, &MainWindow::apply_mask_regions);
+    }
+
     // Give the UI elements their proper depth order.
     {
         ui->activityStrip_videoActivity->raise();
         this->mouseOverIndicator->raise();
         ui->widget_videoCanvas->raise();
         this->videoPlayer->raise();
+        this->maskOverlay->raise();
     }
 
     // Assign event filters.
@@ -96,6 +216,10 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(this->stripUpdateTimer, &QTimer::timeout,
                               this, &MainWindow::update_activity_strips);
 
+    this->exportStatusTimer = new QTimer(this);
+    connect(this->exportStatusTimer, &QTimer::timeout,
+                               this, &MainWindow::update_export_status);
+
     // Assign keyboard shortcuts.
     {
         QShortcut *keybShortcutPlay = new QShortcut(QKeySequence(Qt::Key_Space), this);
@@ -112,12 +236,33 @@ MainWindow::MainWindow(QWidget *parent) :
         keybShortcutSeekRight->setContext(Qt::ApplicationShortcut);
         connect(keybShortcutSeekRight, &QShortcut::activated,
                                  this, [this]{ this->playback_seek_ms(2000); });
+
+        QShortcut *keybShortcutPrevActivity = new QShortcut(QKeySequence(Qt::CTRL + Qt::Key_Left), this);
+        keybShortcutPrevActivity->setContext(Qt::ApplicationShortcut);
+        connect(keybShortcutPrevActivity, &QShortcut::activated,
+                                    this, [this]{ this->playback_seek_to_activity(false); });
+
+        QShortcut *keybShortcutNextActivity = new QShortcut(QKeySequence(Qt::CTRL + Qt::Key_Right), this);
+        keybShortcutNextActivity->setContext(Qt::ApplicationShortcut);
+        connect(keybShortcutNextActivity, &QShortcut::activated,
+                                    this, [this]{ this->playback_seek_to_activity(true); });
+
+        QShortcut *keybShortcutPrevVideo = new QShortcut(QKeySequence(Qt::Key_PageUp), this);
+        keybShortcutPrevVideo->setContext(Qt::ApplicationShortcut);
+        connect(keybShortcutPrevVideo, &QShortcut::activated,
+                                 this, [this]{ this->show_adjacent_video(-1); });
+
+        QShortcut *keybShortcutNextVideo = new QShortcut(QKeySequence(Qt::Key_PageDown), this);
+        keybShortcutNextVideo->setContext(Qt::ApplicationShortcut);
+        connect(keybShortcutNextVideo, &QShortcut::activated,
+                                 this, [this]{ this->show_adjacent_video(1); });
     }
 
     // Have these calls last. They attempt to ensure that widgets are in their
     // proper initial places.
     this->show();
     this->videoPlayer->fit_player_to_parent();
+    this->fit_mask_overlay_to_video();
 
     return;
 }
@@ -165,10 +310,17 @@ QPixmap MainWindow::create_mouseover_pixmap(const QSize size, const uint videoOr
 //
 void MainWindow::update_activity_strips(void)
 {
-    ui->activityStrip_videoActivity->regenerate_activity_strip();
-    ui->activityStrip_audioActivity->regenerate_activity_strip();
+    // Check for completion first, so that whatever the analysis wrote before
+    // finishing gets drawn by this update.
+    const bool buildHasFinished = videoPlayer->video_activity().strip_build_has_finished();
 
-    if (videoPlayer->video_activity().strip_build_has_finished())
+    // Only the parts of the strips whose data has changed get redrawn.
+    ui->activityStrip_videoActivity->update_activity_strip();
+    ui->activityStrip_audioActivity->update_activity_strip();
+
+    this->update_analysis_status();
+
+    if (buildHasFinished)
     {
         stripUpdateTimer->stop();
     }
@@ -182,7 +334,17 @@ void MainWindow::closeEvent(QCloseEvent *)
     // delete the video to which their pointer(s) may point.
     stripUpdateTimer->stop();
 
-    delete video;
+    if (video != nullptr)
+    {
+        video->detach_from_player();
+        video = nullptr;
+    }
+
+    this->cancel_export();
+
+    delete analysisQueue;
+    analysisQueue = nullptr;
+
     delete videoPlayer;
 
     return;
@@ -191,6 +353,7 @@ void MainWindow::closeEvent(QCloseEvent *)
 void MainWindow::resizeEvent(QResizeEvent *)
 {
     videoPlayer->fit_player_to_parent();
+    this->fit_mask_overlay_to_video();
     messager->reorder_message_labels();
 
     return;
@@ -205,6 +368,7 @@ bool MainWindow::eventFilter(QObject *object, QEvent *event)
         if ((object->objectName() != ui->widget_activityStrips->objectName()))
         {
             mouseOverIndicator->setVisible(false);
+            thumbnailPreview->setVisible(false);
             return false;
         }
 
@@ -228,6 +392,8 @@ bool MainWindow::eventFilter(QObject *object, QEvent *event)
         mouseOverIndicator->setVisible(true);
         mouseOverIndicator->setPixmap(create_mouseover_pixmap(mouseOverIndicator->size(), videoOrAudio, xOffs, yOffs));
 
+        this->update_thumbnail_preview(xOffs);
+
         // If the user is holding a mouse button down while moving the mouse,
         // and not pressing any control keys, scroll the current media position.
         if (QApplication::mouseButtons() & Qt::LeftButton)
@@ -268,8 +434,10 @@ bool MainWindow::eventFilter(QObject *object, QEvent *event)
             uint frameIdx = ((videoPlayer->video_info().num_frames() / (real)strip->width()) * e->pos().x());
             if (videoPlayer->video_activity().is_active_frame_at(frameIdx, videoOrAudio))
             {
+                const uint seekBack = (videoPlayer->video_info().frame_rate() * 0.5); // Seek back by 500 milliseconds, for user convenience.
+
                 frameIdx = videoPlayer->video_activity().get_start_of_active_segment(frameIdx, videoOrAudio);
-                frameIdx -= (videoPlayer->video_info().frame_rate() * 0.5); // Seek back by 500 milliseconds, for user convenience.
+                frameIdx = ((frameIdx > seekBack)? (frameIdx - seekBack) : 0);
 
                 videoPlayer->seek_to_frame(frameIdx);
             }
@@ -302,11 +470,13 @@ bool MainWindow::eventFilter(QObject *object, QEvent *event)
     {
         // Make sure the mouse-over indicator is hidden when the mouse is outside of the screen.
         mouseOverIndicator->setVisible(false);
+        thumbnailPreview->setVisible(false);
     }
     else if (event->type() == QEvent::Enter)
     {
         // Make sure the mouse-over indicator is hidden when the mouse is outside of the screen.
         mouseOverIndicator->setVisible(false);
+        thumbnailPreview->setVisible(false);
     }
 
     return false;
@@ -321,6 +491,30 @@ void MainWindow::playback_seek_ms(const int ms)
     return;
 }
 
+// Seek to the start of the next/previous segment of activity on either of the
+// activity strips.
+//
+void MainWindow::playback_seek_to_activity(const bool forward)
+{
+    if (!videoPlayer->has_video())
+    {
+        return;
+    }
+
+    const uint curFrameIdx = std::round((videoPlayer->playback_pos_ms() / 1000.0) * videoPlayer->video_info().frame_rate());
+    uint targetFrameIdx = 0;
+
+    const bool found = forward? videoPlayer->video_activity().get_next_active_segment(curFrameIdx, 2, targetFrameIdx)
+                              : videoPlayer->video_activity().get_previous_active_segment(curFrameIdx, 2, targetFrameIdx);
+
+    if (found)
+    {
+        videoPlayer->seek_to_frame(targetFrameIdx);
+    }
+
+    return;
+}
+
 void MainWindow::toggle_playback(void)
 {
     if (videoPlayer->is_playing())
@@ -335,34 +529,89 @@ void MainWindow::toggle_playback(void)
     return;
 }
 
-// Attempts to change the video we're currently operating on.
+// Adds the given videos to the analysis queue, and shows the first of them.
+//
+void MainWindow::insert_videos(const QStringList &filenames)
+{
+    if (filenames.isEmpty())
+    {
+        return;
+    }
+
+    this->analysisQueue->enqueue(filenames);
+    this->probe_and_show_video(filenames.first());
+
+    return;
+}
+
+// Reads the given file's metadata on a background thread, and once done, shows
+// the file. Opening a file can take a while, e.g. on a network share, and this
+// keeps the window responsive in the meantime. An earlier probe still under way
+// gets cancelled, so that asking for another file doesn't wait on the last one.
+//
+void MainWindow::probe_and_show_video(const QString filename)
+{
+    if (this->pendingProbe != nullptr)
+    {
+        this->pendingProbe->discard();
+        this->pendingProbe = nullptr;
+    }
+
+    this->pendingProbe = new video_probe_c(filename, this);
+
+    connect(this->pendingProbe, &video_probe_c::finished, this, [this](const QString probedFilename)
+    {
+        // Ignore probes that finished just as they were superseded.
+        if ((this->pendingProbe == nullptr) ||
+            (this->pendingProbe->file_name() != probedFilename))
+        {
+            return;
+        }
+
+        this->pendingProbe->deleteLater();
+        this->pendingProbe = nullptr;
+
+        // The video's metadata is now cached, so this won't need to touch the
+        // file for it.
+        this->show_video(probedFilename);
+    });
+
+    this->pendingProbe->start();
+
+    return;
+}
+
+// Attempts to change the video we're currently operating on to the given one
+// from the analysis queue.
 //
-void MainWindow::insert_video(const QString filename)
+void MainWindow::show_video(const QString filename)
 {
     // Don't want this timer firing while we've potentially got a null video.
     stripUpdateTimer->stop();
 
     if (this->video != nullptr)
     {
-        delete this->video;
+        this->video->detach_from_player();
     }
 
+    ui->activityStrip_videoActivity->set_strip_data_ptr(nullptr);
+    ui->activityStrip_audioActivity->set_strip_data_ptr(nullptr);
+
     // Attempt to insert the new video.
     {
-        this->video = new video_object_c(filename, messager);
-        video->assign_to_player(videoPlayer);
+        this->video = this->analysisQueue->video(filename);
 
         // If the insertion failed, remove the video from the system.
-        if (!this->video->info().is_valid_video())
+        if ((this->video == nullptr) ||
+            !this->video->info().is_valid_video())
         {
-            delete this->video;
+            this->analysisQueue->remove(filename);
             this->video = nullptr;
 
-            ui->activityStrip_videoActivity->set_strip_data_ptr(nullptr);
-            ui->activityStrip_audioActivity->set_strip_data_ptr(nullptr);
-
             goto done;
         }
+
+        video->assign_to_player(videoPlayer);
     }
 
     ui->activityStrip_videoActivity->set_strip_data_ptr(&video->video_activity_data());
@@ -376,7 +625,287 @@ void MainWindow::insert_video(const QString filename)
 
     done:
     this->update_window_title();
+    this->update_analysis_status();
     this->videoPlayer->fit_player_to_parent();
+    this->fit_mask_overlay_to_video();
+    return;
+}
+
+// Exports the current video's segments of activity, on either track, in the given
+// format, into a file the user is asked for. The export runs in the background,
+// with its progress shown in the status bar.
+//
+void MainWindow::export_segments(const segment_exporter_c::export_format_e format)
+{
+    if (this->segmentExporter != nullptr)
+    {
+        this->messager->new_message("Another export is still under way.");
+        return;
+    }
+
+    if ((this->video == nullptr) ||
+        !this->video->activity().strip_build_has_finished())
+    {
+        this->messager->new_message("The video's segments can be exported once its analysis has finished.");
+        return;
+    }
+
+    const std::vector<std::pair<uint, uint>> segments = this->video->activity().active_segments(2);
+    if (segments.empty())
+    {
+        this->messager->new_message("The video has no activity to export.");
+        return;
+    }
+
+    const QString videoFilename = this->video->info().file_name();
+    const QString outFilename = QFileDialog::getSaveFileName(this, "Export segments",
+                                                             segment_exporter_c::default_out_file_name(videoFilename, format));
+    if (outFilename.isEmpty())
+    {
+        return;
+    }
+
+    this->segmentExporter = new segment_exporter_c(videoFilename, segments, outFilename, format, this);
+
+    segment_exporter_c *const exporter = this->segmentExporter;
+
+    connect(this->segmentExporter, &segment_exporter_c::finished,
+                             this, [this, exporter](const QString outFilename, const bool succeeded)
+    {
+        // The export may have been cancelled after it had signalled this.
+        if (exporter != this->segmentExporter)
+        {
+            return;
+        }
+
+        this->messager->new_message(QString(succeeded? "Exported the segments into %1." : "Failed to export the segments into %1.")
+                                    .arg(QFileInfo(outFilename).fileName()));
+
+        // The exporter's thread is on its way out, having signalled this.
+        this->segmentExporter->deleteLater();
+        this->segmentExporter = nullptr;
+
+        this->exportStatusTimer->stop();
+        this->update_export_status();
+    });
+
+    this->segmentExporter->start();
+
+    this->exportStatusTimer->start(250);
+    this->update_export_status();
+
+    return;
+}
+
+// Cancels the export under way, if any, waiting for it to wind down.
+//
+void MainWindow::cancel_export(void)
+{
+    if (this->segmentExporter == nullptr)
+    {
+        return;
+    }
+
+    delete this->segmentExporter;
+    this->segmentExporter = nullptr;
+
+    this->exportStatusTimer->stop();
+    this->update_export_status();
+
+    return;
+}
+
+void MainWindow::update_export_status(void)
+{
+    if (this->segmentExporter == nullptr)
+    {
+        this->exportStatusLabel->clear();
+        return;
+    }
+
+    this->exportStatusLabel->setText(QString("Exporting: %1%").arg(uint(100 * this->segmentExporter->progress())));
+
+    return;
+}
+
+// Lays the mask overlay over the area the video is shown in, and above the video,
+// which gets raised as it's fitted to the canvas.
+//
+void MainWindow::fit_mask_overlay_to_video(void)
+{
+    if (!this->videoPlayer->has_video())
+    {
+        this->maskOverlay->hide();
+        return;
+    }
+
+    this->maskOverlay->setGeometry(this->videoPlayer->video_rect());
+    this->maskOverlay->show();
+    this->maskOverlay->raise();
+
+    return;
+}
+
+// Restricts the analysis of all of the queued videos to the given regions of their
+// frames. The videos need to be analyzed anew under the regions.
+//
+void MainWindow::apply_mask_regions(const QVector<activity_mask_region_s> &regions)
+{
+    this->restart_analyses([this, &regions]{ this->analysisQueue->set_mask_regions(regions); });
+
+    return;
+}
+
+// Has the given function change settings of the analysis queue that need the
+// queued videos to be analyzed anew. The video being shown is let go of for the
+// queue to discard, and then shown again.
+//
+void MainWindow::restart_analyses(const std::function<void(void)> &changeSettings)
+{
+    const QString shownFilename = ((this->video != nullptr)? this->video->info().file_name() : QString());
+
+    // Don't want this timer firing while we've got a null video.
+    stripUpdateTimer->stop();
+
+    if (this->video != nullptr)
+    {
+        this->video->detach_from_player();
+        this->video = nullptr;
+    }
+
+    ui->activityStrip_videoActivity->set_strip_data_ptr(nullptr);
+    ui->activityStrip_audioActivity->set_strip_data_ptr(nullptr);
+
+    changeSettings();
+
+    if (!shownFilename.isEmpty())
+    {
+        this->show_video(shownFilename);
+    }
+    else
+    {
+        this->update_window_title();
+        this->update_analysis_status();
+    }
+
+    return;
+}
+
+// Switches to the previous (direction < 0) or next (direction > 0) video in the
+// analysis queue.
+//
+void MainWindow::show_adjacent_video(const int direction)
+{
+    const QStringList filenames = this->analysisQueue->filenames();
+
+    if (filenames.isEmpty())
+    {
+        return;
+    }
+
+    const int curIdx = (this->video == nullptr)? -1 : filenames.indexOf(this->video->info().file_name());
+    const int newIdx = std::max(0, std::min((filenames.size() - 1), (curIdx + direction)));
+
+    if (newIdx != curIdx)
+    {
+        this->probe_and_show_video(filenames.at(newIdx));
+    }
+
+    return;
+}
+
+// Returns the given number of seconds as a string of the form h:mm:ss, or m:ss
+// if under an hour.
+//
+static QString duration_string(const real seconds)
+{
+    const uint totalSeconds = uint(std::max(0.0, std::round(seconds)));
+    const uint hours = (totalSeconds / 3600);
+    const uint minutes = ((totalSeconds / 60) % 60);
+
+    return ((hours > 0)? QString("%1:%2:%3").arg(hours).arg(minutes, 2, 10, QChar('0')).arg((totalSeconds % 60), 2, 10, QChar('0'))
+                       : QString("%1:%2").arg(minutes).arg((totalSeconds % 60), 2, 10, QChar('0')));
+}
+
+// Shows, just above the activity strips at the given x coordinate along them, the
+// thumbnail of the video's frame at that point, as made during the analysis; so
+// the user can see what's in the video without the player having to seek to it.
+// Hides the thumbnail if there's none to show.
+//
+void MainWindow::update_thumbnail_preview(const int stripX)
+{
+    cv::Mat thumbnail;
+
+    if (!this->videoPlayer->has_video() ||
+        !this->videoPlayer->video_activity().thumbnails().thumbnail(uint((this->videoPlayer->video_info().num_frames() / (real)std::max(1, ui->activityStrip_videoActivity->width())) * std::max(0, stripX)),
+                                                                    thumbnail))
+    {
+        this->thumbnailPreview->setVisible(false);
+        return;
+    }
+
+    const QImage image(thumbnail.data, thumbnail.cols, thumbnail.rows, int(thumbnail.step[0]), QImage::Format_RGB888);
+    this->thumbnailPreview->setPixmap(QPixmap::fromImage(image));
+    this->thumbnailPreview->adjustSize();
+
+    // Center the thumbnail on the cursor, keeping it within the window.
+    {
+        const QPoint stripPos = ui->widget_activityStrips->mapTo(ui->centralWidget, QPoint(stripX, 0));
+        const int x = std::max(0, std::min((ui->centralWidget->width() - this->thumbnailPreview->width()),
+                                           (stripPos.x() - (this->thumbnailPreview->width() / 2))));
+        const int y = std::max(0, (stripPos.y() - this->thumbnailPreview->height() - 4));
+
+        this->thumbnailPreview->move(x, y);
+    }
+
+    this->thumbnailPreview->setVisible(true);
+    this->thumbnailPreview->raise();
+
+    return;
+}
+
+// Shows in the status bar how far along the analysis of the current video is:
+// the share of each track analyzed, the rate at which the video's frames are
+// getting analyzed, and an estimate of the time left.
+//
+void MainWindow::update_analysis_status(void)
+{
+    if (!this->videoPlayer->has_video())
+    {
+        this->analysisStatusLabel->clear();
+        return;
+    }
+
+    const video_activity_progress_s progress = this->videoPlayer->video_activity().progress();
+
+    if (progress.numFrames == 0)
+    {
+        this->analysisStatusLabel->clear();
+        return;
+    }
+
+    if (progress.isFinished)
+    {
+        this->analysisStatusLabel->setText(QString("Analysis done (took %1)").arg(duration_string(progress.elapsedSeconds)));
+        return;
+    }
+
+    QString status = QString("Analyzing: video %1%, audio %2%")
+                     .arg(uint((100.0 * progress.numVideoFramesDone) / progress.numFrames))
+                     .arg(uint((100.0 * progress.numAudioFramesDone) / progress.numFrames));
+
+    if (progress.elapsedSeconds > 0)
+    {
+        status += QString(" - %1 frames/s").arg(uint(progress.numVideoFramesDone / progress.elapsedSeconds));
+    }
+
+    if (progress.etaSeconds >= 0)
+    {
+        status += QString(" - about %1 left").arg(duration_string(progress.etaSeconds));
+    }
+
+    this->analysisStatusLabel->setText(status);
+
     return;
 }
 
@@ -388,6 +917,13 @@ void MainWindow::update_window_title(void)
     {
         title = QString("%1 - %2").arg(this->videoPlayer->video_info().file_name_sans_path())
                                   .arg(PROGRAM_TITLE);
+
+        const QStringList queuedFilenames = this->analysisQueue->filenames();
+        if (queuedFilenames.size() > 1)
+        {
+            title.prepend(QString("[%1/%2] ").arg(queuedFilenames.indexOf(this->videoPlayer->video_info().file_name()) + 1)
+                                             .arg(queuedFilenames.size()));
+        }
     }
 
     this->setWindowTitle(title);
@@ -414,15 +950,16 @@ void MainWindow::dropEvent(QDropEvent *event)
 {
     k_assert(!event->mimeData()->urls().isEmpty(), "Expected to receive a file as a drop.");
 
-    if (event->mimeData()->urls().size() > 1)
+    QStringList filenames;
+    for (const QUrl &url: event->mimeData()->urls())
     {
-        INFO(("Received multiple files as a drop. Ignoring all but the first one."));
+        /// FIXME. Pretty scummy string conversion. Getting proper file name strings
+        ///        from drop URLs seems to not be trivial.
+        QString filename = QUrl::fromPercentEncoding(url.toString().toUtf8());
+        filenames << filename.remove("file://");
     }
 
-    /// FIXME. Pretty scummy string conversion. Getting proper file name strings
-    ///        from drop URLs seems to not be trivial.
-    QString filename = QUrl::fromPercentEncoding(event->mimeData()->urls().at(0).toString().toUtf8());
-    this->insert_video(filename.remove("file://"));
+    this->insert_videos(filenames);
 
     return;
 }
@@ -8,13 +8,22 @@
 #define MAIN_WINDOW_H
 
 #include <QMainWindow>
+#include <QStringList>
+#include <QVector>
+#include <functional>
+#include "../../src/video/segment_exporter.h"
 
+class ThresholdsDialog;
+class MaskOverlay;
 class QLabel;
 class QTimer;
 class video_player_c;
 class video_info_c;
 class video_object_c;
+class analysis_queue_c;
+class video_probe_c;
 class messager_c;
+struct activity_mask_region_s;
 
 namespace Ui {
 class MainWindow;
@@ -40,6 +49,8 @@ private slots:
 
     void playback_seek_ms(const int ms);
 
+    void playback_seek_to_activity(const bool forward);
+
 private:
     bool eventFilter(QObject *object, QEvent *event);
     void resizeEvent(QResizeEvent *);
@@ -53,10 +64,40 @@ private:
 
     void update_window_title();
 
-    void insert_video(const QString filename);
+    void update_analysis_status(void);
+
+    void update_thumbnail_preview(const int stripX);
+
+    void insert_videos(const QStringList &filenames);
+
+    void probe_and_show_video(const QString filename);
+
+    void show_video(const QString filename);
+
+    void show_adjacent_video(const int direction);
+
+    void fit_mask_overlay_to_video(void);
+
+    void apply_mask_regions(const QVector<activity_mask_region_s> &regions);
+
+    void restart_analyses(const std::function<void(void)> &changeSettings);
+
+    void export_segments(const segment_exporter_c::export_format_e format);
 
+    void cancel_export(void);
+
+    void update_export_status(void);
+
+    // The video being shown to the user. Owned by the analysis queue.
     video_object_c *video = nullptr;
 
+    // The probe of the video about to be shown, while it's being probed. Owned by
+    // this window.
+    video_probe_c *pendingProbe = nullptr;
+
+    // All of the videos the user has given us, which get analyzed in the background.
+    analysis_queue_c *analysisQueue = nullptr;
+
     video_player_c *videoPlayer = nullptr;
 
     // For showing messages/notifications to the user from the program.
@@ -65,9 +106,33 @@ private:
     // Shown in the GUI for when the mouse hovers over video playback controls.
     QLabel *mouseOverIndicator = nullptr;
 
+    // Shown above the activity strips for when the mouse hovers over them, with a
+    // thumbnail of the video's frame under the cursor.
+    QLabel *thumbnailPreview = nullptr;
+
+    // For adjusting the thresholds by which the videos' activity is judged.
+    ThresholdsDialog *thresholdsDialog = nullptr;
+
+    // Shown over the video, for drawing the regions of its frames to which the
+    // analysis is restricted.
+    MaskOverlay *maskOverlay = nullptr;
+
+    // Shows, in the status bar, how far along the analysis of the current video
+    // is, and how fast it's going.
+    QLabel *analysisStatusLabel = nullptr;
+
     // Used to keep periodically checking on the threaded progress of video
     // analysis, and to update the GUI on its progress.
     QTimer *stripUpdateTimer = nullptr;
+
+    // Exports the current video's segments of activity in the background, while an
+    // export is under way; null otherwise. Owned by this window.
+    segment_exporter_c *segmentExporter = nullptr;
+
+    // Shows, in the status bar, how far along the export is; and is updated by the
+    // timer while the export is under way.
+    QLabel *exportStatusLabel = nullptr;
+    QTimer *exportStatusTimer = nullptr;
 };
 
 #endif // MAIN_WINDOW_H
@@ -0,0 +1,162 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors.
+ *
+ * An overlay over the video being shown, for drawing the regions of its frames
+ * to which the activity analysis is restricted. Inclusions are drawn outlined in
+ * green, and exclusions filled in red.
+ *
+ */
+
+#include <QMouseEvent>
+#include <QPainter>
+#include <algorithm>
+#include <cmath>
+#include "../../src/gui_qt/qt_mask_overlay.h"
+#include "../../src/common.h"
+
+// Rectangles smaller than this many pixels across are taken for stray clicks
+// rather than regions.
+static const int MIN_REGION_SIZE_PX = 4;
+
+MaskOverlay::MaskOverlay(QWidget *parent) :
+    QWidget(parent)
+{
+    this->setAttribute(Qt::WA_TransparentForMouseEvents);
+
+    return;
+}
+
+void MaskOverlay::set_regions(const QVector<activity_mask_region_s> &regions)
+{
+    this->maskRegions = regions;
+    this->update();
+
+    return;
+}
+
+const QVector<activity_mask_region_s>& MaskOverlay::regions(void) const
+{
+    return this->maskRegions;
+}
+
+// Has the next rectangle the user drags out over the overlay be added as a region
+// of the given kind; or, with drawing_mode_e::none, have the overlay ignore the
+// mouse.
+//
+void MaskOverlay::set_drawing_mode(const drawing_mode_e mode)
+{
+    this->drawingMode = mode;
+    this->isDragging = false;
+
+    this->setAttribute(Qt::WA_TransparentForMouseEvents, (mode == drawing_mode_e::none));
+    this->setCursor((mode == drawing_mode_e::none)? Qt::ArrowCursor : Qt::CrossCursor);
+    this->update();
+
+    return;
+}
+
+// Returns the area of the overlay, in pixels, that the given region covers.
+//
+QRect MaskOverlay::region_rect(const activity_mask_region_s &region) const
+{
+    return QRect(std::round(region.x * this->width()),
+                 std::round(region.y * this->height()),
+                 std::round(region.width * this->width()),
+                 std::round(region.height * this->height()));
+}
+
+void MaskOverlay::paintEvent(QPaintEvent *)
+{
+    QPainter painter(this);
+
+    for (const auto &region: this->maskRegions)
+    {
+        if (region.isExclusion)
+        {
+            painter.setPen(QPen(QColor(220, 60, 60), 1));
+            painter.setBrush(QBrush(QColor(220, 60, 60, 90)));
+        }
+        else
+        {
+            painter.setPen(QPen(QColor(120, 220, 100), 2));
+            painter.setBrush(Qt::NoBrush);
+        }
+
+        painter.drawRect(this->region_rect(region));
+    }
+
+    if (this->isDragging)
+    {
+        painter.setPen(QPen(QColor("#eeeeee"), 1, Qt::DashLine));
+        painter.setBrush(Qt::NoBrush);
+        painter.drawRect(QRect(this->dragStart, this->dragEnd).normalized());
+    }
+
+    return;
+}
+
+void MaskOverlay::mousePressEvent(QMouseEvent *event)
+{
+    if ((this->drawingMode == drawing_mode_e::none) ||
+        (event->button() != Qt::LeftButton))
+    {
+        return;
+    }
+
+    this->isDragging = true;
+    this->dragStart = this->dragEnd = event->pos();
+
+    return;
+}
+
+void MaskOverlay::mouseMoveEvent(QMouseEvent *event)
+{
+    if (!this->isDragging)
+    {
+        return;
+    }
+
+    this->dragEnd = QPoint(std::max(0, std::min(this->width(), event->x())),
+                           std::max(0, std::min(this->height(), event->y())));
+    this->update();
+
+    return;
+}
+
+void MaskOverlay::mouseReleaseEvent(QMouseEvent *event)
+{
+    if (!this->isDragging ||
+        (event->button() != Qt::LeftButton))
+    {
+        return;
+    }
+
+    const QRect rect = QRect(this->dragStart, this->dragEnd).normalized();
+    const bool isExclusion = (this->drawingMode == drawing_mode_e::exclusion);
+
+    // One region gets drawn per request to draw one.
+    this->set_drawing_mode(drawing_mode_e::none);
+
+    if ((rect.width() < MIN_REGION_SIZE_PX) ||
+        (rect.height() < MIN_REGION_SIZE_PX) ||
+        (this->width() <= 0) ||
+        (this->height() <= 0))
+    {
+        return;
+    }
+
+    activity_mask_region_s region;
+    region.x = (rect.x() / real(this->width()));
+    region.y = (rect.y() / real(this->height()));
+    region.width = (rect.width() / real(this->width()));
+    region.height = (rect.height() / real(this->height()));
+    region.isExclusion = isExclusion;
+
+    this->maskRegions << region;
+    this->update();
+
+    emit regions_changed(this->maskRegions);
+
+    return;
+}
@@ -0,0 +1,63 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors.
+ *
+ */
+
+#ifndef MASK_OVERLAY_H
+#define MASK_OVERLAY_H
+
+#include <QWidget>
+#include <QVector>
+#include "../../src/video/activity_mask.h"
+
+// Sits over the video being shown, drawing the regions of its frames to which the
+// activity analysis is restricted, and letting the user add new ones by dragging
+// out a rectangle with the mouse. The regions are held in fractions of the
+// overlay's size, so the overlay is to be kept fitted to the video.
+//
+class MaskOverlay : public QWidget
+{
+    Q_OBJECT
+
+public:
+    enum class drawing_mode_e
+    {
+        none,
+        inclusion,
+        exclusion,
+    };
+
+    explicit MaskOverlay(QWidget *parent = 0);
+
+    void set_regions(const QVector<activity_mask_region_s> &regions);
+
+    const QVector<activity_mask_region_s>& regions(void) const;
+
+    void set_drawing_mode(const drawing_mode_e mode);
+
+signals:
+    // Emitted when the user has added a region.
+    void regions_changed(const QVector<activity_mask_region_s> &regions);
+
+private:
+    void paintEvent(QPaintEvent *);
+    void mousePressEvent(QMouseEvent *event);
+    void mouseMoveEvent(QMouseEvent *event);
+    void mouseReleaseEvent(QMouseEvent *event);
+
+    QRect region_rect(const activity_mask_region_s &region) const;
+
+    QVector<activity_mask_region_s> maskRegions;
+
+    // What kind of region, if any, dragging the mouse over the overlay adds. The
+    // overlay lets the mouse through to what's under it while not drawing.
+    drawing_mode_e drawingMode = drawing_mode_e::none;
+
+    // The corners of the rectangle being dragged out, while the user is drawing one.
+    bool isDragging = false;
+    QPoint dragStart;
+    QPoint dragEnd;
+};
+
+#endif
@@ -0,0 +1,109 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors.
+ *
+ * A dialog for adjusting the thresholds of the activity analysis. The dialog
+ * isn't modal, so that the user can keep an eye on the activity strips while
+ * adjusting the values.
+ *
+ */
+
+#include <QDoubleSpinBox>
+#include <QFormLayout>
+#include <QSpinBox>
+#include "../../src/gui_qt/qt_thresholds_dialog.h"
+#include "../../src/video/analysis_queue.h"
+#include "../../src/video/video_activity.h"
+#include "../../src/common.h"
+
+ThresholdsDialog::ThresholdsDialog(analysis_queue_c *const analysisQueue, QWidget *parent) :
+    QDialog(parent),
+    analysisQueue(analysisQueue)
+{
+    k_assert((analysisQueue != nullptr), "Expected an analysis queue for the thresholds dialog.");
+
+    const video_activity_settings_s &thresholds = this->analysisQueue->thresholds();
+
+    this->setWindowTitle("Activity thresholds");
+
+    // Create the value fields.
+    {
+        this->pixelDiffThreshold = new QSpinBox(this);
+        this->pixelDiffThreshold->setRange(1, 254);
+        this->pixelDiffThreshold->setValue(thresholds.pixelDiffThreshold);
+        this->pixelDiffThreshold->setToolTip("How much a pixel's color needs to change for the pixel to count as changed.");
+
+        this->tileMinForeground = new QDoubleSpinBox(this);
+        this->tileMinForeground->setRange(0.1, 100);
+        this->tileMinForeground->setDecimals(1);
+        this->tileMinForeground->setSuffix(" %");
+        this->tileMinForeground->setValue(thresholds.backgroundTileMinForeground * 100);
+        this->tileMinForeground->setToolTip("With the background model detector, how much of some part of the frame\n"
+                                            "needs to differ from the background for the frame to show activity.");
+
+        this->activityHoldSeconds = new QDoubleSpinBox(this);
+        this->activityHoldSeconds->setRange(0, 600);
+        this->activityHoldSeconds->setDecimals(1);
+        this->activityHoldSeconds->setSuffix(" s");
+        this->activityHoldSeconds->setSpecialValueText("Automatic");
+        this->activityHoldSeconds->setValue(thresholds.activityHoldSeconds);
+        this->activityHoldSeconds->setToolTip("For how long activity carries on past the frame it was found in.\n"
+                                              "Automatic is 1/50th of the video's length.");
+
+        this->audioThresholdDeviations = new QDoubleSpinBox(this);
+        this->audioThresholdDeviations->setRange(0.5, 100);
+        this->audioThresholdDeviations->setDecimals(1);
+        this->audioThresholdDeviations->setValue(thresholds.audioThresholdDeviations);
+        this->audioThresholdDeviations->setToolTip("How far above its typical loudness the audio needs to rise to count as activity,\n"
+                                                   "in multiples of how far it typically strays from it.");
+    }
+
+    // Lay out the fields.
+    {
+        QFormLayout *const layout = new QFormLayout(this);
+
+        layout->addRow("Pixel difference:", this->pixelDiffThreshold);
+        layout->addRow("Tile foreground:", this->tileMinForeground);
+        layout->addRow("Activity hold:", this->activityHoldSeconds);
+        layout->addRow("Audio loudness:", this->audioThresholdDeviations);
+    }
+
+    // Re-judge the videos as the values change. The fields only report a value
+    // once it's been entered in full, or stepped to.
+    {
+        this->pixelDiffThreshold->setKeyboardTracking(false);
+        this->tileMinForeground->setKeyboardTracking(false);
+        this->activityHoldSeconds->setKeyboardTracking(false);
+        this->audioThresholdDeviations->setKeyboardTracking(false);
+
+        connect(this->pixelDiffThreshold, static_cast<void(QSpinBox::*)(int)>(&QSpinBox::valueChanged),
+                                    this, &ThresholdsDialog::apply_thresholds);
+
+        connect(this->tileMinForeground, static_cast<void(QDoubleSpinBox::*)(double)>(&QDoubleSpinBox::valueChanged),
+                                   this, &ThresholdsDialog::apply_thresholds);
+
+        connect(this->activityHoldSeconds, static_cast<void(QDoubleSpinBox::*)(double)>(&QDoubleSpinBox::valueChanged),
+                                     this, &ThresholdsDialog::apply_thresholds);
+
+        connect(this->audioThresholdDeviations, static_cast<void(QDoubleSpinBox::*)(double)>(&QDoubleSpinBox::valueChanged),
+                                          this, &ThresholdsDialog::apply_thresholds);
+    }
+
+    return;
+}
+
+// Has the analysis queue re-judge its videos under the values in the fields.
+//
+void ThresholdsDialog::apply_thresholds(void)
+{
+    video_activity_settings_s thresholds = this->analysisQueue->thresholds();
+
+    thresholds.pixelDiffThreshold = u8(this->pixelDiffThreshold->value());
+    thresholds.backgroundTileMinForeground = (this->tileMinForeground->value() / 100);
+    thresholds.activityHoldSeconds = this->activityHoldSeconds->value();
+    thresholds.audioThresholdDeviations = this->audioThresholdDeviations->value();
+
+    this->analysisQueue->set_thresholds(thresholds);
+
+    return;
+}
@@ -0,0 +1,38 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors.
+ *
+ */
+
+#ifndef THRESHOLDS_DIALOG_H
+#define THRESHOLDS_DIALOG_H
+
+#include <QDialog>
+
+class analysis_queue_c;
+class QDoubleSpinBox;
+class QSpinBox;
+
+// Lets the user adjust the thresholds by which the queued videos' activity is
+// judged. The videos get re-judged as the values are changed, without needing to
+// be analyzed again.
+//
+class ThresholdsDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit ThresholdsDialog(analysis_queue_c *const analysisQueue, QWidget *parent = 0);
+
+private:
+    void apply_thresholds(void);
+
+    QSpinBox *pixelDiffThreshold = nullptr;
+    QDoubleSpinBox *tileMinForeground = nullptr;
+    QDoubleSpinBox *activityHoldSeconds = nullptr;
+    QDoubleSpinBox *audioThresholdDeviations = nullptr;
+
+    analysis_queue_c *const analysisQueue;
+};
+
+#endif
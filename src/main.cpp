@@ -13,13 +13,25 @@
 
 #include <QApplication>
 #include <QFileDialog>
+#include <QMessageBox>
 #include "../../src/common.h"
 #include "qt_main_window.h"
 
+// Shows the user a failed assertion's error string.
+//
+static void show_assertion_failure(const char *const errorString)
+{
+    QMessageBox::critical(nullptr, "AV Scissors assertion failure", errorString);
+
+    return;
+}
+
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
 
+    kAssertionNotifier = show_assertion_failure;
+
     MainWindow w;
     w.show();
 
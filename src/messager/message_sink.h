@@ -0,0 +1,28 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors
+ *
+ */
+
+#ifndef MESSAGE_SINK_H
+#define MESSAGE_SINK_H
+
+#include <QObject>
+#include <QString>
+
+// The interface through which the program's units send messages meant for the
+// user. Carries no GUI dependencies, so that the analysis engine can also be used
+// headlessly; the GUI's messager_c shows the messages as popups, while the
+// command-line tool prints them out.
+class message_sink_c : public QObject
+{
+    Q_OBJECT
+
+public:
+    virtual ~message_sink_c(void) {}
+
+public slots:
+    virtual void new_message(const QString &message) = 0;
+};
+
+#endif
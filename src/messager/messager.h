@@ -11,9 +11,10 @@
 #include <QLabel>
 #include <QDebug>
 #include <QList>
+#include "../../src/messager/message_sink.h"
 #include "../../src/common.h"
 
-class messager_c : public QObject
+class messager_c : public message_sink_c
 {
     Q_OBJECT
 
@@ -26,7 +27,7 @@ public:
     void remove_all_messages();
 
 public slots:
-    void new_message(const QString &message);
+    void new_message(const QString &message) override;
 
 private slots:
     void remove_message(QLabel *const label);
@@ -0,0 +1,224 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors.
+ *
+ * Stores the results of a video's activity analysis on disk, so that re-opening
+ * the video later needn't involve analyzing it again.
+ *
+ * Each video gets its own file in the user's cache directory, in a subdirectory
+ * shared by the GUI and the command-line tool so that either can reuse the other's
+ * results. The video is identified by its path, size, modification time, and a
+ * hash of the start of its contents; if any of those change, the cached results
+ * are considered stale. The results are also stored along with a signature of
+ * the detector settings they were computed with, and are only given out for a
+ * matching signature.
+ *
+ * Along with the frames' activity, the per-frame measures it was judged by get
+ * stored, too - the audio's loudness, and the frames' scores if the analysis kept
+ * them - so that the results can be re-judged under other thresholds on loading.
+ * So do the thumbnails of the video's frames, if the analysis made them, already
+ * packed (and compressed) by thumbnail_sheet_c.
+ *
+ */
+
+#include <QCryptographicHash>
+#include <QStandardPaths>
+#include <QDataStream>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QFile>
+#include <QDir>
+#include "../../src/video/activity_cache.h"
+#include "../../src/common.h"
+
+// Identifies the file as an activity cache file, and the version of its format.
+static const quint32 CACHE_FILE_MAGIC = 0x43535641; // "AVSC".
+static const quint32 CACHE_FILE_VERSION = 3;
+
+// The directory, under the user's cache directory, that the files are stored in.
+// Not named after the running program, so that all of them share the files.
+static const char CACHE_DIR_NAME[] = "avscissors/activity";
+
+// How many bytes from the start of the video file to hash for identifying it.
+static const qint64 CONTENT_HASH_LENGTH = (1024 * 1024);
+
+// Returns the given values packed into a byte array, for storing.
+//
+static QByteArray packed_values(const QVector<float> &values)
+{
+    QByteArray packed;
+    QDataStream stream(&packed, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_5);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    stream << values;
+
+    return packed;
+}
+
+// Returns the values packed into the given byte array by packed_values(), or an
+// empty vector if they couldn't be unpacked.
+//
+static QVector<float> unpacked_values(const QByteArray &packed)
+{
+    QVector<float> values;
+    QDataStream stream(packed);
+    stream.setVersion(QDataStream::Qt_5_5);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    stream >> values;
+
+    return ((stream.status() == QDataStream::Ok)? values : QVector<float>());
+}
+
+activity_cache_c::activity_cache_c(const QString &videoFilename)
+{
+    const QFileInfo fileInfo(videoFilename);
+    if (!fileInfo.exists())
+    {
+        return;
+    }
+
+    this->videoFilename = fileInfo.canonicalFilePath();
+    this->videoFileSize = fileInfo.size();
+    this->videoFileModified = fileInfo.lastModified().toMSecsSinceEpoch();
+
+    // Hash the start of the file's contents.
+    {
+        QFile file(videoFilename);
+        if (!file.open(QIODevice::ReadOnly))
+        {
+            return;
+        }
+
+        this->videoContentHash = QCryptographicHash::hash(file.read(CONTENT_HASH_LENGTH), QCryptographicHash::Sha1);
+    }
+
+    // Derive the cache file's name from the video's identifying properties.
+    {
+        const QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation);
+        if (cacheDir.isEmpty())
+        {
+            return;
+        }
+
+        QCryptographicHash key(QCryptographicHash::Sha1);
+        key.addData(this->videoFilename.toUtf8());
+        key.addData(QByteArray::number(this->videoFileSize));
+        key.addData(QByteArray::number(this->videoFileModified));
+        key.addData(this->videoContentHash);
+
+        this->cacheFilename = QDir(cacheDir).filePath(QString("%1/%2.avsc").arg(CACHE_DIR_NAME).arg(QString::fromLatin1(key.result().toHex())));
+    }
+
+    return;
+}
+
+activity_cache_c::~activity_cache_c()
+{
+    return;
+}
+
+bool activity_cache_c::is_usable() const
+{
+    return !this->cacheFilename.isEmpty();
+}
+
+// Fetches the cached activity data of the video, if there is any, and if it was
+// computed with detector settings matching the given signature; along with the
+// frames' scores, the audio's energies and the frames' thumbnails, any of which
+// may be empty if none were stored. Returns false if no such data was found.
+//
+bool activity_cache_c::load(const QByteArray &settingsSignature, QByteArray &videoActivity, QByteArray &audioActivity,
+                            QVector<float> &videoScores, QVector<float> &audioEnergies, QByteArray &thumbnails) const
+{
+    if (!this->is_usable())
+    {
+        return false;
+    }
+
+    QFile file(this->cacheFilename);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_5);
+
+    quint32 magic = 0, version = 0;
+    stream >> magic >> version;
+    if ((magic != CACHE_FILE_MAGIC) ||
+        (version != CACHE_FILE_VERSION))
+    {
+        return false;
+    }
+
+    QString filename;
+    qint64 fileSize = 0, fileModified = 0;
+    QByteArray contentHash, signature, videoData, audioData, videoScoreData, audioEnergyData, thumbnailData;
+    stream >> filename >> fileSize >> fileModified >> contentHash >> signature
+           >> videoData >> audioData >> videoScoreData >> audioEnergyData >> thumbnailData;
+
+    if ((stream.status() != QDataStream::Ok) ||
+        (filename != this->videoFilename) ||
+        (fileSize != this->videoFileSize) ||
+        (fileModified != this->videoFileModified) ||
+        (contentHash != this->videoContentHash) ||
+        (signature != settingsSignature))
+    {
+        return false;
+    }
+
+    videoActivity = qUncompress(videoData);
+    audioActivity = qUncompress(audioData);
+    videoScores = unpacked_values(qUncompress(videoScoreData));
+    audioEnergies = unpacked_values(qUncompress(audioEnergyData));
+    thumbnails = thumbnailData;
+
+    return true;
+}
+
+// Stores the given activity data, the frame scores and audio energies it was judged
+// by, and the frames' thumbnails (any of which may be empty), as the video's cached
+// data, replacing any that was stored before. Returns false if the data couldn't
+// be stored.
+//
+bool activity_cache_c::save(const QByteArray &settingsSignature, const QByteArray &videoActivity, const QByteArray &audioActivity,
+                            const QVector<float> &videoScores, const QVector<float> &audioEnergies, const QByteArray &thumbnails) const
+{
+    if (!this->is_usable() ||
+        !QDir().mkpath(QFileInfo(this->cacheFilename).absolutePath()))
+    {
+        return false;
+    }
+
+    // Write into a temporary file that then atomically replaces the old one, so
+    // that an interrupted save can't leave behind a corrupted cache.
+    QSaveFile file(this->cacheFilename);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        NBENE(("Failed to open the activity cache file '%s' for writing.", this->cacheFilename.toUtf8().constData()));
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_5);
+
+    stream << CACHE_FILE_MAGIC << CACHE_FILE_VERSION
+           << this->videoFilename << this->videoFileSize << this->videoFileModified << this->videoContentHash
+           << settingsSignature
+           << qCompress(videoActivity) << qCompress(audioActivity)
+           << qCompress(packed_values(videoScores)) << qCompress(packed_values(audioEnergies))
+           << thumbnails;
+
+    if ((stream.status() != QDataStream::Ok) ||
+        !file.commit())
+    {
+        NBENE(("Failed to write the activity cache file '%s'.", this->cacheFilename.toUtf8().constData()));
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,40 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors
+ *
+ */
+
+#ifndef ACTIVITY_CACHE_H
+#define ACTIVITY_CACHE_H
+
+#include <QByteArray>
+#include <QVector>
+#include <QString>
+#include "../../src/types.h"
+
+class activity_cache_c
+{
+public:
+    activity_cache_c(const QString &videoFilename);
+    ~activity_cache_c(void);
+
+    bool is_usable(void) const;
+
+    bool load(const QByteArray &settingsSignature, QByteArray &videoActivity, QByteArray &audioActivity,
+              QVector<float> &videoScores, QVector<float> &audioEnergies, QByteArray &thumbnails) const;
+
+    bool save(const QByteArray &settingsSignature, const QByteArray &videoActivity, const QByteArray &audioActivity,
+              const QVector<float> &videoScores, const QVector<float> &audioEnergies, const QByteArray &thumbnails) const;
+
+private:
+    // The file in which this video's cached activity is stored.
+    QString cacheFilename;
+
+    // The properties of the video file that identify it to the cache.
+    QString videoFilename;
+    qint64 videoFileSize = 0;
+    qint64 videoFileModified = 0;
+    QByteArray videoContentHash;
+};
+
+#endif
@@ -0,0 +1,152 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors
+ *
+ * Restricts the activity analysis to the parts of a video's frames that the user
+ * cares about, e.g. to leave out a busy street or a ticking clock in the corner
+ * of a camera's view.
+ *
+ * The mask is applied a tile at a time, rather than a pixel at a time, so that
+ * the comparisons can go over long runs of contiguous pixels, as they would over
+ * an unmasked frame. A tile that's only partly excluded stays in, so that nothing
+ * in the regions being looked at gets left out.
+ *
+ */
+
+#include <algorithm>
+#include "../../src/video/activity_mask.h"
+#include "../../src/common.h"
+
+activity_mask_c::activity_mask_c(const QVector<activity_mask_region_s> &regions, const uint tileSize) :
+    regions(regions),
+    tileSize(std::max(1u, tileSize))
+{
+    return;
+}
+
+// Returns true if the mask has no regions, such that all of the frame is to be
+// looked at.
+//
+bool activity_mask_c::is_empty(void) const
+{
+    return this->regions.isEmpty();
+}
+
+uint activity_mask_c::tile_size(void) const
+{
+    return this->tileSize;
+}
+
+// Lays the tiles out over frames of the given dimensions, in pixels. Frames of
+// those dimensions can then be queried for; laying out for the dimensions they
+// were last laid out for does nothing.
+//
+void activity_mask_c::prepare(const uint frameWidth, const uint frameHeight)
+{
+    if ((frameWidth == this->frameWidth) &&
+        (frameHeight == this->frameHeight))
+    {
+        return;
+    }
+
+    this->frameWidth = frameWidth;
+    this->frameHeight = frameHeight;
+    this->numTileCols = ((frameWidth + this->tileSize - 1) / this->tileSize);
+
+    const uint numTileRows = ((frameHeight + this->tileSize - 1) / this->tileSize);
+
+    this->tileIsIncluded.assign((this->numTileCols * numTileRows), false);
+    this->tileRowSpans.assign(numTileRows, std::vector<std::pair<uint, uint>>());
+
+    for (uint tileRow = 0; tileRow < numTileRows; tileRow++)
+    {
+        auto &spans = this->tileRowSpans[tileRow];
+
+        for (uint tileCol = 0; tileCol < this->numTileCols; tileCol++)
+        {
+            if (!this->tile_is_masked_in(tileRow, tileCol))
+            {
+                continue;
+            }
+
+            this->tileIsIncluded[(tileRow * this->numTileCols) + tileCol] = true;
+
+            const uint startX = (tileCol * this->tileSize);
+            const uint endX = std::min(frameWidth, (startX + this->tileSize));
+
+            if (!spans.empty() &&
+                (spans.back().second == startX))
+            {
+                spans.back().second = endX;
+            }
+            else
+            {
+                spans.emplace_back(startX, endX);
+            }
+        }
+    }
+
+    return;
+}
+
+// Returns true if the given tile is to be looked at, given the mask's regions.
+//
+bool activity_mask_c::tile_is_masked_in(const uint tileRow, const uint tileCol) const
+{
+    // The tile's extent, in fractions of the frame's dimensions.
+    const real left = (real(tileCol * this->tileSize) / this->frameWidth);
+    const real top = (real(tileRow * this->tileSize) / this->frameHeight);
+    const real right = (real(std::min(this->frameWidth, ((tileCol + 1) * this->tileSize))) / this->frameWidth);
+    const real bottom = (real(std::min(this->frameHeight, ((tileRow + 1) * this->tileSize))) / this->frameHeight);
+
+    bool haveInclusions = false;
+    bool isInInclusion = false;
+
+    for (const auto &region: this->regions)
+    {
+        if (region.isExclusion)
+        {
+            if ((left >= region.x) &&
+                (top >= region.y) &&
+                (right <= (region.x + region.width)) &&
+                (bottom <= (region.y + region.height)))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            haveInclusions = true;
+
+            isInInclusion |= ((left < (region.x + region.width)) &&
+                              (top < (region.y + region.height)) &&
+                              (right > region.x) &&
+                              (bottom > region.y));
+        }
+    }
+
+    return (!haveInclusions || isInInclusion);
+}
+
+// Returns true if the given tile is to be looked at. The tiles must have been
+// laid out (see prepare()) for the frame they're in.
+//
+bool activity_mask_c::tile_is_included(const uint tileRow, const uint tileCol) const
+{
+    k_assert((tileCol < this->numTileCols) &&
+             (((tileRow * this->numTileCols) + tileCol) < this->tileIsIncluded.size()),
+             "Asked about a tile outside of the mask.");
+
+    return this->tileIsIncluded[(tileRow * this->numTileCols) + tileCol];
+}
+
+// Returns, for the given row of pixels, the runs of its pixels that are to be
+// looked at, as [start, end) pixel columns. The tiles must have been laid out
+// (see prepare()) for the frame the row is in.
+//
+const std::vector<std::pair<uint, uint>>& activity_mask_c::row_spans(const uint y) const
+{
+    k_assert(((y / this->tileSize) < this->tileRowSpans.size()), "Asked about a row outside of the mask.");
+
+    return this->tileRowSpans[y / this->tileSize];
+}
@@ -0,0 +1,71 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors
+ *
+ */
+
+#ifndef ACTIVITY_MASK_H
+#define ACTIVITY_MASK_H
+
+#include <QVector>
+#include <utility>
+#include <vector>
+#include "../../src/types.h"
+
+// A rectangle of a video's frame in which activity is to be looked for, or to be
+// ignored. Given in fractions of the frame's width and height, so that it applies
+// alike to the frame at any resolution, e.g. to downscaled proxy frames.
+struct activity_mask_region_s
+{
+    real x = 0;
+    real y = 0;
+    real width = 1;
+    real height = 1;
+
+    // If set, activity in this region is ignored; otherwise, it's looked for.
+    bool isExclusion = false;
+};
+
+// Divides a video's frames into square tiles, and tells which of the tiles are to
+// be looked at for activity, given a set of mask regions: if any of the regions
+// are inclusions, only the tiles that overlap one of them; and of those, all but
+// the ones lying wholly within an exclusion. With no regions, all tiles are looked
+// at. The tiles not to be looked at needn't be read at all.
+//
+class activity_mask_c
+{
+public:
+    activity_mask_c(const QVector<activity_mask_region_s> &regions, const uint tileSize);
+
+    bool is_empty(void) const;
+
+    void prepare(const uint frameWidth, const uint frameHeight);
+
+    bool tile_is_included(const uint tileRow, const uint tileCol) const;
+
+    const std::vector<std::pair<uint, uint>>& row_spans(const uint y) const;
+
+    uint tile_size(void) const;
+
+private:
+    bool tile_is_masked_in(const uint tileRow, const uint tileCol) const;
+
+    const QVector<activity_mask_region_s> regions;
+
+    const uint tileSize;
+
+    // The frame dimensions, in pixels, that the tiles were last laid out for.
+    uint frameWidth = 0;
+    uint frameHeight = 0;
+
+    uint numTileCols = 0;
+
+    // For each tile, in rows, whether it's to be looked at.
+    std::vector<bool> tileIsIncluded;
+
+    // For each row of tiles, the runs of adjacent tiles in it that are to be
+    // looked at, as [start, end) pixel columns.
+    std::vector<std::vector<std::pair<uint, uint>>> tileRowSpans;
+};
+
+#endif
@@ -0,0 +1,866 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors.
+ *
+ * A compact store of per-frame activity types. Each frame takes up two bits,
+ * sixteen frames to a 32-bit word, so e.g. a week's worth of 30 FPS video fits
+ * in about 4.5 MB per track.
+ *
+ * Queries over ranges of frames are done a word at a time, by replicating the
+ * two-bit code being looked for across a whole word and testing all sixteen
+ * fields against it at once.
+ *
+ * Alongside the packed frames, the timeline keeps a sorted index of its segments
+ * of activity, which lets segment queries run in logarithmic time. The index is
+ * only touched by writes that change whether a frame is active, which during the
+ * analysis amounts to about one update per activity hit.
+ *
+ * For range queries about activity (used e.g. by the GUI's activity strips), the
+ * timeline also keeps a pyramid of blocks of 64, 128, 256, ... frames, each of
+ * which counts how many of its frames are active and how many uninitialized.
+ * A range query then only needs to look at the O(log n) blocks that tile the
+ * range plus at most a few words at its ends. The counts are adjusted by atomic
+ * additions, so concurrent writers can't leave them in an inconsistent state.
+ *
+ * Writes also flag the chunks of frames they touch as dirty, so that a reader
+ * (the GUI) can pick up what has changed since it last looked without having to
+ * re-read the whole timeline.
+ *
+ * The analysis workers don't write to the timeline directly, but through an
+ * activity_timeline_writer_c, which gathers up runs of frames in a plain local
+ * buffer and commits each run with a single batch of atomic word stores. The
+ * summary, the index and the dirty flags then get updated once per batch rather
+ * than once per frame; and since the dirty flags are set last, with release
+ * semantics, a reader that picks them up sees the whole batch. Frames not yet
+ * committed simply read as uninitialized.
+ *
+ * For sources whose length isn't known up front (live streams), the timeline can
+ * be reset with room to spare and then extended as frames come in. All of its
+ * structures are sized for the full capacity from the start, so extending only
+ * publishes a new length, and never moves data from under concurrent readers.
+ *
+ */
+
+#include <algorithm>
+#include <iterator>
+#include "../../src/video/activity_timeline.h"
+#include "../../src/common.h"
+
+static const uint FRAMES_PER_WORD = 16;
+static const uint BITS_PER_FRAME = 2;
+
+// The number of frames (as a power of two) in the blocks at the lowest level of
+// the summary pyramid.
+static const uint SUMMARY_BLOCK_SHIFT = 6;
+
+// The number of frames (as a power of two) in each of the chunks whose changes
+// are tracked for take_dirty_ranges().
+static const uint DIRTY_CHUNK_SHIFT = 12;
+
+// A word pattern with each frame's field holding the two-bit code 1. Multiplying
+// it by a code replicates that code across all the fields.
+static const u32 LOW_BITS_PATTERN = 0x55555555u;
+
+// Returns the two-bit code with which the given activity type is stored. The
+// uninitialized type maps to zero, so that zeroed words read as uninitialized.
+//
+static u32 type_code(const activity_timeline_c::activity_type_e type)
+{
+    switch (type)
+    {
+        case activity_timeline_c::activity_type_e::Uninitialized: return 0;
+        case activity_timeline_c::activity_type_e::Inactive: return 1;
+        case activity_timeline_c::activity_type_e::Active: return 2;
+        case activity_timeline_c::activity_type_e::NoData: return 3;
+        default: k_assert(0, "Unknown activity type."); return 0;
+    }
+}
+
+static activity_timeline_c::activity_type_e code_type(const u32 code)
+{
+    static const activity_timeline_c::activity_type_e types[] = {activity_timeline_c::activity_type_e::Uninitialized,
+                                                                 activity_timeline_c::activity_type_e::Inactive,
+                                                                 activity_timeline_c::activity_type_e::Active,
+                                                                 activity_timeline_c::activity_type_e::NoData};
+
+    return types[code & 3];
+}
+
+// Returns a mask covering the fields of frames [firstFrameIdx, endFrameIdx), both
+// of which are expected to fall within the same word (the end index may point to
+// the start of the next word).
+//
+static u32 field_mask(const uint firstFrameIdx, const uint endFrameIdx)
+{
+    const uint numFields = (endFrameIdx - firstFrameIdx);
+    const uint shift = ((firstFrameIdx % FRAMES_PER_WORD) * BITS_PER_FRAME);
+
+    if (numFields >= FRAMES_PER_WORD)
+    {
+        return ~0u;
+    }
+
+    return (((1u << (numFields * BITS_PER_FRAME)) - 1) << shift);
+}
+
+// Returns the number of fields under the given mask in the given word that hold
+// the given two-bit code.
+//
+static uint count_code(const u32 word, const u32 code, const u32 mask)
+{
+    const u32 difference = (word ^ (code * LOW_BITS_PATTERN));
+    const u32 matches = (~(difference | (difference >> 1)) & LOW_BITS_PATTERN);
+
+    return __builtin_popcount(matches & mask);
+}
+
+activity_timeline_c::activity_timeline_c(void)
+{
+    return;
+}
+
+activity_timeline_c::~activity_timeline_c(void)
+{
+    delete [] this->words;
+    delete [] this->dirtyChunks;
+    this->free_summary();
+
+    return;
+}
+
+void activity_timeline_c::free_summary(void)
+{
+    for (summary_block_s *level: this->summaryLevels)
+    {
+        delete [] level;
+    }
+
+    this->summaryLevels.clear();
+
+    return;
+}
+
+// Resizes the timeline to hold the given number of frames, all of which get set
+// to the given activity type. If a larger capacity is given, room is made for
+// the timeline to be extended up to that many frames later on, without moving
+// any of its data. Not to be called while other threads are accessing the
+// timeline.
+//
+void activity_timeline_c::reset(const uint numFrames, const activity_type_e initialType, const uint capacity)
+{
+    const uint numCapacityFrames = std::max(numFrames, capacity);
+    const uint numWords = ((numCapacityFrames + FRAMES_PER_WORD - 1) / FRAMES_PER_WORD);
+    const u32 pattern = (type_code(initialType) * LOW_BITS_PATTERN);
+
+    delete [] this->words;
+    this->words = new std::atomic<u32>[numWords];
+    this->numFrames.store(numFrames, std::memory_order_relaxed);
+    this->numCapacityFrames = numCapacityFrames;
+    this->initialType = initialType;
+
+    for (uint i = 0; i < numWords; i++)
+    {
+        this->words[i].store(pattern, std::memory_order_relaxed);
+    }
+
+    // Build the summary pyramid. It covers the whole capacity, so that extending
+    // the timeline needn't touch it.
+    this->free_summary();
+    for (uint shift = SUMMARY_BLOCK_SHIFT; ; shift++)
+    {
+        const u64 blockSize = (u64(1) << shift);
+        const uint numBlocks = ((numCapacityFrames + blockSize - 1) / blockSize);
+        summary_block_s *const level = new summary_block_s[std::max(numBlocks, 1u)];
+
+        for (uint i = 0; i < std::max(numBlocks, 1u); i++)
+        {
+            const uint numBlockFrames = std::min<u64>(blockSize, (numCapacityFrames - (i * blockSize)));
+
+            level[i].numActive.store(((initialType == activity_type_e::Active)? numBlockFrames : 0), std::memory_order_relaxed);
+            level[i].numUninitialized.store(((initialType == activity_type_e::Uninitialized)? numBlockFrames : 0), std::memory_order_relaxed);
+        }
+
+        this->summaryLevels.push_back(level);
+
+        if (numBlocks <= 1)
+        {
+            break;
+        }
+    }
+
+    // Start out with everything dirty, since whoever's reading the timeline won't
+    // have seen any of it yet.
+    {
+        const uint numCapacityChunks = ((u64(numCapacityFrames) + (1u << DIRTY_CHUNK_SHIFT) - 1) >> DIRTY_CHUNK_SHIFT);
+        const uint numChunks = ((u64(numFrames) + (1u << DIRTY_CHUNK_SHIFT) - 1) >> DIRTY_CHUNK_SHIFT);
+
+        delete [] this->dirtyChunks;
+        this->numDirtyChunkWords = ((numCapacityChunks + 63) / 64);
+        this->dirtyChunks = new std::atomic<u64>[this->numDirtyChunkWords];
+
+        for (uint i = 0; i < this->numDirtyChunkWords; i++)
+        {
+            const uint numWordChunks = ((numChunks > (i * 64))? std::min(64u, (numChunks - (i * 64))) : 0);
+
+            this->dirtyChunks[i].store(((numWordChunks == 64)? ~u64(0) : ((u64(1) << numWordChunks) - 1)),
+                                       std::memory_order_relaxed);
+        }
+    }
+
+    this->activeSegments.clear();
+    if ((initialType == activity_type_e::Active) &&
+        (numFrames > 0))
+    {
+        this->activeSegments[0] = numFrames;
+    }
+
+    return;
+}
+
+// Grows the timeline to the given number of frames, within the capacity it was
+// reset with. The new frames take on the activity type the timeline was reset
+// with. Meant to be called by one thread at a time, but readers and writers of
+// the existing frames may carry on meanwhile.
+//
+void activity_timeline_c::extend(const uint numFrames)
+{
+    const uint oldNumFrames = this->numFrames.load(std::memory_order_relaxed);
+
+    k_assert((numFrames <= this->numCapacityFrames), "Tried to extend the activity timeline past its capacity.");
+    k_assert((numFrames >= oldNumFrames), "Tried to shrink the activity timeline.");
+
+    if (numFrames == oldNumFrames)
+    {
+        return;
+    }
+
+    if (this->initialType == activity_type_e::Active)
+    {
+        std::lock_guard<std::mutex> lock(this->activeSegmentsMutex);
+        this->index_active_range(oldNumFrames, numFrames);
+    }
+
+    this->numFrames.store(numFrames, std::memory_order_release);
+    this->mark_dirty(oldNumFrames, numFrames);
+
+    return;
+}
+
+uint activity_timeline_c::capacity(void) const
+{
+    return this->numCapacityFrames;
+}
+
+uint activity_timeline_c::size(void) const
+{
+    return this->numFrames.load(std::memory_order_acquire);
+}
+
+activity_timeline_c::activity_type_e activity_timeline_c::at(const uint frameIdx) const
+{
+    k_assert((frameIdx < this->size()), "Tried to access the activity timeline out of bounds.");
+
+    const u32 word = this->words[frameIdx / FRAMES_PER_WORD].load(std::memory_order_acquire);
+
+    return code_type(word >> ((frameIdx % FRAMES_PER_WORD) * BITS_PER_FRAME));
+}
+
+// Replaces the bits under the given mask in the given word. Other threads may
+// be writing to the word's other fields at the same time. Returns the word's
+// value prior to the write.
+//
+u32 activity_timeline_c::store_masked(const uint wordIdx, const u32 mask, const u32 bits)
+{
+    std::atomic<u32> &word = this->words[wordIdx];
+    u32 oldWord = word.load(std::memory_order_relaxed);
+
+    while (!word.compare_exchange_weak(oldWord, ((oldWord & ~mask) | (bits & mask)),
+                                       std::memory_order_release, std::memory_order_relaxed))
+    {
+        ;
+    }
+
+    return oldWord;
+}
+
+void activity_timeline_c::set(const uint frameIdx, const activity_type_e type)
+{
+    k_assert((frameIdx < this->size()), "Tried to access the activity timeline out of bounds.");
+
+    const uint shift = ((frameIdx % FRAMES_PER_WORD) * BITS_PER_FRAME);
+    const u32 oldWord = this->store_masked((frameIdx / FRAMES_PER_WORD), (3u << shift), (type_code(type) << shift));
+
+    const activity_type_e oldType = code_type(oldWord >> shift);
+    const bool wasActive = bool(oldType == activity_type_e::Active);
+    const bool isActive = bool(type == activity_type_e::Active);
+
+    if (oldType == type)
+    {
+        return;
+    }
+
+    this->add_to_summary(frameIdx,
+                         (int(isActive) - int(wasActive)),
+                         (int(type == activity_type_e::Uninitialized) - int(oldType == activity_type_e::Uninitialized)));
+
+    if (isActive != wasActive)
+    {
+        std::lock_guard<std::mutex> lock(this->activeSegmentsMutex);
+
+        if (isActive)
+        {
+            this->index_active_range(frameIdx, (frameIdx + 1));
+        }
+        else
+        {
+            this->unindex_active_range(frameIdx, (frameIdx + 1));
+        }
+    }
+
+    this->mark_dirty(frameIdx, (frameIdx + 1));
+
+    return;
+}
+
+// Sets the frames [firstFrameIdx, endFrameIdx) to the given activity type.
+//
+void activity_timeline_c::set_range(const uint firstFrameIdx, const uint endFrameIdx, const activity_type_e type)
+{
+    const u32 pattern = (type_code(type) * LOW_BITS_PATTERN);
+
+    this->write_range(firstFrameIdx, endFrameIdx, &pattern, true);
+
+    return;
+}
+
+// Writes the given packed frames into the timeline's frames [firstFrameIdx,
+// endFrameIdx). The first of the packed words is taken to line up with the word
+// that holds the frame firstFrameIdx; fields outside of the range are ignored.
+// If isUniform is true, only the first packed word is read, and it's applied to
+// the whole range.
+//
+// The summary pyramid, the index of active segments, and the dirty flags get
+// updated once for the whole range, the dirty flags last, so that by the time
+// a reader learns of the change, all of it is visible.
+//
+void activity_timeline_c::write_range(const uint firstFrameIdx, const uint endFrameIdx,
+                                      const u32 *const packedWords, const bool isUniform)
+{
+    k_assert((endFrameIdx <= this->size()), "Tried to access the activity timeline out of bounds.");
+
+    if (firstFrameIdx >= endFrameIdx)
+    {
+        return;
+    }
+
+    const u32 activeCode = type_code(activity_type_e::Active);
+    const u32 uninitializedCode = type_code(activity_type_e::Uninitialized);
+    const uint firstWordIdx = (firstFrameIdx / FRAMES_PER_WORD);
+    bool hadActivity = false;
+    uint frameIdx = firstFrameIdx;
+
+    // The changes in the number of active and uninitialized frames, accumulated
+    // over each summary block so they can be applied to the pyramid in one go.
+    int numActiveDelta = 0, numUninitializedDelta = 0;
+
+    while (frameIdx < endFrameIdx)
+    {
+        const uint wordIdx = (frameIdx / FRAMES_PER_WORD);
+        const uint wordEndFrameIdx = std::min(((wordIdx + 1) * FRAMES_PER_WORD), endFrameIdx);
+        const u32 mask = field_mask(frameIdx, wordEndFrameIdx);
+        const u32 newWord = packedWords[isUniform? 0 : (wordIdx - firstWordIdx)];
+
+        const u32 oldWord = (mask == ~0u)? this->words[wordIdx].exchange(newWord, std::memory_order_acq_rel)
+                                         : this->store_masked(wordIdx, mask, newWord);
+
+        const uint numOldActive = count_code(oldWord, activeCode, mask);
+
+        hadActivity |= bool(numOldActive > 0);
+        numActiveDelta += (int(count_code(newWord, activeCode, mask)) - int(numOldActive));
+        numUninitializedDelta += (int(count_code(newWord, uninitializedCode, mask)) - int(count_code(oldWord, uninitializedCode, mask)));
+
+        if (((wordEndFrameIdx % (1u << SUMMARY_BLOCK_SHIFT)) == 0) ||
+            (wordEndFrameIdx == endFrameIdx))
+        {
+            if (numActiveDelta || numUninitializedDelta)
+            {
+                this->add_to_summary(frameIdx, numActiveDelta, numUninitializedDelta);
+            }
+
+            numActiveDelta = numUninitializedDelta = 0;
+        }
+
+        frameIdx = wordEndFrameIdx;
+    }
+
+    // Replace whatever segments of activity were in the range with those that
+    // are in it now.
+    {
+        std::lock_guard<std::mutex> lock(this->activeSegmentsMutex);
+
+        if (hadActivity)
+        {
+            this->unindex_active_range(firstFrameIdx, endFrameIdx);
+        }
+
+        if (isUniform)
+        {
+            if ((packedWords[0] & 3) == activeCode)
+            {
+                this->index_active_range(firstFrameIdx, endFrameIdx);
+            }
+        }
+        else
+        {
+            uint runStartIdx = endFrameIdx;
+
+            for (uint i = firstFrameIdx; i <= endFrameIdx; i++)
+            {
+                const bool isActive = ((i < endFrameIdx) &&
+                                       (((packedWords[(i / FRAMES_PER_WORD) - firstWordIdx] >> ((i % FRAMES_PER_WORD) * BITS_PER_FRAME)) & 3) == activeCode));
+
+                if (isActive && (runStartIdx == endFrameIdx))
+                {
+                    runStartIdx = i;
+                }
+                else if (!isActive && (runStartIdx != endFrameIdx))
+                {
+                    this->index_active_range(runStartIdx, i);
+                    runStartIdx = endFrameIdx;
+                }
+            }
+        }
+    }
+
+    this->mark_dirty(firstFrameIdx, endFrameIdx);
+
+    return;
+}
+
+// Flags as dirty the chunks that contain the frames [firstFrameIdx, endFrameIdx).
+//
+void activity_timeline_c::mark_dirty(const uint firstFrameIdx, const uint endFrameIdx)
+{
+    const uint endChunkIdx = ((u64(endFrameIdx) + (1u << DIRTY_CHUNK_SHIFT) - 1) >> DIRTY_CHUNK_SHIFT);
+
+    for (uint chunkIdx = (firstFrameIdx >> DIRTY_CHUNK_SHIFT); chunkIdx < endChunkIdx; chunkIdx++)
+    {
+        std::atomic<u64> &word = this->dirtyChunks[chunkIdx / 64];
+        const u64 bit = (u64(1) << (chunkIdx % 64));
+
+        // Most writes land in chunks already flagged, so avoid a read-modify-write
+        // in that case.
+        if (!(word.load(std::memory_order_relaxed) & bit))
+        {
+            word.fetch_or(bit, std::memory_order_release);
+        }
+    }
+
+    return;
+}
+
+// Returns the ranges of frames, as [start, end) pairs, that have possibly changed
+// since the previous call, and clears their dirty flags. Meant to have only one
+// caller per timeline.
+//
+std::vector<std::pair<uint, uint>> activity_timeline_c::take_dirty_ranges(void)
+{
+    std::vector<std::pair<uint, uint>> ranges;
+
+    for (uint i = 0; i < this->numDirtyChunkWords; i++)
+    {
+        u64 bits = this->dirtyChunks[i].exchange(0, std::memory_order_acquire);
+
+        while (bits)
+        {
+            const uint bitIdx = __builtin_ctzll(bits);
+            const uint chunkIdx = ((i * 64) + bitIdx);
+            const uint firstFrameIdx = (chunkIdx << DIRTY_CHUNK_SHIFT);
+            const uint endFrameIdx = std::min<u64>((u64(chunkIdx + 1) << DIRTY_CHUNK_SHIFT), this->size());
+
+            bits &= (bits - 1);
+
+            if (firstFrameIdx >= endFrameIdx)
+            {
+                continue;
+            }
+
+            if (!ranges.empty() &&
+                (ranges.back().second == firstFrameIdx))
+            {
+                ranges.back().second = endFrameIdx;
+            }
+            else
+            {
+                ranges.emplace_back(firstFrameIdx, endFrameIdx);
+            }
+        }
+    }
+
+    return ranges;
+}
+
+// Adjusts the active and uninitialized frame counts of each block in the summary
+// pyramid that the given frame belongs to.
+//
+void activity_timeline_c::add_to_summary(const uint frameIdx, const int numActiveDelta, const int numUninitializedDelta)
+{
+    for (uint i = 0; i < this->summaryLevels.size(); i++)
+    {
+        summary_block_s &block = this->summaryLevels[i][frameIdx >> (SUMMARY_BLOCK_SHIFT + i)];
+
+        if (numActiveDelta)
+        {
+            block.numActive.fetch_add(u32(numActiveDelta), std::memory_order_relaxed);
+        }
+
+        if (numUninitializedDelta)
+        {
+            block.numUninitialized.fetch_add(u32(numUninitializedDelta), std::memory_order_relaxed);
+        }
+    }
+
+    return;
+}
+
+// Adds the frames [firstFrameIdx, endFrameIdx) to the index of active segments,
+// merging them with any segments they overlap or touch. The caller is expected
+// to hold the index's mutex.
+//
+void activity_timeline_c::index_active_range(uint firstFrameIdx, uint endFrameIdx)
+{
+    auto it = this->activeSegments.upper_bound(firstFrameIdx);
+
+    if (it != this->activeSegments.begin())
+    {
+        const auto prev = std::prev(it);
+
+        if (prev->second >= firstFrameIdx)
+        {
+            firstFrameIdx = prev->first;
+            endFrameIdx = std::max(endFrameIdx, prev->second);
+            it = this->activeSegments.erase(prev);
+        }
+    }
+
+    while ((it != this->activeSegments.end()) &&
+           (it->first <= endFrameIdx))
+    {
+        endFrameIdx = std::max(endFrameIdx, it->second);
+        it = this->activeSegments.erase(it);
+    }
+
+    this->activeSegments[firstFrameIdx] = endFrameIdx;
+
+    return;
+}
+
+// Removes the frames [firstFrameIdx, endFrameIdx) from the index of active
+// segments, trimming or splitting any segments they overlap. The caller is
+// expected to hold the index's mutex.
+//
+void activity_timeline_c::unindex_active_range(const uint firstFrameIdx, const uint endFrameIdx)
+{
+    auto it = this->activeSegments.upper_bound(firstFrameIdx);
+
+    if (it != this->activeSegments.begin())
+    {
+        const auto prev = std::prev(it);
+
+        if (prev->second > firstFrameIdx)
+        {
+            const uint segmentStartIdx = prev->first;
+            const uint segmentEndIdx = prev->second;
+
+            this->activeSegments.erase(prev);
+
+            if (segmentStartIdx < firstFrameIdx)
+            {
+                this->activeSegments[segmentStartIdx] = firstFrameIdx;
+            }
+
+            if (segmentEndIdx > endFrameIdx)
+            {
+                this->activeSegments[endFrameIdx] = segmentEndIdx;
+            }
+        }
+
+        it = this->activeSegments.lower_bound(firstFrameIdx);
+    }
+
+    while ((it != this->activeSegments.end()) &&
+           (it->first < endFrameIdx))
+    {
+        const uint segmentEndIdx = it->second;
+
+        it = this->activeSegments.erase(it);
+
+        if (segmentEndIdx > endFrameIdx)
+        {
+            this->activeSegments[endFrameIdx] = segmentEndIdx;
+            break;
+        }
+    }
+
+    return;
+}
+
+bool activity_timeline_c::is_active_frame_at(const uint frameIdx) const
+{
+    return bool(this->at(frameIdx) == activity_type_e::Active);
+}
+
+// Returns true if any of the frames [firstFrameIdx, endFrameIdx) is of the given
+// activity type. The range gets clamped to the timeline's bounds.
+//
+bool activity_timeline_c::range_contains(const uint firstFrameIdx, const uint endFrameIdx, const activity_type_e type) const
+{
+    const uint rangeEndFrameIdx = std::min(endFrameIdx, this->size());
+
+    if ((type == activity_type_e::Active) ||
+        (type == activity_type_e::Uninitialized))
+    {
+        return this->summary_range_contains(firstFrameIdx, rangeEndFrameIdx, type);
+    }
+
+    return this->words_range_contains(firstFrameIdx, rangeEndFrameIdx, type_code(type));
+}
+
+// Looks through the packed frames [firstFrameIdx, endFrameIdx) a word at a time
+// for any that hold the given two-bit code.
+//
+bool activity_timeline_c::words_range_contains(const uint firstFrameIdx, const uint endFrameIdx, const u32 code) const
+{
+    uint frameIdx = firstFrameIdx;
+
+    while (frameIdx < endFrameIdx)
+    {
+        const uint wordIdx = (frameIdx / FRAMES_PER_WORD);
+        const uint wordEndFrameIdx = std::min(((wordIdx + 1) * FRAMES_PER_WORD), endFrameIdx);
+
+        if (count_code(this->words[wordIdx].load(std::memory_order_acquire), code, field_mask(frameIdx, wordEndFrameIdx)))
+        {
+            return true;
+        }
+
+        frameIdx = wordEndFrameIdx;
+    }
+
+    return false;
+}
+
+// Answers a range query for active or uninitialized frames from the summary
+// pyramid. The range is covered by the largest aligned blocks that fit in it, and
+// whatever's left over at its ends gets checked from the packed frames.
+//
+bool activity_timeline_c::summary_range_contains(uint firstFrameIdx, const uint endFrameIdx, const activity_type_e type) const
+{
+    const uint minBlockSize = (1u << SUMMARY_BLOCK_SHIFT);
+
+    while (firstFrameIdx < endFrameIdx)
+    {
+        // Not aligned to a block, so check frames up to the next block boundary.
+        if ((firstFrameIdx % minBlockSize) ||
+            ((endFrameIdx - firstFrameIdx) < minBlockSize))
+        {
+            const uint boundaryIdx = std::min((((firstFrameIdx / minBlockSize) + 1) * minBlockSize), endFrameIdx);
+
+            if (this->words_range_contains(firstFrameIdx, boundaryIdx, type_code(type)))
+            {
+                return true;
+            }
+
+            firstFrameIdx = boundaryIdx;
+            continue;
+        }
+
+        // Find the largest block that begins at this frame and fits in the range.
+        uint level = 0;
+        while (((level + 1) < this->summaryLevels.size()) &&
+               ((firstFrameIdx % (u64(minBlockSize) << (level + 1))) == 0) &&
+               ((u64(firstFrameIdx) + (u64(minBlockSize) << (level + 1))) <= endFrameIdx))
+        {
+            level++;
+        }
+
+        const summary_block_s &block = this->summaryLevels[level][firstFrameIdx >> (SUMMARY_BLOCK_SHIFT + level)];
+        const u32 count = (type == activity_type_e::Active)? block.numActive.load(std::memory_order_acquire)
+                                                           : block.numUninitialized.load(std::memory_order_acquire);
+
+        if (count)
+        {
+            return true;
+        }
+
+        firstFrameIdx += (minBlockSize << level);
+    }
+
+    return false;
+}
+
+bool activity_timeline_c::contains(const activity_type_e type) const
+{
+    return this->range_contains(0, this->size(), type);
+}
+
+// Returns how many of the timeline's frames have yet to have their activity type
+// computed. Takes constant time, as the top level of the summary pyramid keeps
+// count for the whole capacity.
+//
+uint activity_timeline_c::num_uninitialized(void) const
+{
+    if (this->summaryLevels.empty())
+    {
+        return 0;
+    }
+
+    const u32 numInCapacity = this->summaryLevels.back()[0].numUninitialized.load(std::memory_order_acquire);
+
+    // The frames past the timeline's end count as their initial type.
+    const uint numPastEnd = ((this->initialType == activity_type_e::Uninitialized)? (this->numCapacityFrames - this->size())
+                                                                                   : 0);
+
+    return ((numInCapacity > numPastEnd)? (numInCapacity - numPastEnd) : 0);
+}
+
+// Returns the index of the first frame of the segment of activity that contains
+// the given frame. If the frame isn't active, its own index is returned.
+//
+uint activity_timeline_c::get_start_of_active_segment(const uint frameIdx) const
+{
+    std::lock_guard<std::mutex> lock(this->activeSegmentsMutex);
+
+    auto it = this->activeSegments.upper_bound(frameIdx);
+
+    if (it == this->activeSegments.begin())
+    {
+        return frameIdx;
+    }
+
+    it--;
+
+    return ((frameIdx < it->second)? it->first : frameIdx);
+}
+
+// Returns all of the segments of activity, in order, as [start, end) pairs.
+//
+std::vector<std::pair<uint, uint>> activity_timeline_c::active_segments(void) const
+{
+    std::lock_guard<std::mutex> lock(this->activeSegmentsMutex);
+
+    return std::vector<std::pair<uint, uint>>(this->activeSegments.begin(), this->activeSegments.end());
+}
+
+// Finds the first segment of activity that begins after the given frame. Returns
+// false if there's no such segment.
+//
+bool activity_timeline_c::get_next_active_segment(const uint frameIdx, uint &segmentStartIdx) const
+{
+    std::lock_guard<std::mutex> lock(this->activeSegmentsMutex);
+
+    const auto it = this->activeSegments.upper_bound(frameIdx);
+
+    if (it == this->activeSegments.end())
+    {
+        return false;
+    }
+
+    segmentStartIdx = it->first;
+
+    return true;
+}
+
+// Finds the last segment of activity that begins before the given frame. Returns
+// false if there's no such segment.
+//
+bool activity_timeline_c::get_previous_active_segment(const uint frameIdx, uint &segmentStartIdx) const
+{
+    std::lock_guard<std::mutex> lock(this->activeSegmentsMutex);
+
+    const auto it = this->activeSegments.lower_bound(frameIdx);
+
+    if (it == this->activeSegments.begin())
+    {
+        return false;
+    }
+
+    segmentStartIdx = std::prev(it)->first;
+
+    return true;
+}
+
+activity_timeline_writer_c::activity_timeline_writer_c(activity_timeline_c &timeline) :
+    timeline(timeline)
+{
+    return;
+}
+
+activity_timeline_writer_c::~activity_timeline_writer_c(void)
+{
+    this->flush();
+
+    return;
+}
+
+void activity_timeline_writer_c::set(const uint frameIdx, const activity_type_e type)
+{
+    // Frames can be written to anywhere within the buffered run or at its end, as
+    // long as the run then still fits in the buffer; otherwise, the run gets
+    // committed and a new one begun.
+    const bool fitsInRun = ((this->firstFrameIdx < this->endFrameIdx) &&
+                            (frameIdx >= this->firstFrameIdx) &&
+                            (frameIdx <= this->endFrameIdx) &&
+                            (((frameIdx / FRAMES_PER_WORD) - (this->firstFrameIdx / FRAMES_PER_WORD)) < BUFFER_NUM_WORDS));
+
+    if (!fitsInRun)
+    {
+        this->flush();
+
+        this->firstFrameIdx = this->endFrameIdx = frameIdx;
+    }
+
+    const uint shift = ((frameIdx % FRAMES_PER_WORD) * BITS_PER_FRAME);
+    u32 &word = this->packedWords[(frameIdx / FRAMES_PER_WORD) - (this->firstFrameIdx / FRAMES_PER_WORD)];
+
+    word = ((word & ~(3u << shift)) | (type_code(type) << shift));
+
+    if (frameIdx == this->endFrameIdx)
+    {
+        this->endFrameIdx++;
+    }
+
+    return;
+}
+
+void activity_timeline_writer_c::set_range(const uint firstFrameIdx, const uint endFrameIdx, const activity_type_e type)
+{
+    // Ranges too long to buffer are better written directly.
+    if ((endFrameIdx - firstFrameIdx) >= (BUFFER_NUM_WORDS * FRAMES_PER_WORD))
+    {
+        this->flush();
+        this->timeline.set_range(firstFrameIdx, endFrameIdx, type);
+
+        return;
+    }
+
+    for (uint i = firstFrameIdx; i < endFrameIdx; i++)
+    {
+        this->set(i, type);
+    }
+
+    return;
+}
+
+// Commits the buffered frames to the timeline.
+//
+void activity_timeline_writer_c::flush(void)
+{
+    if (this->firstFrameIdx < this->endFrameIdx)
+    {
+        this->timeline.write_range(this->firstFrameIdx, this->endFrameIdx, this->packedWords, false);
+    }
+
+    this->firstFrameIdx = this->endFrameIdx = 0;
+
+    return;
+}
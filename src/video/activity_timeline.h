@@ -0,0 +1,160 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors
+ *
+ */
+
+#ifndef ACTIVITY_TIMELINE_H
+#define ACTIVITY_TIMELINE_H
+
+#include <atomic>
+#include <mutex>
+#include <map>
+#include <utility>
+#include <vector>
+#include "../../src/types.h"
+
+// Stores the activity type of each of a video's frames, packed into two bits per
+// frame, along with an index of the runs of active frames and a pyramid of
+// summaries for querying ranges of frames. Individual frames can be read and
+// written from multiple threads at once, and the timeline can be extended while
+// in use, up to the capacity it was reset with.
+class activity_timeline_c
+{
+    friend class activity_timeline_writer_c;
+
+public:
+    // One of these identifiers will be assigned to each frame.
+    enum class activity_type_e
+    {
+        NoData = -2,        // When we don't have data for this frame (e.g. for sound frames when no sound is present on the video).
+        Uninitialized = -1, // The frame's activity type hasn't yet been computed.
+        Inactive = 0,       // This frame doesn't differ notably from the previous one.
+        Active = 1,         // This frame differs notably from the previous one.
+    };
+
+    activity_timeline_c(void);
+    ~activity_timeline_c(void);
+
+    activity_timeline_c(const activity_timeline_c&) = delete;
+    activity_timeline_c& operator=(const activity_timeline_c&) = delete;
+
+    void reset(const uint numFrames, const activity_type_e initialType, const uint capacity = 0);
+
+    void extend(const uint numFrames);
+
+    uint size(void) const;
+
+    uint capacity(void) const;
+
+    activity_type_e at(const uint frameIdx) const;
+
+    void set(const uint frameIdx, const activity_type_e type);
+
+    void set_range(const uint firstFrameIdx, const uint endFrameIdx, const activity_type_e type);
+
+    bool is_active_frame_at(const uint frameIdx) const;
+
+    bool range_contains(const uint firstFrameIdx, const uint endFrameIdx, const activity_type_e type) const;
+
+    bool contains(const activity_type_e type) const;
+
+    uint num_uninitialized(void) const;
+
+    uint get_start_of_active_segment(const uint frameIdx) const;
+
+    bool get_next_active_segment(const uint frameIdx, uint &segmentStartIdx) const;
+
+    bool get_previous_active_segment(const uint frameIdx, uint &segmentStartIdx) const;
+
+    std::vector<std::pair<uint, uint>> active_segments(void) const;
+
+    std::vector<std::pair<uint, uint>> take_dirty_ranges(void);
+
+private:
+    u32 store_masked(const uint wordIdx, const u32 mask, const u32 bits);
+
+    void write_range(const uint firstFrameIdx, const uint endFrameIdx, const u32 *const packedWords, const bool isUniform);
+
+    void index_active_range(uint firstFrameIdx, uint endFrameIdx);
+
+    void unindex_active_range(const uint firstFrameIdx, const uint endFrameIdx);
+
+    void add_to_summary(const uint frameIdx, const int numActiveDelta, const int numUninitializedDelta);
+
+    bool summary_range_contains(uint firstFrameIdx, const uint endFrameIdx, const activity_type_e type) const;
+
+    bool words_range_contains(const uint firstFrameIdx, const uint endFrameIdx, const u32 code) const;
+
+    void free_summary(void);
+
+    void mark_dirty(const uint firstFrameIdx, const uint endFrameIdx);
+
+    // The frames' activity types, sixteen frames per word.
+    std::atomic<u32> *words = nullptr;
+
+    // How many frames the timeline holds, and how many it has room to grow to.
+    std::atomic<uint> numFrames{0};
+    uint numCapacityFrames = 0;
+
+    // The type to which frames get initialized on reset and on extending.
+    activity_type_e initialType = activity_type_e::Uninitialized;
+
+    // How many active and uninitialized frames there are in each block of frames.
+    // Level n of the pyramid divides the timeline into blocks of 64 * 2^n frames,
+    // and its highest level holds just one block.
+    struct summary_block_s
+    {
+        std::atomic<u32> numActive;
+        std::atomic<u32> numUninitialized;
+    };
+    std::vector<summary_block_s*> summaryLevels;
+
+    // One bit per chunk of frames, set when any of the chunk's frames changes, and
+    // cleared when the changes are collected with take_dirty_ranges().
+    std::atomic<u64> *dirtyChunks = nullptr;
+    uint numDirtyChunkWords = 0;
+
+    // The runs of consecutive active frames, as [start, end) frame indices keyed
+    // by start. Adjacent runs are always merged, so each entry is one segment of
+    // activity.
+    std::map<uint, uint> activeSegments;
+    mutable std::mutex activeSegmentsMutex;
+};
+
+// Collects a worker thread's writes to a run of consecutive frames in a local
+// buffer, and commits them to the timeline in one go once the run fills the
+// buffer, breaks, or the writer gets flushed or destroyed. Until committed, the
+// writes aren't visible to the timeline's readers.
+class activity_timeline_writer_c
+{
+public:
+    typedef activity_timeline_c::activity_type_e activity_type_e;
+
+    activity_timeline_writer_c(activity_timeline_c &timeline);
+    ~activity_timeline_writer_c(void);
+
+    activity_timeline_writer_c(const activity_timeline_writer_c&) = delete;
+    activity_timeline_writer_c& operator=(const activity_timeline_writer_c&) = delete;
+
+    void set(const uint frameIdx, const activity_type_e type);
+
+    void set_range(const uint firstFrameIdx, const uint endFrameIdx, const activity_type_e type);
+
+    void flush(void);
+
+private:
+    // How many packed words (of sixteen frames each) the buffer holds.
+    static const uint BUFFER_NUM_WORDS = 256;
+
+    activity_timeline_c &timeline;
+
+    // The buffered run of frames [firstFrameIdx, endFrameIdx), packed as in the
+    // timeline, with the first word lining up with the timeline's word that holds
+    // firstFrameIdx.
+    u32 packedWords[BUFFER_NUM_WORDS] = {};
+    uint firstFrameIdx = 0;
+    uint endFrameIdx = 0;
+};
+
+#endif
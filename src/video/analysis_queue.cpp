@@ -0,0 +1,389 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors.
+ *
+ * A queue of video files to be analyzed for activity. The files get analyzed in
+ * the background a few at a time, in the order they were queued, with all of the
+ * analyses sharing a single pool of worker threads, sized to the number of CPU
+ * cores. The file being shown to the user is started immediately on request,
+ * and its work - whether queued already or yet to be - is run on the pool at a
+ * higher priority than the rest; until another file is shown instead.
+ *
+ * A file's metadata gets probed on a background thread before its background
+ * analysis is started, so that slow files (e.g. on a network share) don't keep
+ * the GUI waiting.
+ *
+ * The queue holds on to the video objects (and so their results) of all the
+ * analyses it has started, so that switching between files is instant. Finished
+ * results also end up in the activity cache, for later sessions.
+ *
+ * Once asked to, the analyses keep their frames' scores, so that when the user
+ * adjusts the detection thresholds, the finished results can be re-judged on the
+ * spot; the results of analyses ongoing at the time get re-judged once they
+ * finish. Keeping the scores costs the analyses the skipping of frames past an
+ * active one, so it isn't done until the thresholds are to be adjusted.
+ *
+ */
+
+#include <QThread>
+#include <QTimer>
+#include <algorithm>
+#include "../../src/video/analysis_queue.h"
+#include "../../src/video/video_object.h"
+#include "../../src/video/video_probe.h"
+#include "../../src/messager/messager.h"
+
+// How many of the queued videos may be analyzed in the background at a time.
+// Each one's segments get spread across the shared thread pool, so this mainly
+// keeps the pool fed while an analysis is decoding its audio or finishing up.
+static const int MAX_NUM_BACKGROUND_ANALYSES = 2;
+
+// The priorities with which analyses queue their work on the shared pool.
+static const int BACKGROUND_PRIORITY = 0;
+static const int FOREGROUND_PRIORITY = 1;
+
+analysis_queue_c::analysis_queue_c(const messager_c *const messager, QObject *parent) :
+    QObject(parent),
+    messager(messager)
+{
+    this->threadPool.setMaxThreadCount(std::max(1, QThread::idealThreadCount()));
+
+    this->activitySettings.keepThumbnails = true;
+    this->activitySettings.sharedThreadPool = &this->threadPool;
+
+    this->schedulingTimer = new QTimer(this);
+    connect(this->schedulingTimer, &QTimer::timeout,
+                             this, &analysis_queue_c::start_background_analyses);
+
+    return;
+}
+
+analysis_queue_c::~analysis_queue_c(void)
+{
+    this->schedulingTimer->stop();
+
+    // The video objects' analyses use the thread pool, so they need to be gone
+    // before it is.
+    for (auto &entry: this->entries)
+    {
+        delete entry.video;
+        entry.video = nullptr;
+
+        delete entry.probe;
+        entry.probe = nullptr;
+    }
+
+    return;
+}
+
+// Adds the given files to the end of the queue, skipping any that are queued
+// already.
+//
+void analysis_queue_c::enqueue(const QStringList &filenames)
+{
+    for (const QString &filename: filenames)
+    {
+        if (this->entry_idx(filename) >= 0)
+        {
+            continue;
+        }
+
+        queue_entry_s entry;
+        entry.filename = filename;
+
+        this->entries << entry;
+    }
+
+    this->start_background_analyses();
+    this->schedulingTimer->start(1000);
+
+    return;
+}
+
+// Drops the given file from the queue, cancelling its analysis if it's ongoing.
+//
+void analysis_queue_c::remove(const QString &filename)
+{
+    const int idx = this->entry_idx(filename);
+
+    if (idx < 0)
+    {
+        return;
+    }
+
+    if (this->entries[idx].probe != nullptr)
+    {
+        this->entries[idx].probe->discard();
+    }
+
+    delete this->entries[idx].video;
+    this->entries.removeAt(idx);
+
+    return;
+}
+
+// Returns the video object of the given queued file, for showing to the user. The
+// file's analysis is given priority over the rest of the queue's, including that
+// of the file previously shown; and if it hasn't yet begun, it's begun now.
+// Returns null if the file isn't in the queue.
+//
+video_object_c* analysis_queue_c::video(const QString &filename)
+{
+    const int idx = this->entry_idx(filename);
+
+    if (idx < 0)
+    {
+        return nullptr;
+    }
+
+    if (filename != this->foregroundFilename)
+    {
+        const int prevIdx = this->entry_idx(this->foregroundFilename);
+
+        if ((prevIdx >= 0) &&
+            (this->entries[prevIdx].video != nullptr))
+        {
+            this->entries[prevIdx].video->set_analysis_priority(BACKGROUND_PRIORITY);
+        }
+
+        this->foregroundFilename = filename;
+    }
+
+    if (this->entries[idx].video == nullptr)
+    {
+        return this->start_analysis(this->entries[idx]);
+    }
+
+    this->entries[idx].video->set_analysis_priority(FOREGROUND_PRIORITY);
+
+    return this->entries[idx].video;
+}
+
+QStringList analysis_queue_c::filenames(void) const
+{
+    QStringList filenames;
+
+    for (const auto &entry: this->entries)
+    {
+        filenames << entry.filename;
+    }
+
+    return filenames;
+}
+
+// Returns the settings whose thresholds the queued videos' activity is judged by.
+//
+const video_activity_settings_s& analysis_queue_c::thresholds(void) const
+{
+    return this->activitySettings;
+}
+
+// Has the queued videos' activity judged under the thresholds of the given
+// settings (see video_activity_c::rethreshold() for which they are) from now on:
+// analyses yet to start get started with them, the finished ones get re-judged
+// now, and the ongoing ones once they finish.
+//
+void analysis_queue_c::set_thresholds(const video_activity_settings_s &thresholds)
+{
+    this->activitySettings.pixelDiffThreshold = thresholds.pixelDiffThreshold;
+    this->activitySettings.backgroundTileMinForeground = thresholds.backgroundTileMinForeground;
+    this->activitySettings.activityHoldSeconds = thresholds.activityHoldSeconds;
+    this->activitySettings.audioThresholdDeviations = thresholds.audioThresholdDeviations;
+
+    for (auto &entry: this->entries)
+    {
+        if (entry.video != nullptr)
+        {
+            entry.needsRethreshold = true;
+            this->rethreshold(entry);
+        }
+    }
+
+    // Check back on the ongoing ones.
+    if (!this->schedulingTimer->isActive())
+    {
+        this->schedulingTimer->start(1000);
+    }
+
+    return;
+}
+
+// Has the queued videos' activity looked for only in the given regions of their
+// frames (see activity_mask_c) from now on. Unlike the thresholds, the regions
+// decide which parts of the frames get compared in the first place, so results
+// found without them can't be re-judged but need to be found again: the videos'
+// analyses get discarded, and started over as they're next asked for or come up
+// in the queue. The caller is to let go of any video objects it got from the
+// queue before calling this.
+//
+void analysis_queue_c::set_mask_regions(const QVector<activity_mask_region_s> &regions)
+{
+    this->activitySettings.maskRegions = regions;
+    this->restart_analyses();
+
+    return;
+}
+
+// Has the queued videos' analyses keep their frames' scores from now on, so that
+// their video activity can be re-judged under new thresholds (see set_thresholds()).
+// Results found without the scores can't be re-judged, so, as with new mask
+// regions, the videos' analyses get discarded and started over; the caller is to
+// let go of any video objects it got from the queue before calling this. Does
+// nothing if the scores are being kept already.
+//
+void analysis_queue_c::keep_frame_scores(void)
+{
+    if (this->activitySettings.keepFrameScores)
+    {
+        return;
+    }
+
+    this->activitySettings.keepFrameScores = true;
+    this->restart_analyses();
+
+    return;
+}
+
+// Discards the queued videos' analyses, for them to be started over, under the
+// current settings, as they're next asked for or come up in the queue.
+//
+void analysis_queue_c::restart_analyses(void)
+{
+    for (auto &entry: this->entries)
+    {
+        delete entry.video;
+        entry.video = nullptr;
+        entry.needsRethreshold = false;
+    }
+
+    if (!this->schedulingTimer->isActive())
+    {
+        this->schedulingTimer->start(1000);
+    }
+
+    return;
+}
+
+// Re-judges the given entry's results under the current thresholds, if they're
+// due to be and its analysis has finished.
+//
+void analysis_queue_c::rethreshold(queue_entry_s &entry)
+{
+    if (!entry.needsRethreshold ||
+        (entry.video == nullptr) ||
+        !entry.video->rethreshold(this->activitySettings))
+    {
+        return;
+    }
+
+    entry.needsRethreshold = false;
+    emit activity_rethresholded(entry.video);
+
+    return;
+}
+
+int analysis_queue_c::entry_idx(const QString &filename) const
+{
+    for (int i = 0; i < this->entries.size(); i++)
+    {
+        if (this->entries.at(i).filename == filename)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+// Begins the analysis of the given queue entry's file by creating a video object
+// for it.
+//
+video_object_c* analysis_queue_c::start_analysis(queue_entry_s &entry)
+{
+    k_assert((entry.video == nullptr), "Tried to re-start a video's analysis.");
+
+    const bool isForeground = (entry.filename == this->foregroundFilename);
+
+    if (entry.probe != nullptr)
+    {
+        entry.probe->discard();
+        entry.probe = nullptr;
+    }
+
+    video_activity_settings_s settings = this->activitySettings;
+    settings.threadPriority = (isForeground? FOREGROUND_PRIORITY : BACKGROUND_PRIORITY);
+
+    INFO(("Starting the %s analysis of '%s'.", (isForeground? "foreground" : "background"),
+          entry.filename.toStdString().c_str()));
+
+    entry.video = new video_object_c(entry.filename, this->messager, settings);
+
+    return entry.video;
+}
+
+// Starts the analyses of the next files in the queue, as long as there are
+// fewer than the maximum number of them already going on.
+//
+void analysis_queue_c::start_background_analyses(void)
+{
+    int numOngoing = 0;
+
+    for (auto &entry: this->entries)
+    {
+        this->rethreshold(entry);
+    }
+
+    for (const auto &entry: this->entries)
+    {
+        if ((entry.video != nullptr) &&
+            !entry.video->activity().strip_build_has_finished())
+        {
+            numOngoing++;
+        }
+    }
+
+    for (auto &entry: this->entries)
+    {
+        if (numOngoing >= MAX_NUM_BACKGROUND_ANALYSES)
+        {
+            return;
+        }
+
+        if (entry.video != nullptr)
+        {
+            continue;
+        }
+
+        // Probe the file first; we'll be back on a later round to start its
+        // analysis.
+        if (!video_probe_c::is_cached(entry.filename))
+        {
+            if (entry.probe == nullptr)
+            {
+                entry.probe = new video_probe_c(entry.filename, this);
+                entry.probe->start();
+            }
+
+            numOngoing++;
+            continue;
+        }
+
+        this->start_analysis(entry);
+        numOngoing++;
+    }
+
+    // Some of the files are still being probed, or are yet to be re-judged.
+    for (const auto &entry: this->entries)
+    {
+        if ((entry.video == nullptr) ||
+            entry.needsRethreshold)
+        {
+            return;
+        }
+    }
+
+    // Everything in the queue has been started.
+    this->schedulingTimer->stop();
+
+    return;
+}
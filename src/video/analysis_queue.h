@@ -0,0 +1,101 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors
+ *
+ */
+
+#ifndef ANALYSIS_QUEUE_H
+#define ANALYSIS_QUEUE_H
+
+#include <QStringList>
+#include <QThreadPool>
+#include <QObject>
+#include <QList>
+#include "../../src/video/video_activity.h"
+#include "../../src/common.h"
+
+class video_object_c;
+class video_probe_c;
+class messager_c;
+class QTimer;
+
+class analysis_queue_c : public QObject
+{
+    Q_OBJECT
+
+public:
+    analysis_queue_c(const messager_c *const messager, QObject *parent = nullptr);
+    ~analysis_queue_c(void);
+
+    void enqueue(const QStringList &filenames);
+
+    void remove(const QString &filename);
+
+    video_object_c* video(const QString &filename);
+
+    QStringList filenames(void) const;
+
+    const video_activity_settings_s& thresholds(void) const;
+
+    void set_thresholds(const video_activity_settings_s &thresholds);
+
+    void set_mask_regions(const QVector<activity_mask_region_s> &regions);
+
+    void keep_frame_scores(void);
+
+signals:
+    // Emitted when the given video's activity has been re-judged under new
+    // thresholds.
+    void activity_rethresholded(video_object_c *const video);
+
+private slots:
+    void start_background_analyses(void);
+
+private:
+    struct queue_entry_s
+    {
+        QString filename;
+
+        // The video object doing this file's analysis; null until it's begun.
+        video_object_c *video = nullptr;
+
+        // Probes the file's metadata ahead of its background analysis, so that
+        // starting the analysis doesn't hold up the GUI thread; null when not
+        // probing.
+        video_probe_c *probe = nullptr;
+
+        // Set if the thresholds have changed while this file's analysis was
+        // ongoing, such that its results are to be re-judged once it finishes.
+        bool needsRethreshold = false;
+    };
+
+    video_object_c* start_analysis(queue_entry_s &entry);
+
+    int entry_idx(const QString &filename) const;
+
+    void rethreshold(queue_entry_s &entry);
+
+    void restart_analyses(void);
+
+    // The files in the order they were queued.
+    QList<queue_entry_s> entries;
+
+    // The file last asked for for showing to the user, whose analysis is run
+    // ahead of the others'.
+    QString foregroundFilename;
+
+    // The settings with which the analyses get started. Frame scores are kept
+    // once asked for (see keep_frame_scores()), so that the results can be
+    // re-judged under new thresholds.
+    video_activity_settings_s activitySettings;
+
+    // The pool shared by the analyses of all of the queued videos.
+    QThreadPool threadPool;
+
+    // Used to periodically start analyses in the background as earlier ones finish.
+    QTimer *schedulingTimer = nullptr;
+
+    const messager_c *const messager;
+};
+
+#endif
@@ -0,0 +1,301 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors
+ *
+ * Per-stage counters and timers for the activity analysis.
+ *
+ * Each thread doing analysis work binds a scope object to itself for the length
+ * of the work, and the stages it times get added up in the scope, out of reach
+ * of the other threads. The scope adds its sums to the analysis' shared totals
+ * once it has recorded enough stages, and once more when it goes. So the cost of
+ * timing a stage is that of reading the clock twice, with the occasional batch of
+ * uncontended atomic additions; and a thread whose stages aren't being recorded
+ * pays only for finding that out.
+ *
+ * The trace, when collected, is written in the Trace Event Format that Chrome's
+ * trace viewer (chrome://tracing) and Perfetto (ui.perfetto.dev) read: each timed
+ * stage as a complete ("X") event, on a track per thread.
+ *
+ */
+
+#include <QFile>
+#include <algorithm>
+#include "../../src/video/analysis_stats.h"
+#include "../../src/common.h"
+
+// How many stages a scope records before adding them to the shared totals. Some
+// hundreds of frames' worth, so that the totals stay no more than a moment behind.
+static const uint SCOPE_FLUSH_INTERVAL = 256;
+
+// The most events to keep in a trace. Each takes up 24 bytes in memory, and some
+// 90 in the trace file; an hour of 30 FPS video takes a few hundred thousand.
+static const uint MAX_TRACE_EVENTS = (1 << 20);
+
+// The calling thread's innermost stats scope, if any.
+static thread_local analysis_stats_scope_c *CURRENT_SCOPE = nullptr;
+
+// Returns an identifier of the calling thread, for the trace. Threads get theirs
+// in the order in which they first ask for one.
+//
+static int trace_thread_id(void)
+{
+    static std::atomic<int> nextThreadId(1);
+    static thread_local const int threadId = nextThreadId++;
+
+    return threadId;
+}
+
+analysis_stats_c::analysis_stats_c(const bool collectTrace) :
+    collectTrace(collectTrace),
+    startTime(steady_clock_t::now())
+{
+    for (uint i = 0; i < uint(stage_e::NumStages); i++)
+    {
+        this->stageCounts[i] = 0;
+        this->stageNanoseconds[i] = 0;
+    }
+
+    this->finishedAfterNs = 0;
+
+    return;
+}
+
+const char* analysis_stats_c::stage_name(const stage_e stage)
+{
+    switch (stage)
+    {
+        case stage_e::FrameRead: return "frame read";
+        case stage_e::Decode: return "decode";
+        case stage_e::ColorConversion: return "color conversion";
+        case stage_e::Seek: return "seek";
+        case stage_e::Skip: return "skip";
+        case stage_e::Comparison: return "comparison";
+        case stage_e::Thumbnail: return "thumbnail";
+        case stage_e::PacketPrefilter: return "packet prefilter";
+        case stage_e::AudioExtraction: return "audio extraction";
+        case stage_e::AudioDecode: return "audio decode";
+        case stage_e::AudioMeasure: return "audio measure";
+        default: k_assert(0, "Unknown analysis stage."); return "";
+    }
+}
+
+// Returns how many times the given stage has been timed, and for how long in
+// all, as of the latest additions from the threads' scopes.
+//
+analysis_stats_c::stage_totals_s analysis_stats_c::stage_totals(const stage_e stage) const
+{
+    k_assert((stage < stage_e::NumStages), "Unknown analysis stage.");
+
+    stage_totals_s totals;
+    totals.count = this->stageCounts[int(stage)].load(std::memory_order_relaxed);
+    totals.nanoseconds = this->stageNanoseconds[int(stage)].load(std::memory_order_relaxed);
+
+    return totals;
+}
+
+// Stops the clock of elapsed_seconds().
+//
+void analysis_stats_c::mark_finished(void)
+{
+    const i64 elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(steady_clock_t::now() - this->startTime).count();
+
+    this->finishedAfterNs = std::max(i64(1), elapsedNs);
+
+    return;
+}
+
+// Returns the time since the stats were created; or, once the analysis has been
+// marked finished, the time it took.
+//
+real analysis_stats_c::elapsed_seconds(void) const
+{
+    const i64 finishedAfterNs = this->finishedAfterNs;
+
+    if (finishedAfterNs > 0)
+    {
+        return (finishedAfterNs / 1e9);
+    }
+
+    return std::chrono::duration<real>(steady_clock_t::now() - this->startTime).count();
+}
+
+// Writes the events logged so far into the given file, as a JSON trace. Returns
+// false if the file couldn't be written, or no trace is being collected.
+//
+bool analysis_stats_c::write_trace(const QString &filename) const
+{
+    if (!this->collectTrace)
+    {
+        return false;
+    }
+
+    std::vector<trace_event_s> events;
+    u64 numDroppedEvents = 0;
+    {
+        std::lock_guard<std::mutex> lock(this->traceMutex);
+
+        events = this->traceEvents;
+        numDroppedEvents = this->numDroppedTraceEvents;
+    }
+
+    std::sort(events.begin(), events.end(), [](const trace_event_s &a, const trace_event_s &b)
+    {
+        return (a.startUs < b.startUs);
+    });
+
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        NBENE(("Failed to open '%s' for writing the analysis trace.", filename.toUtf8().constData()));
+        return false;
+    }
+
+    QByteArray chunk;
+    bool writeWasSuccessful = true;
+
+    const auto write_chunk = [&]
+    {
+        writeWasSuccessful = (writeWasSuccessful && (file.write(chunk) == chunk.size()));
+        chunk.clear();
+    };
+
+    chunk += "{\"traceEvents\":[\n";
+
+    for (uint i = 0; i < events.size(); i++)
+    {
+        char line[192];
+        snprintf(line, sizeof(line), "{\"name\":\"%s\",\"cat\":\"analysis\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}%s\n",
+                 stage_name(events[i].stage), events[i].threadId, events[i].startUs, events[i].durationUs,
+                 (((i + 1) < events.size())? "," : ""));
+
+        chunk += line;
+
+        if (chunk.size() > (1 << 16))
+        {
+            write_chunk();
+        }
+    }
+
+    chunk += QString("],\"displayTimeUnit\":\"ms\",\"otherData\":{\"droppedEvents\":%1}}\n").arg(numDroppedEvents).toUtf8();
+    write_chunk();
+
+    if (!writeWasSuccessful)
+    {
+        NBENE(("Failed to write the analysis trace into '%s'.", filename.toUtf8().constData()));
+    }
+
+    return writeWasSuccessful;
+}
+
+analysis_stats_scope_c::analysis_stats_scope_c(analysis_stats_c *const stats) :
+    stats(stats),
+    outerScope(CURRENT_SCOPE)
+{
+    CURRENT_SCOPE = this;
+
+    return;
+}
+
+analysis_stats_scope_c::~analysis_stats_scope_c()
+{
+    k_assert((CURRENT_SCOPE == this), "Analysis stats scopes were destroyed out of order.");
+
+    this->flush();
+    CURRENT_SCOPE = this->outerScope;
+
+    return;
+}
+
+analysis_stats_c* analysis_stats_scope_c::current(void)
+{
+    return ((CURRENT_SCOPE == nullptr)? nullptr : CURRENT_SCOPE->stats);
+}
+
+void analysis_stats_scope_c::record(const analysis_stats_c::stage_e stage,
+                                    const analysis_stats_c::steady_clock_t::time_point startTime,
+                                    const analysis_stats_c::steady_clock_t::time_point endTime)
+{
+    const u64 durationNs = u64(std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - startTime).count());
+
+    this->stageTotals[int(stage)].count++;
+    this->stageTotals[int(stage)].nanoseconds += durationNs;
+
+    if (this->stats->collectTrace)
+    {
+        analysis_stats_c::trace_event_s event;
+        event.stage = stage;
+        event.threadId = trace_thread_id();
+        event.startUs = std::chrono::duration<real, std::micro>(startTime - this->stats->startTime).count();
+        event.durationUs = (durationNs / 1000.0);
+
+        this->traceEvents.push_back(event);
+    }
+
+    if (++this->numUnflushed >= SCOPE_FLUSH_INTERVAL)
+    {
+        this->flush();
+    }
+
+    return;
+}
+
+// Adds the stages recorded in this scope to the shared totals.
+//
+void analysis_stats_scope_c::flush(void)
+{
+    if ((this->stats == nullptr) ||
+        (this->numUnflushed == 0))
+    {
+        return;
+    }
+
+    for (uint i = 0; i < uint(analysis_stats_c::stage_e::NumStages); i++)
+    {
+        if (this->stageTotals[i].count > 0)
+        {
+            this->stats->stageCounts[i].fetch_add(this->stageTotals[i].count, std::memory_order_relaxed);
+            this->stats->stageNanoseconds[i].fetch_add(this->stageTotals[i].nanoseconds, std::memory_order_relaxed);
+
+            this->stageTotals[i] = analysis_stats_c::stage_totals_s();
+        }
+    }
+
+    if (!this->traceEvents.empty())
+    {
+        std::lock_guard<std::mutex> lock(this->stats->traceMutex);
+
+        const size_t numToKeep = (MAX_TRACE_EVENTS - std::min<size_t>(MAX_TRACE_EVENTS, this->stats->traceEvents.size()));
+        const size_t numKept = std::min(numToKeep, this->traceEvents.size());
+
+        this->stats->traceEvents.insert(this->stats->traceEvents.end(), this->traceEvents.begin(), (this->traceEvents.begin() + numKept));
+        this->stats->numDroppedTraceEvents += (this->traceEvents.size() - numKept);
+
+        this->traceEvents.clear();
+    }
+
+    this->numUnflushed = 0;
+
+    return;
+}
+
+analysis_stage_timer_c::analysis_stage_timer_c(const analysis_stats_c::stage_e stage) :
+    scope(((CURRENT_SCOPE != nullptr) && (CURRENT_SCOPE->stats != nullptr))? CURRENT_SCOPE : nullptr),
+    stage(stage)
+{
+    if (this->scope != nullptr)
+    {
+        this->startTime = analysis_stats_c::steady_clock_t::now();
+    }
+
+    return;
+}
+
+analysis_stage_timer_c::~analysis_stage_timer_c()
+{
+    if (this->scope != nullptr)
+    {
+        this->scope->record(this->stage, this->startTime, analysis_stats_c::steady_clock_t::now());
+    }
+
+    return;
+}
@@ -0,0 +1,166 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors
+ *
+ */
+
+#ifndef ANALYSIS_STATS_H
+#define ANALYSIS_STATS_H
+
+#include <QString>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include "../../src/types.h"
+
+// Counts and times the stages of an analysis - decoding, seeking, comparing, and
+// so on - for telling what a slow analysis is being held up by. The threads doing
+// the work record into accumulators of their own (see analysis_stats_scope_c),
+// which get added to the totals here every so often, so that the timing of the
+// inner loops stays cheap and doesn't contend for anything. Optionally, each timed
+// stage also gets logged as an event, for viewing as a trace in Chrome's or
+// Perfetto's trace viewer.
+//
+class analysis_stats_c
+{
+    friend class analysis_stats_scope_c;
+
+public:
+    // The stages of the analysis. Stages can nest, in which case the outer stage's
+    // time includes the inner's: reading a frame includes decoding and converting
+    // it, unless the decoder is decoding ahead on a thread of its own; skipping
+    // over frames includes decoding them; and decoding the audio includes measuring
+    // its loudness.
+    enum class stage_e
+    {
+        FrameRead,       // The analysis getting its next frame from the decoder.
+        Decode,          // The decoder decoding a frame.
+        ColorConversion, // The decoder converting (and downscaling) a decoded frame into the form in which it's compared.
+        Seek,            // Repositioning the decoder.
+        Skip,            // Decoding through frames being skipped over.
+        Comparison,      // Judging whether a frame shows activity.
+        Thumbnail,       // Downscaling a frame into the video's thumbnails.
+        PacketPrefilter, // Scanning the sizes of the video's compressed frames.
+        AudioExtraction, // The FFmpeg program extracting the audio into a WAV file.
+        AudioDecode,     // Decoding the audio track.
+        AudioMeasure,    // Measuring the loudness of the audio samples.
+
+        NumStages,
+    };
+
+    typedef std::chrono::steady_clock steady_clock_t;
+
+    struct stage_totals_s
+    {
+        u64 count = 0;
+        u64 nanoseconds = 0;
+    };
+
+    // If collectTrace is true, each timed stage gets logged as an event.
+    analysis_stats_c(const bool collectTrace = false);
+
+    analysis_stats_c(const analysis_stats_c&) = delete;
+    analysis_stats_c& operator=(const analysis_stats_c&) = delete;
+
+    static const char* stage_name(const stage_e stage);
+
+    stage_totals_s stage_totals(const stage_e stage) const;
+
+    void mark_finished(void);
+
+    real elapsed_seconds(void) const;
+
+    bool write_trace(const QString &filename) const;
+
+private:
+    // A timed stage, in microseconds since the stats were created.
+    struct trace_event_s
+    {
+        stage_e stage;
+        int threadId;
+        real startUs;
+        real durationUs;
+    };
+
+    std::atomic<u64> stageCounts[int(stage_e::NumStages)];
+    std::atomic<u64> stageNanoseconds[int(stage_e::NumStages)];
+
+    // The logged events, if collecting a trace; and how many got dropped for
+    // there being too many already.
+    std::vector<trace_event_s> traceEvents;
+    u64 numDroppedTraceEvents = 0;
+    mutable std::mutex traceMutex;
+
+    const bool collectTrace;
+
+    const steady_clock_t::time_point startTime;
+
+    // Zero until the analysis has finished, and then its length.
+    std::atomic<i64> finishedAfterNs;
+};
+
+// Has the stages timed on the calling thread, for as long as this object lives,
+// recorded into the given stats (which may be null, for not recording them). The
+// records get accumulated locally, and added to the stats periodically and when
+// this object is destroyed. Scopes can be nested, the innermost taking effect.
+//
+class analysis_stats_scope_c
+{
+    friend class analysis_stage_timer_c;
+
+public:
+    analysis_stats_scope_c(analysis_stats_c *const stats);
+    ~analysis_stats_scope_c(void);
+
+    analysis_stats_scope_c(const analysis_stats_scope_c&) = delete;
+    analysis_stats_scope_c& operator=(const analysis_stats_scope_c&) = delete;
+
+    // Returns the stats that the calling thread's stages are being recorded into,
+    // or null if none.
+    static analysis_stats_c* current(void);
+
+private:
+    void record(const analysis_stats_c::stage_e stage, const analysis_stats_c::steady_clock_t::time_point startTime,
+                const analysis_stats_c::steady_clock_t::time_point endTime);
+
+    void flush(void);
+
+    analysis_stats_c *const stats;
+
+    analysis_stats_c::stage_totals_s stageTotals[int(analysis_stats_c::stage_e::NumStages)];
+
+    std::vector<analysis_stats_c::trace_event_s> traceEvents;
+
+    uint numUnflushed = 0;
+
+    // The scope that was current on this thread before this one.
+    analysis_stats_scope_c *const outerScope;
+};
+
+// Times the stage for as long as this object lives, recording it into the calling
+// thread's current stats scope, if there is one. E.g.:
+//
+//     {
+//         analysis_stage_timer_c timer(analysis_stats_c::stage_e::Decode);
+//         decode_frame();
+//     }
+//
+class analysis_stage_timer_c
+{
+public:
+    analysis_stage_timer_c(const analysis_stats_c::stage_e stage);
+    ~analysis_stage_timer_c(void);
+
+    analysis_stage_timer_c(const analysis_stage_timer_c&) = delete;
+    analysis_stage_timer_c& operator=(const analysis_stage_timer_c&) = delete;
+
+private:
+    analysis_stats_scope_c *const scope;
+
+    const analysis_stats_c::stage_e stage;
+
+    analysis_stats_c::steady_clock_t::time_point startTime;
+};
+
+#endif
@@ -0,0 +1,290 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors.
+ *
+ * Kernels for finding whether two rows of pixel data differ from each other by
+ * more than a given threshold. A row is taken to differ if the absolute difference
+ * between any pair of its corresponding bytes (i.e. color channels) exceeds the
+ * threshold. For keeping score of how much two frames differ, there are also kernels
+ * for finding the largest such difference in a pair of rows.
+ *
+ * The kernels read from the two source rows directly, and the fastest one that
+ * the CPU supports is selected at runtime.
+ *
+ */
+
+#if defined(__SSE2__) || defined(_M_X64)
+    #define FRAME_DIFF_X86
+    #include <emmintrin.h>
+    #if defined(__GNUC__)
+        #define FRAME_DIFF_AVX2
+        #include <immintrin.h>
+    #endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #define FRAME_DIFF_NEON
+    #include <arm_neon.h>
+#endif
+
+#include "../../src/video/frame_diff.h"
+#include "../../src/common.h"
+
+// Compares the rows one byte at a time. Also used by the vectorized kernels to
+// handle the bytes left over at the end of a row.
+//
+static bool rows_differ_scalar(const u8 *const row1, const u8 *const row2, const uint numBytes, const u8 threshold)
+{
+    for (uint i = 0; i < numBytes; i++)
+    {
+        const u8 diff = ((row1[i] > row2[i])? (row1[i] - row2[i])
+                                            : (row2[i] - row1[i]));
+        if (diff > threshold)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Returns the largest absolute difference between two corresponding bytes in the
+// rows, one byte at a time.
+//
+static u8 rows_max_diff_scalar(const u8 *const row1, const u8 *const row2, const uint numBytes)
+{
+    u8 maxDiff = 0;
+
+    for (uint i = 0; i < numBytes; i++)
+    {
+        const u8 diff = ((row1[i] > row2[i])? (row1[i] - row2[i])
+                                            : (row2[i] - row1[i]));
+        maxDiff = ((diff > maxDiff)? diff : maxDiff);
+    }
+
+    return maxDiff;
+}
+
+// Returns the largest of the given bytes.
+//
+static u8 max_of_bytes(const u8 *const bytes, const uint numBytes)
+{
+    u8 maxByte = 0;
+
+    for (uint i = 0; i < numBytes; i++)
+    {
+        maxByte = ((bytes[i] > maxByte)? bytes[i] : maxByte);
+    }
+
+    return maxByte;
+}
+
+#ifdef FRAME_DIFF_X86
+    // For each byte, |a - b| is computed as the OR of the two saturated differences
+    // (a - b) and (b - a), one of which is always zero. Saturated-subtracting the
+    // threshold from that then leaves non-zero only the bytes exceeding it.
+    //
+    static bool rows_differ_sse2(const u8 *const row1, const u8 *const row2, const uint numBytes, const u8 threshold)
+    {
+        const __m128i thresholdVec = _mm_set1_epi8(char(threshold));
+        __m128i exceeds = _mm_setzero_si128();
+        uint i = 0;
+
+        for (; (i + 16) <= numBytes; i += 16)
+        {
+            const __m128i a = _mm_loadu_si128((const __m128i*)(row1 + i));
+            const __m128i b = _mm_loadu_si128((const __m128i*)(row2 + i));
+            const __m128i absDiff = _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+
+            exceeds = _mm_or_si128(exceeds, _mm_subs_epu8(absDiff, thresholdVec));
+        }
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(exceeds, _mm_setzero_si128())) != 0xffff)
+        {
+            return true;
+        }
+
+        return rows_differ_scalar((row1 + i), (row2 + i), (numBytes - i), threshold);
+    }
+
+    static u8 rows_max_diff_sse2(const u8 *const row1, const u8 *const row2, const uint numBytes)
+    {
+        __m128i maxDiffVec = _mm_setzero_si128();
+        uint i = 0;
+
+        for (; (i + 16) <= numBytes; i += 16)
+        {
+            const __m128i a = _mm_loadu_si128((const __m128i*)(row1 + i));
+            const __m128i b = _mm_loadu_si128((const __m128i*)(row2 + i));
+
+            maxDiffVec = _mm_max_epu8(maxDiffVec, _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a)));
+        }
+
+        alignas(16) u8 maxDiffs[16];
+        _mm_store_si128((__m128i*)maxDiffs, maxDiffVec);
+
+        const u8 vectorMax = max_of_bytes(maxDiffs, 16);
+        const u8 tailMax = rows_max_diff_scalar((row1 + i), (row2 + i), (numBytes - i));
+
+        return ((vectorMax > tailMax)? vectorMax : tailMax);
+    }
+#endif
+
+#ifdef FRAME_DIFF_AVX2
+    __attribute__((target("avx2")))
+    static bool rows_differ_avx2(const u8 *const row1, const u8 *const row2, const uint numBytes, const u8 threshold)
+    {
+        const __m256i thresholdVec = _mm256_set1_epi8(char(threshold));
+        __m256i exceeds = _mm256_setzero_si256();
+        uint i = 0;
+
+        for (; (i + 32) <= numBytes; i += 32)
+        {
+            const __m256i a = _mm256_loadu_si256((const __m256i*)(row1 + i));
+            const __m256i b = _mm256_loadu_si256((const __m256i*)(row2 + i));
+            const __m256i absDiff = _mm256_or_si256(_mm256_subs_epu8(a, b), _mm256_subs_epu8(b, a));
+
+            exceeds = _mm256_or_si256(exceeds, _mm256_subs_epu8(absDiff, thresholdVec));
+        }
+
+        if (!_mm256_testz_si256(exceeds, exceeds))
+        {
+            return true;
+        }
+
+        return rows_differ_sse2((row1 + i), (row2 + i), (numBytes - i), threshold);
+    }
+
+    __attribute__((target("avx2")))
+    static u8 rows_max_diff_avx2(const u8 *const row1, const u8 *const row2, const uint numBytes)
+    {
+        __m256i maxDiffVec = _mm256_setzero_si256();
+        uint i = 0;
+
+        for (; (i + 32) <= numBytes; i += 32)
+        {
+            const __m256i a = _mm256_loadu_si256((const __m256i*)(row1 + i));
+            const __m256i b = _mm256_loadu_si256((const __m256i*)(row2 + i));
+
+            maxDiffVec = _mm256_max_epu8(maxDiffVec, _mm256_or_si256(_mm256_subs_epu8(a, b), _mm256_subs_epu8(b, a)));
+        }
+
+        alignas(32) u8 maxDiffs[32];
+        _mm256_store_si256((__m256i*)maxDiffs, maxDiffVec);
+
+        const u8 vectorMax = max_of_bytes(maxDiffs, 32);
+        const u8 tailMax = rows_max_diff_sse2((row1 + i), (row2 + i), (numBytes - i));
+
+        return ((vectorMax > tailMax)? vectorMax : tailMax);
+    }
+#endif
+
+#ifdef FRAME_DIFF_NEON
+    static bool rows_differ_neon(const u8 *const row1, const u8 *const row2, const uint numBytes, const u8 threshold)
+    {
+        const uint8x16_t thresholdVec = vdupq_n_u8(threshold);
+        uint8x16_t exceeds = vdupq_n_u8(0);
+        uint i = 0;
+
+        for (; (i + 16) <= numBytes; i += 16)
+        {
+            const uint8x16_t absDiff = vabdq_u8(vld1q_u8(row1 + i), vld1q_u8(row2 + i));
+
+            exceeds = vorrq_u8(exceeds, vcgtq_u8(absDiff, thresholdVec));
+        }
+
+        const uint64x2_t exceedsWide = vreinterpretq_u64_u8(exceeds);
+        if ((vgetq_lane_u64(exceedsWide, 0) | vgetq_lane_u64(exceedsWide, 1)) != 0)
+        {
+            return true;
+        }
+
+        return rows_differ_scalar((row1 + i), (row2 + i), (numBytes - i), threshold);
+    }
+
+    static u8 rows_max_diff_neon(const u8 *const row1, const u8 *const row2, const uint numBytes)
+    {
+        uint8x16_t maxDiffVec = vdupq_n_u8(0);
+        uint i = 0;
+
+        for (; (i + 16) <= numBytes; i += 16)
+        {
+            maxDiffVec = vmaxq_u8(maxDiffVec, vabdq_u8(vld1q_u8(row1 + i), vld1q_u8(row2 + i)));
+        }
+
+        u8 maxDiffs[16];
+        vst1q_u8(maxDiffs, maxDiffVec);
+
+        const u8 vectorMax = max_of_bytes(maxDiffs, 16);
+        const u8 tailMax = rows_max_diff_scalar((row1 + i), (row2 + i), (numBytes - i));
+
+        return ((vectorMax > tailMax)? vectorMax : tailMax);
+    }
+#endif
+
+typedef bool (*rows_differ_fn)(const u8 *const, const u8 *const, const uint, const u8);
+typedef u8 (*rows_max_diff_fn)(const u8 *const, const u8 *const, const uint);
+
+struct frame_diff_kernel_s
+{
+    rows_differ_fn rows_differ;
+    rows_max_diff_fn rows_max_diff;
+    const char *name;
+};
+
+// Returns the fastest kernel supported by the current CPU.
+//
+static frame_diff_kernel_s select_kernel(void)
+{
+    #ifdef FRAME_DIFF_AVX2
+        if (__builtin_cpu_supports("avx2"))
+        {
+            return {rows_differ_avx2, rows_max_diff_avx2, "AVX2"};
+        }
+    #endif
+
+    #ifdef FRAME_DIFF_X86
+        return {rows_differ_sse2, rows_max_diff_sse2, "SSE2"};
+    #elif defined(FRAME_DIFF_NEON)
+        return {rows_differ_neon, rows_max_diff_neon, "NEON"};
+    #else
+        return {rows_differ_scalar, rows_max_diff_scalar, "scalar"};
+    #endif
+}
+
+// Returns the kernel to compare rows with; selecting it, and saying which it is,
+// on the first call.
+//
+static const frame_diff_kernel_s& kernel(void)
+{
+    static const frame_diff_kernel_s selectedKernel = []
+    {
+        const frame_diff_kernel_s selected = select_kernel();
+        INFO(("Comparing video frames using the %s kernel.", selected.name));
+
+        return selected;
+    }();
+
+    return selectedKernel;
+}
+
+// Returns true if the absolute difference between any two corresponding bytes
+// in the given rows is larger than the given threshold.
+//
+bool frame_diff_rows_differ(const u8 *const row1, const u8 *const row2, const uint numBytes, const u8 threshold)
+{
+    return kernel().rows_differ(row1, row2, numBytes, threshold);
+}
+
+// Returns the largest absolute difference between any two corresponding bytes in
+// the given rows.
+//
+u8 frame_diff_rows_max_diff(const u8 *const row1, const u8 *const row2, const uint numBytes)
+{
+    return kernel().rows_max_diff(row1, row2, numBytes);
+}
+
+// Returns a user-readable name of the kernel that's being used to compare rows.
+//
+const char* frame_diff_kernel_name(void)
+{
+    return kernel().name;
+}
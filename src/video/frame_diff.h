@@ -0,0 +1,18 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors
+ *
+ */
+
+#ifndef FRAME_DIFF_H
+#define FRAME_DIFF_H
+
+#include "../../src/types.h"
+
+bool frame_diff_rows_differ(const u8 *const row1, const u8 *const row2, const uint numBytes, const u8 threshold);
+
+u8 frame_diff_rows_max_diff(const u8 *const row1, const u8 *const row2, const uint numBytes);
+
+const char* frame_diff_kernel_name(void);
+
+#endif
@@ -0,0 +1,367 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors
+ *
+ * Detectors of visual activity in a video's frames, for video_activity_c to judge
+ * the frames by.
+ *
+ * The frame difference detector is the simplest: any pixel changing notably from
+ * one frame to the next makes for activity. That also makes it prone to firing on
+ * sensor noise, compression flicker and changes in lighting.
+ *
+ * The background model detector instead compares each frame against a running
+ * average of the frames before it, so that the background it compares against
+ * isn't noisy, and drifts along with slow changes in the scene. A sample that
+ * differs notably from the background counts as foreground; and since noise and
+ * flicker tend to be scattered about the frame while real activity is clustered,
+ * the frame is divided into tiles, only counting as active if enough of some one
+ * tile is foreground. The checking goes one row of tiles at a time, so a frame that
+ * is active is generally found to be so before all of it has been looked at.
+ *
+ * Scoring a frame, rather than judging it, always looks at all of it, measuring
+ * how far past a threshold of activity it goes: for the frame difference detector,
+ * the largest difference in any sample; for the background model, the largest
+ * share of foreground in any tile. A frame's score can then be judged against the
+ * threshold later on, and against another threshold after that, without having
+ * to look at the frame again.
+ *
+ * Both detectors leave out the tiles of the frame masked out by the user (see
+ * activity_mask_c) without reading them: the frame difference detector compares
+ * the rows of pixels only across the runs of tiles that are masked in, and the
+ * background model skips over the tiles masked out, neither counting their
+ * foreground nor learning their background.
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+#include "../../src/video/motion_detector.h"
+#include "../../src/video/video_activity.h"
+#include "../../src/video/frame_diff.h"
+#include "../../src/common.h"
+
+// The size of the tiles, in pixels per side, by which the frame difference
+// detector applies the mask regions. Its comparisons go over rows of tiles, so
+// small tiles cost it little, while following the regions' edges closely.
+static const uint FRAME_DIFFERENCE_MASK_TILE_SIZE = 8;
+
+motion_detector_c::~motion_detector_c()
+{
+    return;
+}
+
+motion_detector_c* motion_detector_c::create(const video_activity_settings_s &settings)
+{
+    switch (settings.motionDetector)
+    {
+        case video_activity_settings_s::motion_detector_e::FrameDifference:
+        {
+            return new frame_difference_detector_c(settings.pixelDiffThreshold, settings.maskRegions);
+        }
+        case video_activity_settings_s::motion_detector_e::BackgroundModel:
+        {
+            return new background_model_detector_c(settings.pixelDiffThreshold, settings.backgroundLearningRate,
+                                                   settings.backgroundTileSize, settings.backgroundTileMinForeground,
+                                                   settings.maskRegions);
+        }
+        default: k_assert(0, "Unknown motion detector."); return nullptr;
+    }
+}
+
+frame_difference_detector_c::frame_difference_detector_c(const u8 threshold, const QVector<activity_mask_region_s> &maskRegions) :
+    threshold(threshold),
+    mask(maskRegions, FRAME_DIFFERENCE_MASK_TILE_SIZE)
+{
+    return;
+}
+
+const char* frame_difference_detector_c::name() const
+{
+    return "frame difference";
+}
+
+void frame_difference_detector_c::reset(const cv::Mat &frame)
+{
+    (void)frame;
+
+    return;
+}
+
+bool frame_difference_detector_c::is_active(const cv::Mat &frame, const cv::Mat &prevFrame)
+{
+    return frames_differ(frame, prevFrame, this->threshold, &this->mask);
+}
+
+float frame_difference_detector_c::activity_score(const cv::Mat &frame, const cv::Mat &prevFrame)
+{
+    return frames_max_diff(frame, prevFrame, &this->mask);
+}
+
+bool frame_difference_detector_c::score_is_active(const float score) const
+{
+    return (score > this->threshold);
+}
+
+// Returns true if any color channel of any pixel in the two frames differs by
+// more than the given threshold. Comparison stops at the first row in which such
+// a pixel is found. If a mask is given, only the pixels it masks in are compared.
+//
+bool frame_difference_detector_c::frames_differ(const cv::Mat &frame1, const cv::Mat &frame2, const u8 threshold,
+                                                activity_mask_c *const mask)
+{
+    k_assert(((frame1.rows == frame2.rows) && (frame1.cols == frame2.cols)),
+             "Frame sizes do not match.");
+    k_assert((frame1.type() == frame2.type()),
+             "Frame types do not match.");
+    k_assert((frame1.depth() == CV_8U),
+             "Expected frames with 8-bit color channels.");
+
+    const uint rowBytes = (frame1.cols * frame1.elemSize());
+
+    if ((mask != nullptr) &&
+        !mask->is_empty())
+    {
+        const uint pixelBytes = frame1.elemSize();
+
+        mask->prepare(frame1.cols, frame1.rows);
+
+        for (int y = 0; y < frame1.rows; y++)
+        {
+            for (const auto &span: mask->row_spans(y))
+            {
+                if (frame_diff_rows_differ((frame1.ptr<u8>(y) + (span.first * pixelBytes)), (frame2.ptr<u8>(y) + (span.first * pixelBytes)),
+                                           ((span.second - span.first) * pixelBytes), threshold))
+                {
+                    return true;
+                }
+            }
+        }
+
+        return false;
+    }
+
+    for (int y = 0; y < frame1.rows; y++)
+    {
+        if (frame_diff_rows_differ(frame1.ptr<u8>(y), frame2.ptr<u8>(y), rowBytes, threshold))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Returns the largest difference between any color channel of any pixel in the
+// two frames; or, if a mask is given, of any pixel it masks in.
+//
+u8 frame_difference_detector_c::frames_max_diff(const cv::Mat &frame1, const cv::Mat &frame2, activity_mask_c *const mask)
+{
+    k_assert(((frame1.rows == frame2.rows) && (frame1.cols == frame2.cols)),
+             "Frame sizes do not match.");
+    k_assert((frame1.type() == frame2.type()),
+             "Frame types do not match.");
+    k_assert((frame1.depth() == CV_8U),
+             "Expected frames with 8-bit color channels.");
+
+    const uint rowBytes = (frame1.cols * frame1.elemSize());
+    u8 maxDiff = 0;
+
+    if ((mask != nullptr) &&
+        !mask->is_empty())
+    {
+        const uint pixelBytes = frame1.elemSize();
+
+        mask->prepare(frame1.cols, frame1.rows);
+
+        for (int y = 0; y < frame1.rows; y++)
+        {
+            for (const auto &span: mask->row_spans(y))
+            {
+                maxDiff = std::max(maxDiff, frame_diff_rows_max_diff((frame1.ptr<u8>(y) + (span.first * pixelBytes)),
+                                                                     (frame2.ptr<u8>(y) + (span.first * pixelBytes)),
+                                                                     ((span.second - span.first) * pixelBytes)));
+            }
+        }
+
+        return maxDiff;
+    }
+
+    for (int y = 0; y < frame1.rows; y++)
+    {
+        maxDiff = std::max(maxDiff, frame_diff_rows_max_diff(frame1.ptr<u8>(y), frame2.ptr<u8>(y), rowBytes));
+    }
+
+    return maxDiff;
+}
+
+background_model_detector_c::background_model_detector_c(const u8 threshold, const real learningRate, const uint tileSize,
+                                                         const real tileMinForeground,
+                                                         const QVector<activity_mask_region_s> &maskRegions) :
+    threshold(threshold),
+    learningRate(float(std::max(0.0, std::min(1.0, double(learningRate))))),
+    tileSize(std::max(1u, tileSize)),
+    tileMinForeground(std::max(real(0), tileMinForeground)),
+    mask(maskRegions, std::max(1u, tileSize))
+{
+    return;
+}
+
+const char* background_model_detector_c::name() const
+{
+    return "background model";
+}
+
+// Returns true if the detector's background matches the given frame's dimensions.
+//
+bool background_model_detector_c::has_background_for(const cv::Mat &frame) const
+{
+    return ((this->background.rows == frame.rows) &&
+            (this->background.cols == int(frame.cols * frame.channels())));
+}
+
+// Returns true if the tile in the given column of the tiles on the given row of
+// pixels is masked out. The mask needs to have been laid out for the frame.
+//
+bool background_model_detector_c::tile_is_masked_out(const int y, const uint tileCol) const
+{
+    return (!this->mask.is_empty() &&
+            !this->mask.tile_is_included((y / this->tileSize), tileCol));
+}
+
+void background_model_detector_c::reset(const cv::Mat &frame)
+{
+    k_assert((frame.depth() == CV_8U),
+             "Expected frames with 8-bit color channels.");
+
+    const uint rowSamples = (frame.cols * frame.channels());
+
+    this->mask.prepare(frame.cols, frame.rows);
+
+    this->background.create(frame.rows, rowSamples, CV_32FC1);
+
+    for (int y = 0; y < frame.rows; y++)
+    {
+        const u8 *const samples = frame.ptr<u8>(y);
+        float *const backgroundSamples = this->background.ptr<float>(y);
+
+        for (uint x = 0; x < rowSamples; x++)
+        {
+            backgroundSamples[x] = samples[x];
+        }
+    }
+
+    return;
+}
+
+bool background_model_detector_c::is_active(const cv::Mat &frame, const cv::Mat &prevFrame)
+{
+    (void)prevFrame;
+
+    bool isActive = false;
+    this->compare_to_background(frame, true, isActive);
+
+    return isActive;
+}
+
+float background_model_detector_c::activity_score(const cv::Mat &frame, const cv::Mat &prevFrame)
+{
+    (void)prevFrame;
+
+    bool isActive = false;
+
+    return this->compare_to_background(frame, false, isActive);
+}
+
+// Compares the given frame against the background, one row of tiles at a time,
+// bringing the background up to date as it goes; and returns the largest fraction
+// of any one tile's samples found to differ notably from the background. Sets
+// isActive if any tile is active under the detector's thresholds; and if asked
+// to stop there, stops at the end of the row of tiles in which that tile is,
+// leaving the rest of the background as it was.
+//
+float background_model_detector_c::compare_to_background(const cv::Mat &frame, const bool stopAtActive, bool &isActive)
+{
+    k_assert((frame.depth() == CV_8U),
+             "Expected frames with 8-bit color channels.");
+
+    isActive = false;
+
+    // Without a background to compare against (e.g. if the detector was never
+    // reset), this frame becomes the background.
+    if (!this->has_background_for(frame))
+    {
+        this->reset(frame);
+        return 0;
+    }
+
+    const uint rowSamples = (frame.cols * frame.channels());
+    const uint tileRowSamples = (this->tileSize * frame.channels());
+    const uint numTileCols = ((rowSamples + tileRowSamples - 1) / tileRowSamples);
+    const float threshold = this->threshold;
+    const float learningRate = this->learningRate;
+    float maxForeground = 0;
+
+    this->tileForegroundCounts.assign(numTileCols, 0);
+
+    for (int y = 0; y < frame.rows; y++)
+    {
+        const u8 *const samples = frame.ptr<u8>(y);
+        float *const backgroundSamples = this->background.ptr<float>(y);
+
+        for (uint tileCol = 0; tileCol < numTileCols; tileCol++)
+        {
+            if (this->tile_is_masked_out(y, tileCol))
+            {
+                continue;
+            }
+
+            const uint tileEnd = std::min(rowSamples, ((tileCol + 1) * tileRowSamples));
+            uint foregroundCount = 0;
+
+            for (uint x = (tileCol * tileRowSamples); x < tileEnd; x++)
+            {
+                const float diff = (samples[x] - backgroundSamples[x]);
+
+                foregroundCount += (std::fabs(diff) > threshold);
+                backgroundSamples[x] += (learningRate * diff);
+            }
+
+            this->tileForegroundCounts[tileCol] += foregroundCount;
+        }
+
+        // At the end of each row of tiles, see whether any of them is active.
+        const uint tileRows = ((y % this->tileSize) + 1);
+
+        if ((tileRows == this->tileSize) ||
+            ((y + 1) == frame.rows))
+        {
+            for (uint tileCol = 0; tileCol < numTileCols; tileCol++)
+            {
+                const uint tileWidth = (std::min(rowSamples, ((tileCol + 1) * tileRowSamples)) - (tileCol * tileRowSamples));
+                const uint minForegroundCount = std::max(1u, uint(std::ceil(this->tileMinForeground * tileWidth * tileRows)));
+
+                maxForeground = std::max(maxForeground, (this->tileForegroundCounts[tileCol] / float(tileWidth * tileRows)));
+                isActive |= (this->tileForegroundCounts[tileCol] >= minForegroundCount);
+            }
+
+            if (isActive &&
+                stopAtActive)
+            {
+                return maxForeground;
+            }
+
+            std::fill(this->tileForegroundCounts.begin(), this->tileForegroundCounts.end(), 0);
+        }
+    }
+
+    return maxForeground;
+}
+
+// A tile counts as active when at least the minimum fraction of its samples, and
+// at least one of them, is foreground.
+//
+bool background_model_detector_c::score_is_active(const float score) const
+{
+    return ((score > 0) &&
+            (score >= float(this->tileMinForeground)));
+}
@@ -0,0 +1,139 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors
+ *
+ */
+
+#ifndef MOTION_DETECTOR_H
+#define MOTION_DETECTOR_H
+
+#include <opencv2/core/core.hpp>
+#include <vector>
+#include "../../src/video/activity_mask.h"
+#include "../../src/types.h"
+
+struct video_activity_settings_s;
+
+// Judges, frame by frame, whether a video's frames show activity. The frames are
+// given in the form in which video_activity_c compares them (see its comparison
+// modes), one after another in the order of the video; after a jump in the
+// video, the detector is to be reset with the frame jumped to. Only the parts of
+// the frames let through by the settings' mask regions get looked at.
+//
+// Instead of being judged outright, frames can also be given a score, from which
+// the detector's judgement can be had later on (see score_is_active()); so that
+// the frames' scores can be kept, and the video re-judged under other thresholds
+// without its frames having to be decoded again.
+//
+class motion_detector_c
+{
+public:
+    virtual ~motion_detector_c(void);
+
+    // Returns a new detector of the kind asked for in the settings. The caller
+    // takes ownership of it.
+    static motion_detector_c* create(const video_activity_settings_s &settings);
+
+    virtual const char* name(void) const = 0;
+
+    // Forgets what's been seen so far, and starts over from the given frame.
+    virtual void reset(const cv::Mat &frame) = 0;
+
+    // Returns true if the given frame shows activity. The previous frame given
+    // (or the frame reset to) is passed along in prevFrame.
+    virtual bool is_active(const cv::Mat &frame, const cv::Mat &prevFrame) = 0;
+
+    // Returns a measure of how much activity the given frame shows, with prevFrame
+    // as in is_active(). Unlike is_active(), looks at all of the frame, so that the
+    // detector needn't be reset after an active frame.
+    virtual float activity_score(const cv::Mat &frame, const cv::Mat &prevFrame) = 0;
+
+    // Returns true if a frame given the score by activity_score() would count as
+    // active under this detector's thresholds.
+    virtual bool score_is_active(const float score) const = 0;
+};
+
+// Finds activity by comparing each frame against the one before it: a frame is
+// active if any of its pixels differs notably from the previous frame's. A frame's
+// score is the largest difference in any of its pixels' color channels.
+//
+class frame_difference_detector_c : public motion_detector_c
+{
+public:
+    frame_difference_detector_c(const u8 threshold, const QVector<activity_mask_region_s> &maskRegions = QVector<activity_mask_region_s>());
+
+    const char* name(void) const override;
+
+    void reset(const cv::Mat &frame) override;
+
+    bool is_active(const cv::Mat &frame, const cv::Mat &prevFrame) override;
+
+    float activity_score(const cv::Mat &frame, const cv::Mat &prevFrame) override;
+
+    bool score_is_active(const float score) const override;
+
+    static bool frames_differ(const cv::Mat &frame1, const cv::Mat &frame2, const u8 threshold,
+                              activity_mask_c *const mask = nullptr);
+
+    static u8 frames_max_diff(const cv::Mat &frame1, const cv::Mat &frame2, activity_mask_c *const mask = nullptr);
+
+private:
+    const u8 threshold;
+
+    activity_mask_c mask;
+};
+
+// Finds activity by comparing each frame against a running average of the frames
+// before it, which soaks up sensor noise and follows slow changes in lighting.
+// The frames are divided into square tiles, and a frame is active if enough of
+// the samples in any one tile differ notably from the background. Checking stops
+// at the first row of tiles found to be active, leaving the rest of the background
+// as it was; so after an active frame, the detector is best reset. A frame's score
+// is the largest fraction of any one tile's samples that differ notably from the
+// background, which scoring brings up to date across all of the frame.
+//
+class background_model_detector_c : public motion_detector_c
+{
+public:
+    background_model_detector_c(const u8 threshold, const real learningRate, const uint tileSize,
+                                const real tileMinForeground,
+                                const QVector<activity_mask_region_s> &maskRegions = QVector<activity_mask_region_s>());
+
+    const char* name(void) const override;
+
+    void reset(const cv::Mat &frame) override;
+
+    bool is_active(const cv::Mat &frame, const cv::Mat &prevFrame) override;
+
+    float activity_score(const cv::Mat &frame, const cv::Mat &prevFrame) override;
+
+    bool score_is_active(const float score) const override;
+
+private:
+    bool has_background_for(const cv::Mat &frame) const;
+
+    bool tile_is_masked_out(const int y, const uint tileCol) const;
+
+    float compare_to_background(const cv::Mat &frame, const bool stopAtActive, bool &isActive);
+
+    // For each sample (color channel of a pixel) of the frame, its running
+    // average over the frames seen so far.
+    cv::Mat background;
+
+    // For each tile in the current row of tiles, how many of its samples differ
+    // notably from the background.
+    std::vector<uint> tileForegroundCounts;
+
+    const u8 threshold;
+
+    const float learningRate;
+
+    const uint tileSize;
+
+    const real tileMinForeground;
+
+    // Laid out on the same tiles as the detector's own.
+    activity_mask_c mask;
+};
+
+#endif
@@ -0,0 +1,187 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors
+ *
+ * A pre-filter for video analysis that picks out the stretches of a video that
+ * might contain visual activity without decoding any of it, by looking at the
+ * sizes of the video's compressed frames as they come off the demuxer.
+ *
+ * A predicted (P/B) frame only encodes how it differs from its reference frames,
+ * so on static footage these frames stay small and uniform in size, and grow
+ * when something moves. Frames notably larger than the video's typical predicted
+ * frame are taken as candidates for activity, and the stretches around them are
+ * left for the full analysis to decode and compare. Keyframes are always large,
+ * so they tell us nothing and are left out of the judgement.
+ *
+ */
+
+extern "C"
+{
+    #include <libavformat/avformat.h>
+    #include <libavcodec/avcodec.h>
+    #include <libavutil/avutil.h>
+}
+
+#include <QByteArray>
+#include <algorithm>
+#include "../../src/video/packet_prefilter.h"
+#include "../../src/common.h"
+
+// Returns the size above which a compressed frame counts as notably large, given
+// the sizes of all the predicted frames: the median size plus the given number
+// of median absolute deviations from it.
+//
+static u32 size_threshold(std::vector<u32> sizes, const real numDeviations)
+{
+    const auto median = [](std::vector<u32> &values)->u32
+    {
+        auto mid = (values.begin() + (values.size() / 2));
+        std::nth_element(values.begin(), mid, values.end());
+        return *mid;
+    };
+
+    const u32 medianSize = median(sizes);
+
+    for (auto &size: sizes)
+    {
+        size = ((size > medianSize)? (size - medianSize) : (medianSize - size));
+    }
+
+    // On perfectly static footage every predicted frame may be the same size,
+    // in which case any frame even a byte larger would count.
+    const u32 deviation = std::max(1u, median(sizes));
+
+    return u32(medianSize + (deviation * numDeviations));
+}
+
+// Finds the ranges of frames, as [start, end) frame indices in ascending order,
+// that might contain visual activity: those within marginFrames of a predicted
+// frame notably larger than usual, with ranges less than mergeGapFrames apart
+// merged together (each range costs a seek, which on most codecs means decoding
+// forward from a keyframe anyway). Returns false if the video's packets couldn't
+// be read, or don't lend themselves to this, as with intra-only codecs; or if
+// shouldStop got set during the scan.
+//
+bool packet_prefilter_find_candidates(const QString &filename, const uint numFrames, const real thresholdDeviations,
+                                      const uint marginFrames, const uint mergeGapFrames, const std::atomic<bool> &shouldStop,
+                                      std::vector<std::pair<uint, uint>> &candidateRanges)
+{
+    candidateRanges.clear();
+
+    // For each frame, the size of its packet; or 0 for keyframes, and for frames
+    // whose packet couldn't be placed.
+    std::vector<u32> frameSizes(numFrames, 0);
+    std::vector<u32> predictedFrameSizes;
+    bool scanWasCompleted = true;
+
+    // Read through the video's packets.
+    {
+        AVFormatContext *formatContext = nullptr;
+
+        if (avformat_open_input(&formatContext, filename.toUtf8().constData(), nullptr, nullptr) < 0)
+        {
+            NBENE(("Failed to open '%s' for the packet pre-filter.", filename.toUtf8().constData()));
+            return false;
+        }
+
+        const int streamIdx = ((avformat_find_stream_info(formatContext, nullptr) < 0)? -1
+                                                                                       : av_find_best_stream(formatContext, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0));
+        if (streamIdx < 0)
+        {
+            NBENE(("Failed to find a video stream in '%s' for the packet pre-filter.", filename.toUtf8().constData()));
+            avformat_close_input(&formatContext);
+            return false;
+        }
+
+        const AVStream *const stream = formatContext->streams[streamIdx];
+        const i64 startTime = ((stream->start_time == AV_NOPTS_VALUE)? 0 : stream->start_time);
+        const AVRational frameRate = ((stream->avg_frame_rate.num > 0)? stream->avg_frame_rate : stream->r_frame_rate);
+        const bool haveFrameRate = ((frameRate.num > 0) && (frameRate.den > 0));
+
+        for (uint i = 0; i < formatContext->nb_streams; i++)
+        {
+            if (int(i) != streamIdx)
+            {
+                formatContext->streams[i]->discard = AVDISCARD_ALL;
+            }
+        }
+
+        AVPacket *packet = av_packet_alloc();
+        k_assert((packet != nullptr), "Failed to allocate memory for the packet pre-filter.");
+
+        for (uint packetIdx = 0; av_read_frame(formatContext, packet) >= 0; )
+        {
+            if (packet->stream_index == streamIdx)
+            {
+                // Packets come in decoding order, so place each by its presentation
+                // time where it has one.
+                const i64 timestamp = ((packet->pts != AV_NOPTS_VALUE)? packet->pts : packet->dts);
+                const i64 frameIdx = ((haveFrameRate && (timestamp != AV_NOPTS_VALUE))? av_rescale_q((timestamp - startTime), stream->time_base, av_inv_q(frameRate))
+                                                                                          : i64(packetIdx));
+
+                if ((frameIdx >= 0) &&
+                    (frameIdx < i64(numFrames)) &&
+                    !(packet->flags & AV_PKT_FLAG_KEY))
+                {
+                    frameSizes[frameIdx] = u32(packet->size);
+                    predictedFrameSizes.push_back(u32(packet->size));
+                }
+
+                packetIdx++;
+
+                // Periodically check to make sure the user doesn't want us to stop processing.
+                if (((packetIdx % 1000) == 0) &&
+                    shouldStop)
+                {
+                    scanWasCompleted = false;
+                }
+            }
+
+            av_packet_unref(packet);
+
+            if (!scanWasCompleted)
+            {
+                break;
+            }
+        }
+
+        av_packet_free(&packet);
+        avformat_close_input(&formatContext);
+    }
+
+    // With too few predicted frames to go by, e.g. in an intra-only video, we
+    // can't tell large frames from ordinary ones.
+    if (!scanWasCompleted ||
+        predictedFrameSizes.empty() ||
+        (predictedFrameSizes.size() < (numFrames / 2)))
+    {
+        return false;
+    }
+
+    const u32 threshold = size_threshold(predictedFrameSizes, thresholdDeviations);
+
+    for (uint i = 0; i < numFrames; i++)
+    {
+        if (frameSizes[i] <= threshold)
+        {
+            continue;
+        }
+
+        // Start the range at least one frame early, so that the candidate frame
+        // gets compared against its predecessor.
+        const uint startFrameIdx = ((i > marginFrames)? (i - std::max(1u, marginFrames)) : 0);
+        const uint endFrameIdx = uint(std::min<u64>((u64(i) + marginFrames + 1), numFrames));
+
+        if (!candidateRanges.empty() &&
+            ((u64(candidateRanges.back().second) + mergeGapFrames) >= startFrameIdx))
+        {
+            candidateRanges.back().second = std::max(candidateRanges.back().second, endFrameIdx);
+        }
+        else
+        {
+            candidateRanges.emplace_back(startFrameIdx, endFrameIdx);
+        }
+    }
+
+    return true;
+}
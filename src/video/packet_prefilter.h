@@ -0,0 +1,20 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors
+ *
+ */
+
+#ifndef PACKET_PREFILTER_H
+#define PACKET_PREFILTER_H
+
+#include <QString>
+#include <atomic>
+#include <utility>
+#include <vector>
+#include "../../src/types.h"
+
+bool packet_prefilter_find_candidates(const QString &filename, const uint numFrames, const real thresholdDeviations,
+                                      const uint marginFrames, const uint mergeGapFrames, const std::atomic<bool> &shouldStop,
+                                      std::vector<std::pair<uint, uint>> &candidateRanges);
+
+#endif
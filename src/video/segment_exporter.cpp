@@ -0,0 +1,593 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors
+ *
+ * Exports a video's segments of activity, either as a list of cuts - an EDL for
+ * players that skip the inactive stretches, or an FFmpeg concat script - or as a
+ * highlights file holding only the segments.
+ *
+ * Nothing gets re-encoded. The highlights file is made by copying the video's
+ * compressed packets over into a new container, via libavformat, so its cost is
+ * that of reading and writing the segments' bytes. A predicted frame can't be
+ * decoded without the frames before it, so each segment is first widened to
+ * begin on the keyframe at or before its start, found by seeking to the segment
+ * and reading up to the keyframe; the segments that then overlap get merged. The
+ * ends of the segments needn't be moved, as the frames up to a segment's end
+ * don't depend on those after it.
+ *
+ * The packets of each segment get their timestamps shifted to follow on from the
+ * segment before it, so that the highlights play through without gaps.
+ *
+ */
+
+extern "C"
+{
+    #include <libavformat/avformat.h>
+    #include <libavcodec/avcodec.h>
+    #include <libavutil/avutil.h>
+}
+
+#include <QtConcurrent/QtConcurrent>
+#include <QTextStream>
+#include <QFileInfo>
+#include <QDir>
+#include <QFile>
+#include <algorithm>
+#include "../../src/video/segment_exporter.h"
+#include "../../src/common.h"
+
+// When copying a segment into the highlights file, for how long past the end of
+// the segment to keep reading for packets of the other streams, which containers
+// may interleave some way apart from the video's.
+static const uint STREAM_INTERLEAVE_SLACK_MS = 2000;
+
+// Called by libavformat while it waits on the file, to ask whether to give up.
+//
+static int should_interrupt(void *const shouldCancel)
+{
+    return ((shouldCancel != nullptr) &&
+            ((const std::atomic<bool>*)shouldCancel)->load());
+}
+
+// Returns the packet's presentation timestamp, or its decoding timestamp if it has
+// none.
+//
+static i64 packet_timestamp(const AVPacket *const packet)
+{
+    return ((packet->pts != AV_NOPTS_VALUE)? packet->pts : packet->dts);
+}
+
+segment_exporter_c::segment_exporter_c(const QString &videoFilename, const std::vector<std::pair<uint, uint>> &segments,
+                                       const QString &outFilename, const export_format_e format, QObject *parent) :
+    QObject(parent),
+    segments(segments),
+    videoFilename(videoFilename),
+    outFilename(outFilename),
+    format(format)
+{
+    threadShouldStop = false;
+    exportProgress = 0;
+
+    return;
+}
+
+segment_exporter_c::~segment_exporter_c()
+{
+    this->cancel();
+    this->exportThread.waitForFinished();
+
+    return;
+}
+
+// Begins the export on a thread of its own. This is kept apart from construction
+// so that the caller can connect to finished() first.
+//
+void segment_exporter_c::start()
+{
+    k_assert(!this->hasStarted, "Tried to re-start a segment export.");
+
+    this->hasStarted = true;
+
+    this->exportThread = QtConcurrent::run([this]
+    {
+        const bool succeeded = this->run();
+
+        if (!this->threadShouldStop)
+        {
+            emit finished(this->outFilename, succeeded);
+        }
+    });
+
+    return;
+}
+
+// Asks the export to give up. It does so asynchronously, without signalling
+// finished(), and removes what it had written of the output.
+//
+void segment_exporter_c::cancel()
+{
+    this->threadShouldStop = true;
+
+    return;
+}
+
+real segment_exporter_c::progress() const
+{
+    return this->exportProgress;
+}
+
+const QString& segment_exporter_c::out_file_name() const
+{
+    return this->outFilename;
+}
+
+// Returns the name of the file into which the given video's segments would by
+// default be exported in the given format: next to the video, and named after it.
+//
+QString segment_exporter_c::default_out_file_name(const QString &videoFilename, const export_format_e format)
+{
+    const QFileInfo fileInfo(videoFilename);
+    const QString baseName = QDir(fileInfo.path()).filePath(fileInfo.completeBaseName());
+
+    switch (format)
+    {
+        case export_format_e::Edl: return (baseName + ".edl");
+        case export_format_e::Ffconcat: return (baseName + ".ffconcat");
+        case export_format_e::Highlights: return (baseName + ".highlights." + (fileInfo.suffix().isEmpty()? QString("mkv") : fileInfo.suffix()));
+        default: k_assert(0, "Unknown export format."); return QString();
+    }
+}
+
+// Exports the segments on the calling thread, blocking until done. Returns false
+// if the video couldn't be read, or the output written; or if the export got
+// cancelled. In those cases, no output file is left behind.
+//
+bool segment_exporter_c::run()
+{
+    this->exportProgress = 0;
+
+    AVFormatContext *formatContext = avformat_alloc_context();
+    k_assert((formatContext != nullptr), "Failed to allocate memory for exporting a video's segments.");
+
+    formatContext->interrupt_callback.callback = should_interrupt;
+    formatContext->interrupt_callback.opaque = (void*)&this->threadShouldStop;
+
+    // On failure, avformat_open_input() frees the context itself.
+    if (avformat_open_input(&formatContext, this->videoFilename.toUtf8().constData(), nullptr, nullptr) < 0)
+    {
+        NBENE(("Failed to open '%s' for exporting its segments.", this->videoFilename.toUtf8().constData()));
+        return false;
+    }
+
+    const int streamIdx = ((avformat_find_stream_info(formatContext, nullptr) < 0)? -1
+                                                                                   : av_find_best_stream(formatContext, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0));
+    const AVStream *const stream = ((streamIdx < 0)? nullptr : formatContext->streams[streamIdx]);
+    const AVRational frameRate = ((stream == nullptr)? AVRational{0, 1}
+                                                     : ((stream->avg_frame_rate.num > 0)? stream->avg_frame_rate : stream->r_frame_rate));
+
+    if ((stream == nullptr) ||
+        (frameRate.num <= 0) ||
+        (frameRate.den <= 0))
+    {
+        NBENE(("Failed to find a video stream in '%s' for exporting its segments.", this->videoFilename.toUtf8().constData()));
+        avformat_close_input(&formatContext);
+        return false;
+    }
+
+    // Place the segments on the video stream's timeline the way the packet
+    // pre-filter places frames on it, so that they agree with the frame indices
+    // of the analysis.
+    std::vector<timestamp_range_t> ranges;
+    {
+        const i64 startTime = ((stream->start_time == AV_NOPTS_VALUE)? 0 : stream->start_time);
+
+        for (const auto &segment: this->segments)
+        {
+            ranges.emplace_back((startTime + av_rescale_q(segment.first, av_inv_q(frameRate), stream->time_base)),
+                                (startTime + av_rescale_q(segment.second, av_inv_q(frameRate), stream->time_base)));
+        }
+    }
+
+    AVPacket *packet = av_packet_alloc();
+    k_assert((packet != nullptr), "Failed to allocate memory for exporting a video's segments.");
+
+    bool succeeded = this->align_to_keyframes(formatContext, streamIdx, packet, ranges);
+
+    if (succeeded)
+    {
+        switch (this->format)
+        {
+            case export_format_e::Edl: succeeded = this->write_edl(formatContext, streamIdx, ranges); break;
+            case export_format_e::Ffconcat: succeeded = this->write_ffconcat(formatContext, streamIdx, ranges); break;
+            case export_format_e::Highlights: succeeded = this->write_highlights(formatContext, streamIdx, packet, ranges); break;
+            default: k_assert(0, "Unknown export format."); break;
+        }
+
+        succeeded &= !this->threadShouldStop;
+
+        if (!succeeded)
+        {
+            QFile::remove(this->outFilename);
+        }
+    }
+
+    av_packet_free(&packet);
+    avformat_close_input(&formatContext);
+
+    if (succeeded)
+    {
+        this->exportProgress = 1;
+    }
+
+    return succeeded;
+}
+
+// Widens each of the given ranges of the given video stream to begin at the
+// keyframe at or before its start, and merges the ranges that then overlap.
+// Returns false if the video couldn't be seeked in, or if the export got
+// cancelled.
+//
+bool segment_exporter_c::align_to_keyframes(AVFormatContext *const formatContext, const int streamIdx,
+                                            AVPacket *const packet, std::vector<timestamp_range_t> &ranges) const
+{
+    // Only the video stream's packets tell us where the keyframes are.
+    for (uint i = 0; i < formatContext->nb_streams; i++)
+    {
+        formatContext->streams[i]->discard = ((int(i) == streamIdx)? AVDISCARD_DEFAULT : AVDISCARD_ALL);
+    }
+
+    for (auto &range: ranges)
+    {
+        if (this->threadShouldStop)
+        {
+            return false;
+        }
+
+        if (av_seek_frame(formatContext, streamIdx, range.first, AVSEEK_FLAG_BACKWARD) < 0)
+        {
+            NBENE(("Failed to seek in '%s' for exporting its segments.", this->videoFilename.toUtf8().constData()));
+            return false;
+        }
+
+        // The demuxer should land on the keyframe, but containers without an index
+        // of their keyframes may land some way before it.
+        i64 keyframeTimestamp = AV_NOPTS_VALUE;
+        while ((keyframeTimestamp == AV_NOPTS_VALUE) &&
+               (av_read_frame(formatContext, packet) >= 0))
+        {
+            if ((packet->stream_index == streamIdx) &&
+                (packet->flags & AV_PKT_FLAG_KEY) &&
+                (packet_timestamp(packet) != AV_NOPTS_VALUE))
+            {
+                keyframeTimestamp = packet_timestamp(packet);
+            }
+
+            av_packet_unref(packet);
+        }
+
+        if (keyframeTimestamp != AV_NOPTS_VALUE)
+        {
+            range.first = std::min(range.first, keyframeTimestamp);
+        }
+    }
+
+    std::vector<timestamp_range_t> mergedRanges;
+
+    for (const auto &range: ranges)
+    {
+        if (!mergedRanges.empty() &&
+            (range.first <= mergedRanges.back().second))
+        {
+            mergedRanges.back().second = std::max(mergedRanges.back().second, range.second);
+        }
+        else
+        {
+            mergedRanges.push_back(range);
+        }
+    }
+
+    ranges = mergedRanges;
+
+    return true;
+}
+
+// Writes the given ranges as an edit decision list in the format that MPlayer,
+// mpv and Kodi read: one line per stretch of the video between the ranges, giving
+// its start and end in seconds from the beginning of the video, and the action
+// (0) of skipping it.
+//
+bool segment_exporter_c::write_edl(const AVFormatContext *const formatContext, const int streamIdx,
+                                   const std::vector<timestamp_range_t> &ranges) const
+{
+    const AVStream *const stream = formatContext->streams[streamIdx];
+    const i64 startTime = ((stream->start_time == AV_NOPTS_VALUE)? 0 : stream->start_time);
+    const i64 endTime = ((formatContext->duration == AV_NOPTS_VALUE)? (ranges.empty()? startTime : ranges.back().second)
+                                                                     : (startTime + av_rescale_q(formatContext->duration, AV_TIME_BASE_Q, stream->time_base)));
+
+    QFile file(this->outFilename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+    {
+        NBENE(("Failed to open '%s' for writing the EDL into.", this->outFilename.toUtf8().constData()));
+        return false;
+    }
+
+    QTextStream edl(&file);
+
+    const auto seconds = [=](const i64 timestamp)
+    {
+        return QString::number(((timestamp - startTime) * av_q2d(stream->time_base)), 'f', 3);
+    };
+
+    i64 skipStart = startTime;
+
+    for (const auto &range: ranges)
+    {
+        if (range.first > skipStart)
+        {
+            edl << seconds(skipStart) << ' ' << seconds(range.first) << " 0\n";
+        }
+
+        skipStart = range.second;
+    }
+
+    if (endTime > skipStart)
+    {
+        edl << seconds(skipStart) << ' ' << seconds(endTime) << " 0\n";
+    }
+
+    edl.flush();
+
+    return (edl.status() == QTextStream::Ok);
+}
+
+// Writes the given ranges as a script for FFmpeg's concat demuxer, giving each
+// range's in and out points in the video. The video is referred to by its absolute
+// path, which the demuxer only accepts with "-safe 0"; e.g. "ffmpeg -f concat
+// -safe 0 -i <script> -c copy <output>" then copies the ranges out.
+//
+bool segment_exporter_c::write_ffconcat(const AVFormatContext *const formatContext, const int streamIdx,
+                                        const std::vector<timestamp_range_t> &ranges) const
+{
+    const AVStream *const stream = formatContext->streams[streamIdx];
+
+    QFile file(this->outFilename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+    {
+        NBENE(("Failed to open '%s' for writing the concat script into.", this->outFilename.toUtf8().constData()));
+        return false;
+    }
+
+    QTextStream script(&file);
+
+    // The demuxer's quoting has no escapes within quotes, so single quotes in
+    // the path get closed around and escaped.
+    QString quotedFilename = QFileInfo(this->videoFilename).absoluteFilePath();
+    quotedFilename.replace("'", "'\\''");
+    quotedFilename = QString("'%1'").arg(quotedFilename);
+
+    // The demuxer takes the in and out points as timestamps of the file, rather
+    // than as times from its beginning.
+    const auto seconds = [=](const i64 timestamp)
+    {
+        return QString::number((timestamp * av_q2d(stream->time_base)), 'f', 6);
+    };
+
+    script << "ffconcat version 1.0\n";
+
+    for (const auto &range: ranges)
+    {
+        script << "file " << quotedFilename << '\n'
+               << "inpoint " << seconds(range.first) << '\n'
+               << "outpoint " << seconds(range.second) << '\n';
+    }
+
+    script.flush();
+
+    return (script.status() == QTextStream::Ok);
+}
+
+// Copies the given ranges of the video, as they are, into a new file in the
+// container of the output's file extension. The video and audio streams get
+// copied; others, like subtitles, are left out, as they seldom survive being cut.
+//
+bool segment_exporter_c::write_highlights(AVFormatContext *const formatContext, const int streamIdx,
+                                          AVPacket *const packet, const std::vector<timestamp_range_t> &ranges)
+{
+    AVFormatContext *outContext = nullptr;
+
+    if ((avformat_alloc_output_context2(&outContext, nullptr, nullptr, this->outFilename.toUtf8().constData()) < 0) ||
+        (outContext == nullptr))
+    {
+        NBENE(("Couldn't tell what kind of container to write '%s' as.", this->outFilename.toUtf8().constData()));
+        return false;
+    }
+
+    bool succeeded = true;
+
+    // Create the output's streams; by input stream, the index of its output stream,
+    // or -1 if it's not being copied.
+    std::vector<int> outStreamIdx(formatContext->nb_streams, -1);
+    for (uint i = 0; (i < formatContext->nb_streams) && succeeded; i++)
+    {
+        AVStream *const inStream = formatContext->streams[i];
+
+        if ((inStream->codecpar->codec_type != AVMEDIA_TYPE_VIDEO) &&
+            (inStream->codecpar->codec_type != AVMEDIA_TYPE_AUDIO))
+        {
+            inStream->discard = AVDISCARD_ALL;
+            continue;
+        }
+
+        inStream->discard = AVDISCARD_DEFAULT;
+
+        AVStream *const outStream = avformat_new_stream(outContext, nullptr);
+        k_assert((outStream != nullptr), "Failed to allocate memory for exporting a video's segments.");
+
+        succeeded = (avcodec_parameters_copy(outStream->codecpar, inStream->codecpar) >= 0);
+
+        // The input container's codec tag may not be valid in the output's.
+        outStream->codecpar->codec_tag = 0;
+        outStream->time_base = inStream->time_base;
+
+        outStreamIdx[i] = outStream->index;
+    }
+
+    if (succeeded &&
+        !(outContext->oformat->flags & AVFMT_NOFILE))
+    {
+        succeeded = (avio_open(&outContext->pb, this->outFilename.toUtf8().constData(), AVIO_FLAG_WRITE) >= 0);
+    }
+
+    if (!succeeded ||
+        (avformat_write_header(outContext, nullptr) < 0))
+    {
+        NBENE(("Failed to open '%s' for writing the highlights into.", this->outFilename.toUtf8().constData()));
+        succeeded = false;
+    }
+
+    // Copy the ranges' packets over.
+    if (succeeded)
+    {
+        const AVStream *const videoStream = formatContext->streams[streamIdx];
+        const i64 slack = av_rescale_q(STREAM_INTERLEAVE_SLACK_MS, AVRational{1, 1000}, videoStream->time_base);
+
+        i64 totalLength = 0;
+        for (const auto &range: ranges)
+        {
+            totalLength += (range.second - range.first);
+        }
+
+        // How much of the output has been written so far, in the video stream's
+        // time base; the next range's packets get shifted to begin from there.
+        i64 outputLength = 0;
+
+        // By output stream, the decoding timestamp of the last packet written.
+        std::vector<i64> lastDts(outContext->nb_streams, AV_NOPTS_VALUE);
+
+        for (const auto &range: ranges)
+        {
+            if (!succeeded ||
+                this->threadShouldStop)
+            {
+                break;
+            }
+
+            if (av_seek_frame(formatContext, streamIdx, range.first, AVSEEK_FLAG_BACKWARD) < 0)
+            {
+                NBENE(("Failed to seek in '%s' for exporting its segments.", this->videoFilename.toUtf8().constData()));
+                succeeded = false;
+                break;
+            }
+
+            // The video's packets get copied from the range's keyframe on, and until
+            // they're due to be decoded past the range; the other streams' packets
+            // while presented within the range.
+            bool haveKeyframe = false;
+
+            while (succeeded &&
+                   !this->threadShouldStop &&
+                   (av_read_frame(formatContext, packet) >= 0))
+            {
+                const AVStream *const inStream = formatContext->streams[packet->stream_index];
+                const int outIdx = outStreamIdx[packet->stream_index];
+                const i64 timestamp = ((packet_timestamp(packet) == AV_NOPTS_VALUE)? AV_NOPTS_VALUE
+                                                                                   : av_rescale_q(packet_timestamp(packet), inStream->time_base, videoStream->time_base));
+
+                if ((outIdx < 0) ||
+                    (timestamp == AV_NOPTS_VALUE))
+                {
+                    av_packet_unref(packet);
+                    continue;
+                }
+
+                // Past the range by more than the streams' interleaving, there's
+                // nothing more of the range to come.
+                if (timestamp >= (range.second + slack))
+                {
+                    av_packet_unref(packet);
+                    break;
+                }
+
+                bool isInRange = false;
+
+                if (packet->stream_index == streamIdx)
+                {
+                    const i64 decodeTimestamp = ((packet->dts == AV_NOPTS_VALUE)? timestamp
+                                                                                : av_rescale_q(packet->dts, inStream->time_base, videoStream->time_base));
+
+                    haveKeyframe |= ((packet->flags & AV_PKT_FLAG_KEY) && (timestamp >= range.first));
+                    isInRange = (haveKeyframe && (decodeTimestamp < range.second));
+
+                    const i64 rangeProgress = std::max(i64(0), std::min((range.second - range.first), (timestamp - range.first)));
+                    this->exportProgress = ((totalLength > 0)? (real(outputLength + rangeProgress) / totalLength) : 0);
+                }
+                else
+                {
+                    isInRange = ((timestamp >= range.first) && (timestamp < range.second));
+                }
+
+                if (!isInRange)
+                {
+                    av_packet_unref(packet);
+                    continue;
+                }
+
+                AVStream *const outStream = outContext->streams[outIdx];
+
+                // Shift the packet to follow on from the ranges written before.
+                {
+                    const i64 shift = av_rescale_q((range.first - outputLength), videoStream->time_base, inStream->time_base);
+
+                    if (packet->pts != AV_NOPTS_VALUE) packet->pts -= shift;
+                    if (packet->dts != AV_NOPTS_VALUE) packet->dts -= shift;
+
+                    av_packet_rescale_ts(packet, inStream->time_base, outStream->time_base);
+                }
+
+                // A range's first packets may be due to be decoded a little ahead of
+                // their presentation, i.e. before the end of the range written before,
+                // but the muxer needs the decoding timestamps to keep rising.
+                if ((packet->dts != AV_NOPTS_VALUE) &&
+                    (lastDts[outIdx] != AV_NOPTS_VALUE) &&
+                    (packet->dts <= lastDts[outIdx]))
+                {
+                    packet->dts = (lastDts[outIdx] + 1);
+
+                    if (packet->pts != AV_NOPTS_VALUE)
+                    {
+                        packet->pts = std::max(packet->pts, packet->dts);
+                    }
+                }
+
+                if (packet->dts != AV_NOPTS_VALUE)
+                {
+                    lastDts[outIdx] = packet->dts;
+                }
+
+                packet->stream_index = outIdx;
+                packet->pos = -1;
+
+                // Takes over the packet's data, leaving it blank.
+                if (av_interleaved_write_frame(outContext, packet) < 0)
+                {
+                    NBENE(("Failed to write into '%s'.", this->outFilename.toUtf8().constData()));
+                    succeeded = false;
+                }
+            }
+
+            outputLength += (range.second - range.first);
+        }
+
+        succeeded &= !this->threadShouldStop;
+        succeeded &= (av_write_trailer(outContext) >= 0);
+    }
+
+    if (!(outContext->oformat->flags & AVFMT_NOFILE))
+    {
+        avio_closep(&outContext->pb);
+    }
+
+    avformat_free_context(outContext);
+
+    return succeeded;
+}
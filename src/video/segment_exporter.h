@@ -0,0 +1,96 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors
+ *
+ */
+
+#ifndef SEGMENT_EXPORTER_H
+#define SEGMENT_EXPORTER_H
+
+#include <QObject>
+#include <QFuture>
+#include <QString>
+#include <atomic>
+#include <utility>
+#include <vector>
+#include "../../src/types.h"
+
+struct AVFormatContext;
+struct AVPacket;
+
+// Exports a video's segments of activity, on a thread of its own, signalling when
+// done: either as a list of cuts for other tools to act on, or as a file holding
+// just the segments. The segments get widened to start on the keyframe at or
+// before them, so that they can be copied out of the video as they are, without
+// re-encoding; the lists are widened alike, so all of the forms agree.
+//
+class segment_exporter_c : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum class export_format_e
+    {
+        Edl,        // An MPlayer/mpv/Kodi edit decision list, skipping the stretches between the segments.
+        Ffconcat,   // An FFmpeg concat demuxer script, listing the segments as in and out points of the video.
+        Highlights, // A copy of the video, in the container of the output's file extension, holding only the segments.
+    };
+
+    segment_exporter_c(const QString &videoFilename, const std::vector<std::pair<uint, uint>> &segments,
+                       const QString &outFilename, const export_format_e format, QObject *parent = nullptr);
+    ~segment_exporter_c(void);
+
+    void start(void);
+
+    bool run(void);
+
+    void cancel(void);
+
+    real progress(void) const;
+
+    const QString& out_file_name(void) const;
+
+    static QString default_out_file_name(const QString &videoFilename, const export_format_e format);
+
+signals:
+    // Emitted from the exporting thread once the export has finished, unless it
+    // was cancelled. If it didn't succeed, no output file is left behind.
+    void finished(const QString outFilename, const bool succeeded);
+
+private:
+    // A stretch of the video to export, as [start, end) timestamps in the video
+    // stream's time base.
+    typedef std::pair<i64, i64> timestamp_range_t;
+
+    bool align_to_keyframes(AVFormatContext *const formatContext, const int streamIdx,
+                            AVPacket *const packet, std::vector<timestamp_range_t> &ranges) const;
+
+    bool write_edl(const AVFormatContext *const formatContext, const int streamIdx,
+                   const std::vector<timestamp_range_t> &ranges) const;
+
+    bool write_ffconcat(const AVFormatContext *const formatContext, const int streamIdx,
+                        const std::vector<timestamp_range_t> &ranges) const;
+
+    bool write_highlights(AVFormatContext *const formatContext, const int streamIdx,
+                          AVPacket *const packet, const std::vector<timestamp_range_t> &ranges);
+
+    // For threading the export.
+    QFuture<void> exportThread;
+
+    bool hasStarted = false;
+
+    // Set to true to signal to the exporting thread to give up.
+    std::atomic<bool> threadShouldStop;
+
+    // How far along the export is, from 0 to 1.
+    std::atomic<real> exportProgress;
+
+    // The segments to export, as [start, end) frame indices in ascending order.
+    const std::vector<std::pair<uint, uint>> segments;
+
+    const QString videoFilename;
+    const QString outFilename;
+    const export_format_e format;
+};
+
+#endif
@@ -0,0 +1,354 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors
+ *
+ * Streaming analysis of sources that don't have a known length yet: video files
+ * that are still being recorded into, and network camera feeds.
+ *
+ * Each frame is compared, as downscaled luma, against the one before it, and the
+ * outcomes of the most recent comparisons are kept in a rolling window. An event
+ * of activity starts once enough of the comparisons in the window have found
+ * differences, and ends once no differences have been found for a while. Both
+ * are signalled as soon as they're known, so the latency of an alert is bounded
+ * by the window's length and the hold time, rather than by the length of the
+ * recording.
+ *
+ * The frames' activity also goes in a timeline that gets extended frame by frame,
+ * and whose writes are committed often enough for the GUI (or whoever else) to
+ * follow along live.
+ *
+ * For growing files, reaching the end of the data means waiting for the file to
+ * grow, then reopening it and picking up from the frame we were at. The container
+ * must be one that's readable while incomplete, like MPEG-TS or Matroska; an MP4
+ * recording, for one, can't be read until its index gets written at the end.
+ *
+ */
+
+#include <QtConcurrent/QtConcurrent>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QThread>
+#include <QUrl>
+#include <algorithm>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include "../../src/video/stream_activity.h"
+#include "../../src/messager/message_sink.h"
+#include "../../src/video/motion_detector.h"
+
+// How often, in frames, to commit the buffered frame activity to the timeline. At
+// common frame rates, this keeps the timeline less than a second behind.
+static const uint TIMELINE_COMMIT_INTERVAL = 16;
+
+stream_activity_c::stream_activity_c(const QString &source, const message_sink_c *const messager,
+                                     const stream_activity_settings_s &settings) :
+    source(source),
+    isNetworkSource(is_network_source(source)),
+    settings(settings)
+{
+    connect(    this, &stream_activity_c::message_to_user,
+            messager, &message_sink_c::new_message);
+
+    this->frameIsActive.reset(0, activity_timeline_c::activity_type_e::Uninitialized, this->settings.timelineCapacity);
+
+    threadShouldStop = false;
+    hasFinished = false;
+
+    this->analysisThread = QtConcurrent::run([this]
+    {
+        this->analyze();
+        this->hasFinished = true;
+
+        emit analysis_finished();
+    });
+
+    return;
+}
+
+stream_activity_c::~stream_activity_c()
+{
+    this->stop();
+    this->analysisThread.waitForFinished();
+
+    return;
+}
+
+// Asks the analysis to stop. It does so asynchronously, signalling
+// analysis_finished() once it has.
+//
+void stream_activity_c::stop()
+{
+    this->threadShouldStop = true;
+
+    return;
+}
+
+bool stream_activity_c::has_finished() const
+{
+    return this->hasFinished;
+}
+
+const activity_timeline_c& stream_activity_c::frame_activity() const
+{
+    return this->frameIsActive;
+}
+
+// Returns true if the given source is a network address (e.g. rtsp://... or
+// http://...) rather than a local file.
+//
+bool stream_activity_c::is_network_source(const QString &source)
+{
+    const QString scheme = QUrl(source).scheme().toLower();
+
+    // Single-letter schemes are Windows drive letters.
+    return ((scheme.length() > 1) &&
+            (scheme != "file"));
+}
+
+void stream_activity_c::analyze(void)
+{
+    typedef activity_timeline_c::activity_type_e activity_type_e;
+
+    cv::VideoCapture stream;
+    if (!this->open_source(stream, 0))
+    {
+        emit message_to_user("Could not open \"" + this->source + "\" for streaming analysis.");
+        return;
+    }
+
+    INFO(("Streaming activity from '%s'.", this->source.toUtf8().constData()));
+
+    const uint windowLength = std::max(1u, std::min(64u, this->settings.windowLength));
+    const u64 windowMask = ((windowLength == 64)? ~u64(0) : ((u64(1) << windowLength) - 1));
+
+    // The results of the most recent frame comparisons; bit n is set if the frame
+    // n frames back differed from its predecessor.
+    u64 recentDiffs = 0;
+
+    bool isInEvent = false;
+    uint lastDiffFrameIdx = 0;
+    bool timelineIsFull = false;
+
+    // The earliest frame the next event can be dated from: the one after the
+    // previous event ended.
+    uint nextEventMinStartFrameIdx = 0;
+
+    activity_timeline_writer_c frameActivity(this->frameIsActive);
+    cv::Mat thisFrame, prevFrame, decodeBuffer, scaleBuffer;
+    frame_difference_detector_c detector(this->settings.pixelDiffThreshold, this->settings.maskRegions);
+
+    uint frameIdx = 0;
+    for (; this->read_frame(stream, thisFrame, decodeBuffer, scaleBuffer, frameIdx); frameIdx++)
+    {
+        const bool differs = ((frameIdx > 0) && detector.is_active(thisFrame, prevFrame));
+        bool eventChanged = false;
+        uint eventStartFrameIdx = frameIdx;
+
+        recentDiffs = (((recentDiffs << 1) | u64(differs)) & windowMask);
+
+        if (differs)
+        {
+            lastDiffFrameIdx = frameIdx;
+        }
+
+        if (!isInEvent &&
+            (uint(__builtin_popcountll(recentDiffs)) >= std::max(1u, this->settings.minActiveFrames)))
+        {
+            // Date the event from the earliest difference still in the window.
+            eventStartFrameIdx = std::max(nextEventMinStartFrameIdx, (frameIdx - (63 - __builtin_clzll(recentDiffs))));
+            isInEvent = true;
+            eventChanged = true;
+
+            emit activity_started(eventStartFrameIdx, QDateTime::currentDateTime());
+        }
+        else if (isInEvent &&
+                 ((frameIdx - lastDiffFrameIdx) >= this->settings.holdFrames))
+        {
+            isInEvent = false;
+            eventChanged = true;
+
+            // Let the next event be judged only by the differences that come after
+            // this one - otherwise, with holdFrames < windowLength, the ones still
+            // in the window would restart it on the very next frame.
+            recentDiffs = 0;
+            nextEventMinStartFrameIdx = (frameIdx + 1);
+
+            emit activity_ended(frameIdx, QDateTime::currentDateTime());
+        }
+
+        // Record the frame in the timeline, while there's room.
+        if (frameIdx < this->frameIsActive.capacity())
+        {
+            this->frameIsActive.extend(frameIdx + 1);
+
+            frameActivity.set_range(eventStartFrameIdx, (frameIdx + 1),
+                                    (isInEvent? activity_type_e::Active : activity_type_e::Inactive));
+
+            if (eventChanged ||
+                ((frameIdx % TIMELINE_COMMIT_INTERVAL) == 0))
+            {
+                frameActivity.flush();
+            }
+        }
+        else if (!timelineIsFull)
+        {
+            timelineIsFull = true;
+            frameActivity.flush();
+
+            emit message_to_user("The stream's activity timeline is full. Activity will still be reported, "
+                                 "but no longer recorded.");
+        }
+
+        // The previous frame's buffer gets recycled to receive the new frame.
+        cv::swap(prevFrame, thisFrame);
+    }
+
+    if (isInEvent)
+    {
+        emit activity_ended(frameIdx, QDateTime::currentDateTime());
+    }
+
+    return;
+}
+
+// Opens the source for reading. For a file, reading resumes from the frame at
+// the given index.
+//
+bool stream_activity_c::open_source(cv::VideoCapture &stream, const uint resumeFrameIdx)
+{
+    if (!this->isNetworkSource)
+    {
+        this->lastKnownFileSize = QFileInfo(this->source).size();
+    }
+
+    if (!stream.open(this->source.toStdString()))
+    {
+        return false;
+    }
+
+    if (!this->isNetworkSource &&
+        (resumeFrameIdx > 0))
+    {
+        stream.set(CV_CAP_PROP_POS_FRAMES, resumeFrameIdx);
+    }
+
+    return true;
+}
+
+// Reads the source's next frame, as downscaled luma, into the given matrix. The
+// frame is decoded into decodeBuffer and downscaled into scaleBuffer along the
+// way. On reaching the end of a growing file, waits for the file to grow and
+// resumes reading it from the given frame; on losing a network stream, tries to
+// reconnect. Returns false once the source has ended for good, or the analysis
+// has been asked to stop.
+//
+bool stream_activity_c::read_frame(cv::VideoCapture &stream, cv::Mat &frame, cv::Mat &decodeBuffer, cv::Mat &scaleBuffer,
+                                   const uint frameIdx)
+{
+    uint numReconnects = 0;
+
+    while (!this->threadShouldStop)
+    {
+        if (stream.isOpened() &&
+            stream.read(decodeBuffer) &&
+            !decodeBuffer.empty())
+        {
+            const cv::Size proxySize(this->settings.proxyWidth, this->settings.proxyHeight);
+
+            switch (decodeBuffer.channels())
+            {
+                case 1:
+                {
+                    cv::resize(decodeBuffer, frame, proxySize, 0, 0, cv::INTER_AREA);
+                    break;
+                }
+                case 3:
+                {
+                    cv::resize(decodeBuffer, scaleBuffer, proxySize, 0, 0, cv::INTER_AREA);
+                    cv::cvtColor(scaleBuffer, frame, cv::COLOR_BGR2GRAY);
+                    break;
+                }
+                default: k_assert(0, "Encountered a frame with an unsupported pixel format."); break;
+            }
+
+            return true;
+        }
+
+        if (this->isNetworkSource)
+        {
+            if (numReconnects >= this->settings.maxReconnects)
+            {
+                emit message_to_user("Lost the stream \"" + this->source + "\".");
+                return false;
+            }
+
+            numReconnects++;
+            INFO(("Lost the stream; reconnecting (attempt %u of %u).", numReconnects, this->settings.maxReconnects));
+
+            if (!this->sleep_unless_stopped(this->settings.pollIntervalMs * numReconnects))
+            {
+                return false;
+            }
+        }
+        else if (!this->wait_for_more_data())
+        {
+            return false;
+        }
+
+        stream.release();
+        this->open_source(stream, frameIdx);
+    }
+
+    return false;
+}
+
+// Waits for the (growing) source file to become larger than it was when last
+// seen. Returns false if it doesn't within the idle timeout, in which case the
+// recording is taken to have finished; or if the analysis is asked to stop.
+//
+bool stream_activity_c::wait_for_more_data(void)
+{
+    QElapsedTimer idleTimer;
+    idleTimer.start();
+
+    while (idleTimer.elapsed() < qint64(this->settings.idleTimeoutMs))
+    {
+        const qint64 fileSize = QFileInfo(this->source).size();
+
+        if (fileSize > this->lastKnownFileSize)
+        {
+            this->lastKnownFileSize = fileSize;
+            return true;
+        }
+
+        if (!this->sleep_unless_stopped(this->settings.pollIntervalMs))
+        {
+            return false;
+        }
+    }
+
+    return false;
+}
+
+// Sleeps for the given time, waking up early if the analysis is asked to stop.
+// Returns false in that case.
+//
+bool stream_activity_c::sleep_unless_stopped(const uint milliseconds) const
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    while (!this->threadShouldStop)
+    {
+        const qint64 timeLeft = (qint64(milliseconds) - timer.elapsed());
+
+        if (timeLeft <= 0)
+        {
+            break;
+        }
+
+        QThread::msleep(std::min<qint64>(50, timeLeft));
+    }
+
+    return !this->threadShouldStop;
+}
@@ -0,0 +1,137 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors
+ *
+ */
+
+#ifndef STREAM_ACTIVITY_H
+#define STREAM_ACTIVITY_H
+
+#include <QDateTime>
+#include <QFuture>
+#include <QObject>
+#include <QString>
+#include <atomic>
+#include "../../src/video/activity_timeline.h"
+#include "../../src/video/activity_mask.h"
+#include "../../src/common.h"
+
+class message_sink_c;
+
+namespace cv
+{
+    class Mat;
+    class VideoCapture;
+}
+
+// User-adjustable parameters that control how stream_activity_c goes about
+// finding activity in a live source.
+struct stream_activity_settings_s
+{
+    // The resolution to which frames are downscaled, as luma, for comparison.
+    uint proxyWidth = 160;
+    uint proxyHeight = 90;
+
+    // The luma difference between two pixels needed for them to count as
+    // differing. The same as by default in video_activity_c's analysis.
+    u8 pixelDiffThreshold = 30;
+
+    // The regions of the frame in which to look for activity, or not to; see
+    // activity_mask_c. With none, all of the frame gets looked at.
+    QVector<activity_mask_region_s> maskRegions;
+
+    // A frame counts as showing activity once at least this many of the last
+    // windowLength frames have differed notably from their predecessor. Requiring
+    // more than one keeps isolated glitches (e.g. a dropped packet's artifacts)
+    // from raising events, at the cost of up to windowLength frames of latency.
+    uint windowLength = 5;
+    uint minActiveFrames = 2;
+
+    // How many consecutive frames without differences it takes for an event of
+    // activity to end.
+    uint holdFrames = 90;
+
+    // The most frames' worth of activity to keep a record of in the timeline. Past
+    // this, events still get raised, but no longer recorded. The default holds a
+    // day of 30 FPS video, taking up about 1.3 MB.
+    uint timelineCapacity = (24 * 60 * 60 * 30);
+
+    // For files that are still being written: how often to check for more data on
+    // reaching the current end, and how long to wait for more before taking the
+    // recording to have finished.
+    uint pollIntervalMs = 500;
+    uint idleTimeoutMs = 10000;
+
+    // For network streams: how many times in a row to try reconnecting after the
+    // stream drops, before giving up.
+    uint maxReconnects = 5;
+};
+
+// Finds visual activity in a source that's still being written or broadcast - a
+// growing video file, or an RTSP/HTTP camera feed - as the frames come in. Unlike
+// video_activity_c, which needs to know the video's length up front, this grows
+// its timeline as it goes, and signals the starts and ends of activity within a
+// bounded number of frames of their happening.
+class stream_activity_c : public QObject
+{
+    Q_OBJECT
+
+public:
+    stream_activity_c(const QString &source, const message_sink_c *const messager,
+                      const stream_activity_settings_s &settings = stream_activity_settings_s());
+    ~stream_activity_c(void);
+
+    void stop(void);
+
+    bool has_finished(void) const;
+
+    const activity_timeline_c& frame_activity(void) const;
+
+    static bool is_network_source(const QString &source);
+
+signals:
+    // Emitted from the analysis thread. The frame indices count frames since the
+    // analysis began.
+    void activity_started(const uint frameIdx, const QDateTime detectedAt);
+    void activity_ended(const uint frameIdx, const QDateTime detectedAt);
+
+    // Emitted from the analysis thread once the source has ended or been lost,
+    // or the analysis has been stopped.
+    void analysis_finished(void);
+
+    void message_to_user(const QString message);
+
+private:
+    void analyze(void);
+
+    bool open_source(cv::VideoCapture &stream, const uint resumeFrameIdx);
+
+    bool read_frame(cv::VideoCapture &stream, cv::Mat &frame, cv::Mat &decodeBuffer, cv::Mat &scaleBuffer,
+                    const uint frameIdx);
+
+    bool wait_for_more_data(void);
+
+    bool sleep_unless_stopped(const uint milliseconds) const;
+
+    // For each frame read so far, whether it's part of an event of activity.
+    activity_timeline_c frameIsActive;
+
+    // For threading the analysis.
+    QFuture<void> analysisThread;
+
+    // Set to true to signal to the analysis thread to quit its stuff.
+    std::atomic<bool> threadShouldStop;
+
+    std::atomic<bool> hasFinished;
+
+    // For growing files, the file's size as of when we last reached its end.
+    qint64 lastKnownFileSize = -1;
+
+    const QString source;
+
+    const bool isNetworkSource;
+
+    const stream_activity_settings_s settings;
+};
+
+#endif
@@ -0,0 +1,280 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors
+ *
+ * A sheet of thumbnails of a video's frames, filled in by the activity analysis
+ * as it decodes the frames, so that the GUI can preview any part of the video by
+ * looking up a thumbnail rather than by seeking the video.
+ *
+ * To keep the sheet's size in check on long videos, each thumbnail stands for a
+ * stretch of frames - at least a second's worth, and more for videos long enough
+ * that there'd otherwise be more than MAX_NUM_THUMBNAILS of them. Stretches whose
+ * frames the analysis never decodes (e.g. ones skipped by the packet pre-filter,
+ * which are static anyway) are left without a thumbnail, and previewed by the
+ * nearest thumbnail before them.
+ *
+ * In the activity cache, the sheet is stored as a JPEG.
+ *
+ */
+
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <QDataStream>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "../../src/video/thumbnail_sheet.h"
+#include "../../src/common.h"
+
+// The most thumbnails a video gets; and the height of each, in pixels, with their
+// width following from the video's aspect ratio, up to a limit.
+static const uint MAX_NUM_THUMBNAILS = 512;
+static const uint THUMBNAIL_HEIGHT = 64;
+static const uint MAX_THUMBNAIL_WIDTH = (THUMBNAIL_HEIGHT * 4);
+
+// How many thumbnails there are in each row of the sheet.
+static const uint SHEET_NUM_COLUMNS = 16;
+
+// The quality, from 0 to 100, with which the sheet is stored.
+static const int JPEG_QUALITY = 85;
+
+// Bump this whenever the encoded sheet's layout changes.
+static const quint32 ENCODING_VERSION = 1;
+
+thumbnail_sheet_c::thumbnail_sheet_c(void)
+{
+    return;
+}
+
+thumbnail_sheet_c::~thumbnail_sheet_c(void)
+{
+    return;
+}
+
+// Sets the sheet up with room for thumbnails of a video of the given length, frame
+// rate and resolution, all of them empty. Not to be called while the sheet is
+// being filled in or read from.
+//
+void thumbnail_sheet_c::reset(const uint numFrames, const real frameRate, const uint frameWidth, const uint frameHeight)
+{
+    const uint minSlotLength = std::max(1u, uint(std::ceil(frameRate)));
+    const uint slotLength = std::max(minSlotLength, ((numFrames + MAX_NUM_THUMBNAILS - 1) / MAX_NUM_THUMBNAILS));
+    const real aspectRatio = ((frameHeight > 0)? (frameWidth / real(frameHeight)) : (16 / 9.0));
+    const uint thumbnailWidth = std::max(1u, std::min(MAX_THUMBNAIL_WIDTH, uint(std::round(THUMBNAIL_HEIGHT * aspectRatio))));
+
+    this->allocate(numFrames, slotLength, thumbnailWidth, THUMBNAIL_HEIGHT);
+
+    return;
+}
+
+void thumbnail_sheet_c::allocate(const uint numFrames, const uint slotLength, const uint thumbnailWidth, const uint thumbnailHeight)
+{
+    this->numFrames = numFrames;
+    this->slotLength = std::max(1u, slotLength);
+    this->numSlots = ((numFrames + this->slotLength - 1) / this->slotLength);
+    this->thumbnailWidth = thumbnailWidth;
+    this->thumbnailHeight = thumbnailHeight;
+
+    this->slotStates.reset(new std::atomic<u8>[this->numSlots]);
+    for (uint i = 0; i < this->numSlots; i++)
+    {
+        this->slotStates[i] = u8(slot_state_e::Empty);
+    }
+
+    if (this->numSlots > 0)
+    {
+        const uint numRows = ((this->numSlots + SHEET_NUM_COLUMNS - 1) / SHEET_NUM_COLUMNS);
+        const uint numColumns = std::min(this->numSlots, SHEET_NUM_COLUMNS);
+
+        this->sheet = cv::Mat::zeros((numRows * thumbnailHeight), (numColumns * thumbnailWidth), CV_8UC3);
+    }
+    else
+    {
+        this->sheet.release();
+    }
+
+    return;
+}
+
+// Returns the area of the sheet that holds the given thumbnail.
+//
+cv::Rect thumbnail_sheet_c::slot_rect(const uint slotIdx) const
+{
+    return cv::Rect(((slotIdx % SHEET_NUM_COLUMNS) * this->thumbnailWidth),
+                    ((slotIdx / SHEET_NUM_COLUMNS) * this->thumbnailHeight),
+                    this->thumbnailWidth,
+                    this->thumbnailHeight);
+}
+
+// Returns true if the given frame would make a thumbnail, i.e. if no thumbnail
+// has yet been made of the stretch of frames it's in. Cheap enough to be asked of
+// every frame.
+//
+bool thumbnail_sheet_c::wants_frame(const uint frameIdx) const
+{
+    return ((frameIdx < this->numFrames) &&
+            (this->slotStates[frameIdx / this->slotLength].load(std::memory_order_relaxed) == u8(slot_state_e::Empty)));
+}
+
+// Makes a thumbnail of the given frame - in BGR color, or grayscale - if one is
+// wanted of it (see wants_frame()).
+//
+void thumbnail_sheet_c::add_frame(const uint frameIdx, const cv::Mat &frame)
+{
+    if (!this->wants_frame(frameIdx) ||
+        (frame.depth() != CV_8U) ||
+        ((frame.channels() != 1) && (frame.channels() != 3)))
+    {
+        return;
+    }
+
+    // Another thread may be after the same thumbnail, e.g. where the segments of
+    // a segmented analysis meet.
+    const uint slotIdx = (frameIdx / this->slotLength);
+    u8 expectedState = u8(slot_state_e::Empty);
+    if (!this->slotStates[slotIdx].compare_exchange_strong(expectedState, u8(slot_state_e::Filling)))
+    {
+        return;
+    }
+
+    cv::Mat scaledFrame;
+    cv::resize(frame, scaledFrame, cv::Size(this->thumbnailWidth, this->thumbnailHeight), 0, 0, cv::INTER_AREA);
+
+    cv::Mat thumbnail = this->sheet(this->slot_rect(slotIdx));
+    cv::cvtColor(scaledFrame, thumbnail, ((frame.channels() == 1)? cv::COLOR_GRAY2RGB : cv::COLOR_BGR2RGB));
+
+    this->slotStates[slotIdx].store(u8(slot_state_e::Ready), std::memory_order_release);
+
+    return;
+}
+
+// Points the given matrix at the thumbnail that stands for the given frame, in
+// RGB color; or, if there's none yet, at the nearest thumbnail before it, or
+// failing that, after it. The thumbnail's pixels stay valid until the sheet is
+// next reset or decoded into. Returns false if there are no thumbnails to go by.
+//
+bool thumbnail_sheet_c::thumbnail(const uint frameIdx, cv::Mat &thumbnail) const
+{
+    if (this->numSlots == 0)
+    {
+        return false;
+    }
+
+    const uint targetSlotIdx = (std::min(frameIdx, (this->numFrames - 1)) / this->slotLength);
+
+    const auto slot_is_ready = [this](const uint slotIdx)
+    {
+        return (this->slotStates[slotIdx].load(std::memory_order_acquire) == u8(slot_state_e::Ready));
+    };
+
+    for (uint i = 0; i <= targetSlotIdx; i++)
+    {
+        if (slot_is_ready(targetSlotIdx - i))
+        {
+            thumbnail = this->sheet(this->slot_rect(targetSlotIdx - i));
+            return true;
+        }
+    }
+
+    for (uint i = (targetSlotIdx + 1); i < this->numSlots; i++)
+    {
+        if (slot_is_ready(i))
+        {
+            thumbnail = this->sheet(this->slot_rect(i));
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Returns the sheet's thumbnails packed into a byte array, for storing; or an empty
+// array if there are none. Not to be called while the sheet is being filled in.
+//
+QByteArray thumbnail_sheet_c::encoded(void) const
+{
+    QByteArray readyStates(this->numSlots, 0);
+    bool haveThumbnails = false;
+
+    for (uint i = 0; i < this->numSlots; i++)
+    {
+        readyStates[i] = char(this->slotStates[i] == u8(slot_state_e::Ready));
+        haveThumbnails |= bool(readyStates[i]);
+    }
+
+    if (!haveThumbnails)
+    {
+        return QByteArray();
+    }
+
+    // The image codecs expect BGR color.
+    std::vector<uchar> jpeg;
+    {
+        cv::Mat bgrSheet;
+        cv::cvtColor(this->sheet, bgrSheet, cv::COLOR_RGB2BGR);
+
+        if (!cv::imencode(".jpg", bgrSheet, jpeg, std::vector<int>{cv::IMWRITE_JPEG_QUALITY, JPEG_QUALITY}))
+        {
+            NBENE(("Failed to encode the video's thumbnails."));
+            return QByteArray();
+        }
+    }
+
+    QByteArray packed;
+    QDataStream stream(&packed, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_5);
+
+    stream << ENCODING_VERSION
+           << quint32(this->numFrames)
+           << quint32(this->slotLength)
+           << quint32(this->thumbnailWidth)
+           << quint32(this->thumbnailHeight)
+           << readyStates
+           << QByteArray((const char*)jpeg.data(), int(jpeg.size()));
+
+    return packed;
+}
+
+// Replaces the sheet's thumbnails with those packed by encoded() into the given
+// byte array, which are to be of a video of the given length. Returns false, and
+// leaves the sheet as it was, if the thumbnails couldn't be unpacked.
+//
+bool thumbnail_sheet_c::decode(const QByteArray &encoded, const uint numFrames)
+{
+    QDataStream stream(encoded);
+    stream.setVersion(QDataStream::Qt_5_5);
+
+    quint32 version = 0, encodedNumFrames = 0, slotLength = 0, thumbnailWidth = 0, thumbnailHeight = 0;
+    QByteArray readyStates, jpeg;
+    stream >> version >> encodedNumFrames >> slotLength >> thumbnailWidth >> thumbnailHeight >> readyStates >> jpeg;
+
+    if ((stream.status() != QDataStream::Ok) ||
+        (version != ENCODING_VERSION) ||
+        (encodedNumFrames != numFrames) ||
+        (slotLength == 0) ||
+        (uint(readyStates.size()) != ((numFrames + slotLength - 1) / slotLength)))
+    {
+        return false;
+    }
+
+    cv::Mat bgrSheet = cv::imdecode(std::vector<uchar>(jpeg.begin(), jpeg.end()), cv::IMREAD_COLOR);
+
+    const uint numSlots = uint(readyStates.size());
+    if (bgrSheet.empty() ||
+        (uint(bgrSheet.rows) != (((numSlots + SHEET_NUM_COLUMNS - 1) / SHEET_NUM_COLUMNS) * thumbnailHeight)) ||
+        (uint(bgrSheet.cols) != (std::min(numSlots, SHEET_NUM_COLUMNS) * thumbnailWidth)))
+    {
+        return false;
+    }
+
+    this->allocate(numFrames, slotLength, thumbnailWidth, thumbnailHeight);
+
+    cv::cvtColor(bgrSheet, this->sheet, cv::COLOR_BGR2RGB);
+
+    for (uint i = 0; i < this->numSlots; i++)
+    {
+        this->slotStates[i] = u8(readyStates.at(i)? slot_state_e::Ready : slot_state_e::Empty);
+    }
+
+    return true;
+}
@@ -0,0 +1,74 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors
+ *
+ */
+
+#ifndef THUMBNAIL_SHEET_H
+#define THUMBNAIL_SHEET_H
+
+#include <opencv2/core/core.hpp>
+#include <QByteArray>
+#include <atomic>
+#include <memory>
+#include "../../src/types.h"
+
+// Small thumbnails of a video's frames, one for each stretch of so many frames,
+// laid out in a grid on a single image (a sprite sheet), for previewing parts of
+// the video without having to seek in it. The thumbnails get filled in by the
+// analysis from the frames it decodes anyway: each stretch's thumbnail is of the
+// first of its frames to be decoded. They can be filled in from several threads
+// at once, and read while being filled in.
+//
+class thumbnail_sheet_c
+{
+public:
+    thumbnail_sheet_c(void);
+    ~thumbnail_sheet_c(void);
+
+    thumbnail_sheet_c(const thumbnail_sheet_c&) = delete;
+    thumbnail_sheet_c& operator=(const thumbnail_sheet_c&) = delete;
+
+    void reset(const uint numFrames, const real frameRate, const uint frameWidth, const uint frameHeight);
+
+    bool wants_frame(const uint frameIdx) const;
+
+    void add_frame(const uint frameIdx, const cv::Mat &frame);
+
+    bool thumbnail(const uint frameIdx, cv::Mat &thumbnail) const;
+
+    QByteArray encoded(void) const;
+
+    bool decode(const QByteArray &encoded, const uint numFrames);
+
+private:
+    // The states that each thumbnail goes through.
+    enum class slot_state_e : u8
+    {
+        Empty,
+        Filling,
+        Ready,
+    };
+
+    cv::Rect slot_rect(const uint slotIdx) const;
+
+    void allocate(const uint numFrames, const uint slotLength, const uint thumbnailWidth, const uint thumbnailHeight);
+
+    // The thumbnails, in rows of RGB pixels, left to right and top to bottom.
+    cv::Mat sheet;
+
+    // For each thumbnail, its slot_state_e.
+    std::unique_ptr<std::atomic<u8>[]> slotStates;
+
+    uint numFrames = 0;
+    uint numSlots = 0;
+
+    // How many frames each thumbnail stands for.
+    uint slotLength = 1;
+
+    // The size of each thumbnail, in pixels.
+    uint thumbnailWidth = 0;
+    uint thumbnailHeight = 0;
+};
+
+#endif
@@ -13,15 +13,30 @@
 
 #include <QtConcurrent/QtConcurrent>
 #include <QFutureWatcher>
+#include <QThreadPool>
+#include <QSemaphore>
+#include <QRunnable>
+#include <QDataStream>
 #include <QFuture>
 #include <QDebug>
+#include <functional>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <deque>
+#include <cmath>
 
-#include <opencv2/highgui/highgui.hpp>
-#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/core/core.hpp>
 
 #include "../../src/video/video_activity.h"
-#include "../../src/messager/messager.h"
+#include "../../src/video/analysis_stats.h"
+#include "../../src/video/activity_cache.h"
+#include "../../src/video/video_decoder.h"
+#include "../../src/video/packet_prefilter.h"
+#include "../../src/video/motion_detector.h"
+#include "../../src/messager/message_sink.h"
 #include "../../src/video/video_info.h"
+#include "../../src/audio/audio_decoder.h"
 #include "../../src/audio/audio_file.h"
 #include "../../src/common.h"
 
@@ -32,297 +47,1953 @@
 /// wide for when only brief activity occurs.
 static const uint TIME_GRANULARITY_DIVISOR = 50;
 
-video_activity_c::video_activity_c(const video_info_c &sourceVideo, const messager_c *const messager) :
+// In segmented video analysis, the smallest number of frames we'll give to a
+// segment. Each segment begins with a seek, which on most codecs means decoding
+// forward from the preceding keyframe; so segments should be long enough for
+// that overhead to be negligible.
+static const uint MIN_VIDEO_SEGMENT_LENGTH = 3000;
+
+// In segmented video analysis on a thread pool shared with other videos, how many
+// segments to make for each of the pool's threads. A segment can't be paused once
+// begun, so the pool only gets to put a video that's been given priority ahead of
+// the others as segments finish; shorter segments let it do so sooner.
+static const uint NUM_SHARED_POOL_SEGMENTS_PER_THREAD = 4;
+
+// The largest share of the video that the packet pre-filter may leave to be
+// decoded for it to be worth using. Beyond that, the seeks between the stretches
+// to decode eat up much of the savings, and a plain pass is simpler.
+static const real MAX_PREFILTER_COVERAGE = 0.5;
+
+// An analysis' work waiting for its turn on a thread pool. QThreadPool runs work
+// in the order of its priority, but fixes each piece's priority as it's queued;
+// so rather than the work itself, the analysis queues runners on the pool, each
+// of which, on its turn, runs whichever piece of the work is next. When the
+// analysis' priority changes, a fresh runner gets queued at the new priority for
+// each piece still waiting, and the runners queued before end, on their turn,
+// without running anything.
+//
+// A piece of work returns true once done; or false to give up its thread part way
+// through, such that it gets queued again, at the current priority, to carry on.
+//
+struct pooled_work_queue_s
+{
+    QThreadPool *pool = nullptr;
+
+    std::atomic<int> priority{0};
+
+    std::deque<std::function<bool(void)>> tasks;
+    std::mutex mutex;
+};
+
+class pooled_task_runner_c : public QRunnable
+{
+public:
+    pooled_task_runner_c(const std::shared_ptr<pooled_work_queue_s> &queue, const int priority) :
+        queue(queue),
+        priority(priority)
+    {
+        return;
+    }
+
+    // Queues a runner on the given work queue's pool at the queue's current
+    // priority. The queue's mutex is to be held by the caller.
+    //
+    static void queue_runner(const std::shared_ptr<pooled_work_queue_s> &queue)
+    {
+        const int priority = queue->priority;
+
+        queue->pool->start(new pooled_task_runner_c(queue, priority), priority);
+
+        return;
+    }
+
+    void run(void) override
+    {
+        std::function<bool(void)> task;
+
+        {
+            std::lock_guard<std::mutex> lock(this->queue->mutex);
+
+            // Either a runner queued since the latest change in priority will see
+            // to the work, or others have seen to it already.
+            if ((this->priority != this->queue->priority) ||
+                this->queue->tasks.empty())
+            {
+                return;
+            }
+
+            task = this->queue->tasks.front();
+            this->queue->tasks.pop_front();
+        }
+
+        if (!task())
+        {
+            std::lock_guard<std::mutex> lock(this->queue->mutex);
+
+            this->queue->tasks.push_back(task);
+            queue_runner(this->queue);
+        }
+
+        return;
+    }
+
+private:
+    const std::shared_ptr<pooled_work_queue_s> queue;
+    const int priority;
+};
+
+// Returns true if the two frames differ notably by the given detector, for sampled
+// analysis, which goes by plain frame differences.
+//
+static bool sampled_frames_differ(const cv::Mat &frame1, const cv::Mat &frame2, frame_difference_detector_c &detector)
+{
+    analysis_stage_timer_c timer(analysis_stats_c::stage_e::Comparison);
+
+    return detector.is_active(frame2, frame1);
+}
+
+video_activity_c::video_activity_c(const video_info_c &sourceVideo, const message_sink_c *const messager,
+                                   const video_activity_settings_s &settings) :
+    analysisStats(!settings.traceFileName.isEmpty()),
     messager(messager),
+    settings(settings),
+    pooledWork(std::make_shared<pooled_work_queue_s>()),
     videoInfo(sourceVideo)
 {
+    if ((this->settings.motionDetector == video_activity_settings_s::motion_detector_e::BackgroundModel) &&
+        (this->settings.videoAnalysisMode != video_activity_settings_s::video_analysis_mode_e::Sampled))
+    {
+        this->settings.videoComparisonMode = video_activity_settings_s::video_comparison_mode_e::Proxy;
+    }
+
+    this->pooledWork->pool = ((this->settings.sharedThreadPool != nullptr)? this->settings.sharedThreadPool : &this->ownThreadPool);
+    this->pooledWork->priority = this->settings.threadPriority;
+    this->ownThreadPool.setMaxThreadCount(this->num_video_analysis_threads());
+
     connect(    this, &video_activity_c::message_to_user,
-            messager, &messager_c::new_message);
+            messager, &message_sink_c::new_message);
+
+    if (!sourceVideo.is_valid_video())
+    {
+        return;
+    }
+
+    // Pre-reserve room for the frame activity data.
+    {
+        k_assert((this->videoInfo.num_frames() > 0), "The video contains no frames.");
+
+        this->videoFrameIsActive.reset(this->videoInfo.num_frames(), activity_type_e::Uninitialized);
+        this->audioFrameIsActive.reset(this->videoInfo.num_frames(), activity_type_e::Uninitialized);
+    }
+
+    if (this->settings.keepThumbnails)
+    {
+        this->videoThumbnails.reset(this->videoInfo.num_frames(), this->videoInfo.frame_rate(),
+                                    this->videoInfo.width(), this->videoInfo.height());
+    }
+
+    workerThreadsShouldStop = false;
+    detectorHasBeenLogged = false;
+    audioIsValid = false;
+    audioSampleRate = 0;
+    numFinishedWorkers = 0;
+
+    // Start processing the video's activity in separate worker threads. Each
+    // worker's stages get recorded until it's done, before it reports in. The
+    // workers first look for earlier results in the cache, which means reading
+    // from the video file and the cache file; so that's done by them, too, rather
+    // than here, lest a slow disk or network share hold up the caller.
+    this->videoStripThread = QtConcurrent::run([this]
+    {
+        {
+            analysis_stats_scope_c statsScope(&this->analysisStats);
+
+            if (!this->look_up_cached_activity())
+            {
+                this->mark_video_frame_activity();
+            }
+        }
+
+        this->analysis_worker_finished();
+    });
+
+    this->audioStripThread = QtConcurrent::run([this]
+    {
+        {
+            analysis_stats_scope_c statsScope(&this->analysisStats);
+
+            if (!this->look_up_cached_activity())
+            {
+                this->mark_audio_frame_activity();
+            }
+        }
+
+        this->analysis_worker_finished();
+    });
+
+    return;
+}
+
+video_activity_c::~video_activity_c()
+{
+    workerThreadsShouldStop = true;
+    this->videoStripThread.waitForFinished();
+    this->audioStripThread.waitForFinished();
+
+    delete this->activityCache;
+
+    return;
+}
+
+// Returns a signature of the settings that affect the results of the analysis,
+// for telling whether results in the activity cache were computed with the same
+// settings as are in use now. The thresholds that the cached frame scores and
+// audio energies can be re-judged by on loading are left out.
+//
+QByteArray video_activity_c::settings_signature(void) const
+{
+    // Bump this whenever the detectors are changed in ways that alter their results.
+    const quint32 detectorVersion = 1;
+
+    const bool keepsScores = this->keeps_frame_scores();
+
+    QByteArray signature;
+    QDataStream stream(&signature, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_5);
+
+    stream << detectorVersion
+           << quint32(this->videoInfo.num_frames())
+           << qint32(this->settings.videoComparisonMode)
+           << quint32(this->settings.proxyWidth)
+           << quint32(this->settings.proxyHeight)
+           << qint32(this->settings.audioEnergyMeasure)
+           << qint32(this->settings.audioDecoder)
+           << bool(this->settings.usePacketPrefilter)
+           << keepsScores;
+
+    if (!keepsScores)
+    {
+        stream << double(this->settings.activityHoldSeconds);
+    }
+
+    if (this->settings.videoAnalysisMode == video_activity_settings_s::video_analysis_mode_e::Sampled)
+    {
+        stream << double(this->settings.sampleStrideSeconds)
+               << quint32(this->settings.sampleRefinementDepth)
+               << quint32(this->settings.pixelDiffThreshold);
+    }
+    else
+    {
+        stream << qint32(this->settings.motionDetector);
+
+        // The frame difference detector's scores can be re-judged by any pixel
+        // difference threshold, but the background model's are of the threshold.
+        if (!keepsScores ||
+            (this->settings.motionDetector == video_activity_settings_s::motion_detector_e::BackgroundModel))
+        {
+            stream << quint32(this->settings.pixelDiffThreshold);
+        }
+
+        if (this->settings.motionDetector == video_activity_settings_s::motion_detector_e::BackgroundModel)
+        {
+            stream << double(this->settings.backgroundLearningRate)
+                   << quint32(this->settings.backgroundTileSize);
+
+            if (!keepsScores)
+            {
+                stream << double(this->settings.backgroundTileMinForeground);
+            }
+        }
+    }
+
+    // Hardware-decoded frames aren't bit-identical to software-decoded ones, so
+    // neither are the results. The hardware backends only get used for proxies.
+    if (this->settings.videoComparisonMode == video_activity_settings_s::video_comparison_mode_e::Proxy)
+    {
+        stream << qint32(this->settings.videoDecodeBackend);
+    }
+
+    if (this->settings.usePacketPrefilter)
+    {
+        stream << double(this->settings.prefilterThresholdDeviations)
+               << double(this->settings.prefilterMarginSeconds);
+    }
+
+    if (!this->settings.maskRegions.isEmpty())
+    {
+        stream << quint32(this->settings.maskRegions.size());
+
+        for (const auto &region: this->settings.maskRegions)
+        {
+            stream << double(region.x) << double(region.y)
+                   << double(region.width) << double(region.height)
+                   << bool(region.isExclusion);
+        }
+    }
+
+    return signature;
+}
+
+// Returns true if the video's activity was found in the activity cache, such that
+// it needn't be analyzed. Gets called by each of the analysis workers as it
+// starts; the first one to call it does the looking up, and the other waits for
+// it to be done.
+//
+bool video_activity_c::look_up_cached_activity(void)
+{
+    std::call_once(this->cacheLookupOnce, [this]
+    {
+        if (!this->settings.useActivityCache)
+        {
+            return;
+        }
+
+        this->activityCache = new activity_cache_c(this->videoInfo.file_name());
+
+        if (this->load_cached_activity())
+        {
+            INFO(("Loaded the video's activity from the cache."));
+            this->activityWasCached = true;
+        }
+    });
+
+    return this->activityWasCached;
+}
+
+// Attempts to fetch the video's activity from the activity cache. Returns false
+// if the cache had no valid data for it. The audio's activity, and the video's
+// where frame scores are being kept, get re-judged from the cached scores under
+// the current thresholds. The cached thumbnails, if any, get loaded as well; but
+// since not all of the cache's users keep thumbnails (e.g. the command-line tool
+// doesn't), lacking them doesn't make the data invalid - the sheet then just stays
+// empty.
+//
+bool video_activity_c::load_cached_activity(void)
+{
+    const uint numFrames = this->videoInfo.num_frames();
+    QByteArray videoActivity, audioActivity, thumbnails;
+    QVector<float> videoScores, audioEnergies;
+
+    if (!this->activityCache->load(this->settings_signature(), videoActivity, audioActivity, videoScores, audioEnergies, thumbnails) ||
+        (uint(videoActivity.size()) != numFrames) ||
+        (uint(audioActivity.size()) != numFrames) ||
+        (this->keeps_frame_scores() && (uint(videoScores.size()) != numFrames)))
+    {
+        return false;
+    }
+
+    const bool audioIsValid = (activity_type_e(audioActivity.at(0)) != activity_type_e::NoData);
+
+    if (audioIsValid &&
+        (uint(audioEnergies.size()) != numFrames))
+    {
+        return false;
+    }
+
+    {
+        activity_timeline_writer_c videoFrameActivity(this->videoFrameIsActive);
+        activity_timeline_writer_c audioFrameActivity(this->audioFrameIsActive);
+
+        for (uint i = 0; i < this->videoInfo.num_frames(); i++)
+        {
+            videoFrameActivity.set(i, activity_type_e(videoActivity.at(i)));
+            audioFrameActivity.set(i, activity_type_e(audioActivity.at(i)));
+        }
+    }
+
+    if (this->settings.keepThumbnails &&
+        !this->videoThumbnails.decode(thumbnails, numFrames))
+    {
+        DEBUG(("The cached activity came without valid thumbnails; leaving them out."));
+    }
+
+    this->audioIsValid = audioIsValid;
+    this->audioFrameEnergy = audioEnergies;
+
+    if (audioIsValid)
+    {
+        this->mark_audio_frame_activity_from_energies();
+    }
+
+    if (this->keeps_frame_scores())
+    {
+        this->videoFrameScore = videoScores;
+        this->mark_video_frame_activity_from_scores();
+    }
+
+    return true;
+}
+
+// Stores the video's activity in the activity cache.
+//
+void video_activity_c::save_activity_to_cache(void) const
+{
+    QByteArray videoActivity(this->videoInfo.num_frames(), 0);
+    QByteArray audioActivity(this->videoInfo.num_frames(), 0);
+
+    for (uint i = 0; i < this->videoInfo.num_frames(); i++)
+    {
+        videoActivity[i] = char(this->videoFrameIsActive.at(i));
+        audioActivity[i] = char(this->audioFrameIsActive.at(i));
+    }
+
+    if (!this->activityCache->save(this->settings_signature(), videoActivity, audioActivity,
+                                   this->videoFrameScore, (this->audioIsValid? this->audioFrameEnergy : QVector<float>()),
+                                   (this->settings.keepThumbnails? this->videoThumbnails.encoded() : QByteArray())))
+    {
+        NBENE(("Failed to store the video's activity in the cache."));
+    }
+
+    return;
+}
+
+// Gets called by each of the analysis worker threads as it finishes. Once all of
+// them have finished, the results get stored in the activity cache - unless the
+// analysis was cut short - and the trace of the analysis, if one was asked for,
+// gets written out.
+//
+void video_activity_c::analysis_worker_finished(void)
+{
+    const uint numWorkers = 2;
+
+    if (++this->numFinishedWorkers != numWorkers)
+    {
+        return;
+    }
+
+    this->analysisStats.mark_finished();
+
+    if (!this->workerThreadsShouldStop &&
+        !this->activityWasCached &&
+        (this->activityCache != nullptr) &&
+        !this->videoFrameIsActive.contains(activity_type_e::Uninitialized) &&
+        !this->audioFrameIsActive.contains(activity_type_e::Uninitialized))
+    {
+        this->save_activity_to_cache();
+    }
+
+    if (!this->settings.traceFileName.isEmpty() &&
+        this->analysisStats.write_trace(this->settings.traceFileName))
+    {
+        INFO(("Wrote a trace of the analysis into '%s'.", this->settings.traceFileName.toUtf8().constData()));
+    }
+
+    return;
+}
+
+bool video_activity_c::is_active_frame_at(const uint offs, const uint videoOrAudioOrBoth) const
+{
+    switch (videoOrAudioOrBoth)
+    {
+    case 0: return this->videoFrameIsActive.is_active_frame_at(offs);
+    case 1: return this->audioFrameIsActive.is_active_frame_at(offs);
+    case 2: return bool(this->audioFrameIsActive.is_active_frame_at(offs) ||
+                        this->videoFrameIsActive.is_active_frame_at(offs));
+    default: k_assert(0, "Unknown track type."); return false;
+    }
+}
+
+// Returns the thumbnails of the video's frames, which get filled in as the analysis
+// goes along if the settings ask for them to be kept; otherwise, none.
+//
+const thumbnail_sheet_c& video_activity_c::thumbnails(void) const
+{
+    return this->videoThumbnails;
+}
+
+// Returns the per-frame activity of the video (0) or audio (1) track.
+//
+const activity_timeline_c& video_activity_c::frame_activity(const uint videoOrAudio) const
+{
+    k_assert((videoOrAudio <= 1), "Unknown track type.");
+
+    return ((videoOrAudio == 0)? this->videoFrameIsActive
+                               : this->audioFrameIsActive);
+}
+
+// Returns true once the video's audio track has been successfully decoded.
+//
+bool video_activity_c::has_valid_audio() const
+{
+    return this->audioIsValid;
+}
+
+// Returns the sample rate of the video's audio track, once the analysis has
+// decoded it; or 0 until then, or if the audio's activity was loaded from the
+// cache rather than decoded.
+//
+uint video_activity_c::audio_sample_rate() const
+{
+    return this->audioSampleRate;
+}
+
+// Returns true once the video and audio activity strips have finished
+// processing.
+//
+bool video_activity_c::strip_build_has_finished() const
+{
+    return bool(videoStripThread.isFinished() && audioStripThread.isFinished());
+}
+
+// Returns how far along the analysis is. The frames done are counted as they get
+// committed to the timelines, which the workers do every few thousand frames; the
+// estimate of the time left assumes that each track carries on at the rate it has
+// gone at so far.
+//
+video_activity_progress_s video_activity_c::progress(void) const
+{
+    video_activity_progress_s progress;
+
+    if (!this->videoInfo.is_valid_video())
+    {
+        return progress;
+    }
+
+    // Check for completion first, so that the counts are at least as recent.
+    progress.isFinished = this->strip_build_has_finished();
+    progress.numFrames = this->videoInfo.num_frames();
+    progress.numVideoFramesDone = (progress.numFrames - std::min(progress.numFrames, this->videoFrameIsActive.num_uninitialized()));
+    progress.numAudioFramesDone = (progress.numFrames - std::min(progress.numFrames, this->audioFrameIsActive.num_uninitialized()));
+    progress.elapsedSeconds = this->analysisStats.elapsed_seconds();
+
+    if (progress.isFinished)
+    {
+        progress.etaSeconds = 0;
+    }
+    else if ((progress.numVideoFramesDone > 0) &&
+             (progress.numAudioFramesDone > 0))
+    {
+        const auto seconds_left = [&progress](const uint numDone)->real
+        {
+            return (((progress.numFrames - numDone) * progress.elapsedSeconds) / numDone);
+        };
+
+        progress.etaSeconds = std::max(seconds_left(progress.numVideoFramesDone),
+                                       seconds_left(progress.numAudioFramesDone));
+    }
+
+    return progress;
+}
+
+// Returns the counts and timings of the analysis' stages so far.
+//
+const analysis_stats_c& video_activity_c::stats(void) const
+{
+    return this->analysisStats;
+}
+
+// Returns true if the video's frame scores are at hand, such that its visual
+// activity can be re-judged under other thresholds.
+//
+bool video_activity_c::has_frame_scores(void) const
+{
+    return (this->strip_build_has_finished() &&
+            (uint(this->videoFrameScore.size()) == this->videoInfo.num_frames()));
+}
+
+// Re-judges the video's activity under the thresholds of the given settings: the
+// pixel difference threshold, the tiles' minimum foreground, the activity hold,
+// and the audio's threshold. The rest of the given settings are ignored. The
+// video track gets re-judged only if the frame scores were kept (and the pixel
+// difference threshold only with the frame difference detector, whose scores
+// aren't of any threshold), and the audio track always. Takes no decoding, so is
+// quick enough to do on the fly. Returns false if the analysis hasn't yet finished,
+// in which case nothing is changed.
+//
+bool video_activity_c::rethreshold(const video_activity_settings_s &thresholds)
+{
+    if (!this->videoInfo.is_valid_video() ||
+        !this->strip_build_has_finished())
+    {
+        return false;
+    }
+
+    if (this->settings.motionDetector == video_activity_settings_s::motion_detector_e::FrameDifference)
+    {
+        this->settings.pixelDiffThreshold = thresholds.pixelDiffThreshold;
+    }
+
+    this->settings.backgroundTileMinForeground = thresholds.backgroundTileMinForeground;
+    this->settings.activityHoldSeconds = thresholds.activityHoldSeconds;
+    this->settings.audioThresholdDeviations = thresholds.audioThresholdDeviations;
+
+    if (this->has_frame_scores())
+    {
+        this->mark_video_frame_activity_from_scores();
+    }
+
+    if (this->audioIsValid)
+    {
+        this->mark_audio_frame_activity_from_energies();
+    }
+
+    return true;
+}
+
+// Assumes that the given frame is active; returns the index of the frame in
+// which that activity began.
+//
+uint video_activity_c::get_start_of_active_segment(const uint startFrameIdx, const uint videoOrAudio) const
+{
+    const auto &frameActivity = ((videoOrAudio == 0)? this->videoFrameIsActive
+                                                    : this->audioFrameIsActive);
+
+    return frameActivity.get_start_of_active_segment(startFrameIdx);
+}
+
+// Finds the first frame of the nearest segment of activity that begins after the
+// given frame, on the given track or either of them (2). Returns false if there's
+// no such segment.
+//
+bool video_activity_c::get_next_active_segment(const uint frameIdx, const uint videoOrAudioOrBoth, uint &segmentStartIdx) const
+{
+    uint videoStartIdx = 0, audioStartIdx = 0;
+    const bool haveVideo = ((videoOrAudioOrBoth != 1) && this->videoFrameIsActive.get_next_active_segment(frameIdx, videoStartIdx));
+    const bool haveAudio = ((videoOrAudioOrBoth != 0) && this->audioFrameIsActive.get_next_active_segment(frameIdx, audioStartIdx));
+
+    k_assert((videoOrAudioOrBoth <= 2), "Unknown track type.");
+
+    if (haveVideo && haveAudio) segmentStartIdx = std::min(videoStartIdx, audioStartIdx);
+    else if (haveVideo) segmentStartIdx = videoStartIdx;
+    else if (haveAudio) segmentStartIdx = audioStartIdx;
+
+    return bool(haveVideo || haveAudio);
+}
+
+// Finds the first frame of the nearest segment of activity that begins before the
+// given frame, on the given track or either of them (2). Returns false if there's
+// no such segment.
+//
+bool video_activity_c::get_previous_active_segment(const uint frameIdx, const uint videoOrAudioOrBoth, uint &segmentStartIdx) const
+{
+    uint videoStartIdx = 0, audioStartIdx = 0;
+    const bool haveVideo = ((videoOrAudioOrBoth != 1) && this->videoFrameIsActive.get_previous_active_segment(frameIdx, videoStartIdx));
+    const bool haveAudio = ((videoOrAudioOrBoth != 0) && this->audioFrameIsActive.get_previous_active_segment(frameIdx, audioStartIdx));
+
+    k_assert((videoOrAudioOrBoth <= 2), "Unknown track type.");
+
+    if (haveVideo && haveAudio) segmentStartIdx = std::max(videoStartIdx, audioStartIdx);
+    else if (haveVideo) segmentStartIdx = videoStartIdx;
+    else if (haveAudio) segmentStartIdx = audioStartIdx;
+
+    return bool(haveVideo || haveAudio);
+}
+
+// Returns the segments of activity on the given track, or on either of them (2),
+// as [start, end) frame indices in ascending order. Segments of the two tracks
+// that overlap or touch get merged into one.
+//
+std::vector<std::pair<uint, uint>> video_activity_c::active_segments(const uint videoOrAudioOrBoth) const
+{
+    k_assert((videoOrAudioOrBoth <= 2), "Unknown track type.");
+
+    if (videoOrAudioOrBoth != 2)
+    {
+        return this->frame_activity(videoOrAudioOrBoth).active_segments();
+    }
+
+    std::vector<std::pair<uint, uint>> trackSegments = this->videoFrameIsActive.active_segments();
+    const std::vector<std::pair<uint, uint>> audioSegments = this->audioFrameIsActive.active_segments();
+
+    trackSegments.insert(trackSegments.end(), audioSegments.begin(), audioSegments.end());
+    std::sort(trackSegments.begin(), trackSegments.end());
+
+    std::vector<std::pair<uint, uint>> segments;
+
+    for (const auto &segment: trackSegments)
+    {
+        if (!segments.empty() &&
+            (segment.first <= segments.back().second))
+        {
+            segments.back().second = std::max(segments.back().second, segment.second);
+        }
+        else
+        {
+            segments.push_back(segment);
+        }
+    }
+
+    return segments;
+}
+
+// Calls FFMPEG as an external process to extract the video's audio into an easier-
+// to-process WAV file of the given name. Used only with the external FFMPEG audio
+// decoder setting; otherwise, the audio is decoded in-process by audio_decoder_c.
+// Returns false if the extraction failed.
+//
+bool video_activity_c::extract_audio(const QString &audioFilename)
+{
+    // Run FFMPEG to extract the audio file. Assumes that the user already has
+    // FFMPEG available on their system, and that it's callable globally. If not,
+    // no audio activity information will be available.
+    // With -rf64 auto, tracks of more than 4 GB get written as RF64, whose sizes
+    // don't overflow.
+    QString cmd = QString("ffmpeg -i \"%1\" -flags bitexact -map_metadata -1 -acodec pcm_s16le -ac 1 -rf64 auto -y \"%2\"")
+                  .arg(this->videoInfo.file_name())
+                  .arg(audioFilename);
+
+    analysis_stage_timer_c timer(analysis_stats_c::stage_e::AudioExtraction);
+
+    const int ret = system(cmd.toStdString().c_str());
+    if (ret != 0)
+    {
+        NBENE(("Failed to extract the video's audio using FFMPEG."));
+        return false;
+    }
+
+    return true;
+}
+
+// Decodes the video's audio track, passing its samples to the given sink as they
+// come, in mono and at 16 bits. The track's sample rate will be written into
+// sampleRate before the sink receives any samples. Returns false if the audio
+// couldn't be decoded in full.
+//
+bool video_activity_c::decode_audio(const audio_sample_sink_f &sampleSink, uint &sampleRate)
+{
+    switch (this->settings.audioDecoder)
+    {
+        case video_activity_settings_s::audio_decoder_e::Native:
+        {
+            audio_decoder_c decoder(this->videoInfo.file_name());
+            if (!decoder.is_valid())
+            {
+                return false;
+            }
+
+            sampleRate = decoder.sample_rate();
+
+            return decoder.decode(sampleSink);
+        }
+        case video_activity_settings_s::audio_decoder_e::ExternalFfmpeg:
+        {
+            const QString audioFilename = (this->videoInfo.file_name() + ".wav");
+            bool decodedFully = false;
+
+            if (!this->extract_audio(audioFilename))
+            {
+                return false;
+            }
+
+            // Stream the WAV file's samples to the sink a chunk at a time. The file
+            // is memory-mapped, so only the chunks being read need to be resident.
+            {
+                const audio_file_c audio(audioFilename, this->messager);
+
+                if (audio.has_valid_audio_data())
+                {
+                    sampleRate = audio.sample_rate();
+                    decodedFully = true;
+
+                    QVector<i16> chunk(4096);
+                    uint numRead = 0;
+                    for (u64 i = 0; (numRead = audio.read_samples(i, chunk.size(), chunk.data())) > 0; i += numRead)
+                    {
+                        if (!sampleSink(chunk.constData(), numRead))
+                        {
+                            decodedFully = false;
+                            break;
+                        }
+                    }
+                }
+            }
+
+            // We can delete the temporary audio file from disk now.
+            QFile(audioFilename).remove();
+
+            return decodedFully;
+        }
+        default: k_assert(0, "Unknown audio decoder."); return false;
+    }
+}
+
+// Accumulates the sum of squares and the peak magnitude of the given samples.
+// Kept as a plain loop over contiguous memory so that the compiler can
+// vectorize it.
+//
+static void accumulate_audio_energy(const i16 *const samples, const uint count,
+                                    u64 &sumOfSquares, int &peak)
+{
+    u64 sum = 0;
+    int max = 0;
+
+    for (uint i = 0; i < count; i++)
+    {
+        const int sample = samples[i];
+
+        sum += u64(sample * sample);
+        max = std::max(max, std::abs(sample));
+    }
+
+    sumOfSquares += sum;
+    peak = std::max(peak, max);
+
+    return;
+}
+
+// Returns the energy above which a frame's audio is considered loud, given the
+// energies of all the frames: the median energy plus the given number of median
+// absolute deviations from it.
+//
+static float audio_loudness_threshold(QVector<float> energies, const real numDeviations)
+{
+    if (energies.isEmpty())
+    {
+        return 0;
+    }
+
+    const auto median = [](QVector<float> &values)->float
+    {
+        auto mid = (values.begin() + (values.size() / 2));
+        std::nth_element(values.begin(), mid, values.end());
+        return *mid;
+    };
+
+    const float medianEnergy = median(energies);
+
+    for (auto &energy: energies)
+    {
+        energy = std::fabs(energy - medianEnergy);
+    }
+
+    // Guard against a deviation of zero, e.g. when most of the track is digital
+    // silence, in which case any bit of noise would count as loud.
+    const float deviation = std::max(1.0f, median(energies));
+
+    return float(medianEnergy + (deviation * numDeviations));
+}
+
+// Works through all the audio samples in the video's audio track to find the
+// video frames during which the audio is notably louder than its baseline. Each
+// frame's loudness is measured over the audio samples that fall within it, in one
+// pass over the samples as they're decoded; and the threshold of loudness is then
+// derived from the distribution of the frames' loudnesses.
+//
+void video_activity_c::mark_audio_frame_activity(void)
+{
+    const uint numFrames = this->videoInfo.num_frames();
+
+    k_assert((numFrames > 0), "Asked to mark audio activity, but there are no frames to mark it for.");
+
+    // Stream the audio's samples in, measuring the energy of the samples within
+    // each video frame.
+    {
+        u64 numSamples = 0;
+        uint sampleRate = 0;
+        uint frameIdx = 0;
+        u64 frameEndSample = 0;
+        u64 frameSumOfSquares = 0;
+        int framePeak = 0;
+        u64 frameNumSamples = 0;
+
+        const auto finish_frame = [&]
+        {
+            switch (this->settings.audioEnergyMeasure)
+            {
+                case video_activity_settings_s::audio_energy_measure_e::Rms:
+                {
+                    this->audioFrameEnergy[frameIdx] = (frameNumSamples? std::sqrt(frameSumOfSquares / real(frameNumSamples)) : 0);
+                    break;
+                }
+                case video_activity_settings_s::audio_energy_measure_e::Peak:
+                {
+                    this->audioFrameEnergy[frameIdx] = framePeak;
+                    break;
+                }
+                default: k_assert(0, "Unknown audio energy measure."); break;
+            }
+
+            frameIdx++;
+            frameEndSample = u64(std::ceil((frameIdx + 1) * (sampleRate / this->videoInfo.frame_rate())));
+            frameSumOfSquares = 0;
+            framePeak = 0;
+            frameNumSamples = 0;
+        };
+
+        const audio_sample_sink_f sampleSink = [&](const i16 *const samples, const uint count)->bool
+        {
+            analysis_stage_timer_c timer(analysis_stats_c::stage_e::AudioMeasure);
+
+            if (frameEndSample == 0)
+            {
+                frameEndSample = u64(std::ceil(sampleRate / this->videoInfo.frame_rate()));
+            }
+
+            uint i = 0;
+
+            while ((i < count) &&
+                   (frameIdx < numFrames))
+            {
+                const uint spanLength = uint(std::min(u64(count - i), (frameEndSample - numSamples)));
+
+                accumulate_audio_energy((samples + i), spanLength, frameSumOfSquares, framePeak);
+
+                i += spanLength;
+                numSamples += spanLength;
+                frameNumSamples += spanLength;
+
+                if (numSamples >= frameEndSample)
+                {
+                    finish_frame();
+                }
+            }
+
+            // Any samples extending past the video's last frame are ignored.
+            numSamples += (count - i);
+
+            return !this->workerThreadsShouldStop;
+        };
+
+        this->audioFrameEnergy.fill(0, numFrames);
+
+        bool decodedFully = false;
+        {
+            analysis_stage_timer_c timer(analysis_stats_c::stage_e::AudioDecode);
+            decodedFully = this->decode_audio(sampleSink, sampleRate);
+        }
+
+        if (this->workerThreadsShouldStop)
+        {
+            return;
+        }
+
+        if (!decodedFully ||
+            (numSamples == 0))
+        {
+            NBENE(("Failed to decode the video's audio. Audio information will not be available."));
+            emit message_to_user("The audio track could not be processed.");
+
+            this->audioFrameIsActive.set_range(0, numFrames, activity_type_e::NoData);
+            return;
+        }
+
+        if ((frameIdx < numFrames) &&
+            (frameNumSamples > 0))
+        {
+            finish_frame();
+        }
+
+        this->audioSampleRate = sampleRate;
+        this->audioIsValid = true;
+    }
+
+    this->mark_audio_frame_activity_from_energies();
+
+    return;
+}
+
+// Marks frames as active whose audio, as measured into audioFrameEnergy, is loud
+// enough.
+//
+void video_activity_c::mark_audio_frame_activity_from_energies(void)
+{
+    const uint numFrames = this->videoInfo.num_frames();
+    const uint timeGranularity = this->time_granularity();
+
+    k_assert((uint(this->audioFrameEnergy.size()) == numFrames), "Asked to mark audio activity without the audio's energies.");
+
+    const float thresholdEnergy = audio_loudness_threshold(this->audioFrameEnergy, this->settings.audioThresholdDeviations);
+    {
+        activity_timeline_writer_c frameActivity(this->audioFrameIsActive);
+
+        for (uint i = 0; i < numFrames; i++)
+        {
+            const bool isLoud = bool(this->audioFrameEnergy.at(i) > thresholdEnergy);
+
+            frameActivity.set(i, (isLoud? activity_type_e::Active
+                                        : activity_type_e::Inactive));
+
+            if (isLoud)
+            {
+                const uint numFramesToSkip = ((i + timeGranularity) > numFrames)? (numFrames - i)
+                                                                                : timeGranularity;
+
+                frameActivity.set_range(i, (i + numFramesToSkip), activity_type_e::Active);
+
+                // Resume from the first frame past the skipped ones.
+                i += (numFramesToSkip - 1);
+            }
+
+            // Periodically check to make sure the user doesn't want us to stop processing.
+            if (((i % 200) == 0) &&
+                this->workerThreadsShouldStop)
+            {
+                return;
+            }
+        }
+    }
+
+    return;
+}
+
+// Returns a new decoder for the video's frames, using the decode backend asked
+// for in the settings if it's available. The caller takes ownership of it.
+//
+video_decoder_c* video_activity_c::open_video(void) const
+{
+    video_decoder_c *const video = video_decoder_c::create(this->videoInfo, this->settings);
+    k_assert(video->is_open(), "Failed to open the video file for decoding.");
+
+    return video;
+}
+
+// Reads the video's next frame, which is the one at the given index, into the
+// given matrix, in the form in which frames are to be compared for activity. If
+// thumbnails are being kept and one is wanted of the frame, it's made now, while
+// the frame is at hand.
+//
+void video_activity_c::read_comparison_frame(video_decoder_c &video, const uint frameIdx, cv::Mat &frame)
+{
+    {
+        analysis_stage_timer_c timer(analysis_stats_c::stage_e::FrameRead);
+
+        const bool frameWasRead = video.read(frame);
+        k_assert(frameWasRead, "Failed to read a frame from the video.");
+    }
+
+    if (this->videoThumbnails.wants_frame(frameIdx))
+    {
+        analysis_stage_timer_c timer(analysis_stats_c::stage_e::Thumbnail);
+
+        this->videoThumbnails.add_frame(frameIdx, frame);
+    }
+
+    return;
+}
+
+// Moves the video's read position forward from nextFrameIdx, which is the frame
+// the decoder would otherwise read next, to targetFrameIdx. Depending on the skip
+// policy and the distance to skip, this is done either by seeking, or by decoding
+// the intervening frames without retrieving (and thus color-converting) them.
+// Seeking is usually only worth it when the skip is longer than a keyframe
+// interval, since the decoder otherwise has to re-decode from the preceding
+// keyframe anyway.
+//
+void video_activity_c::skip_to_frame(video_decoder_c &video, const uint nextFrameIdx, const uint targetFrameIdx) const
+{
+    k_assert((targetFrameIdx >= nextFrameIdx), "Was asked to skip backwards in the video.");
+
+    const uint skipLength = (targetFrameIdx - nextFrameIdx);
+    bool shouldSeek = false;
+
+    switch (this->settings.videoSkipPolicy)
+    {
+        case video_activity_settings_s::video_skip_policy_e::Seek: shouldSeek = true; break;
+        case video_activity_settings_s::video_skip_policy_e::Grab: shouldSeek = false; break;
+        case video_activity_settings_s::video_skip_policy_e::Adaptive: shouldSeek = (skipLength > this->settings.keyframeInterval); break;
+        default: k_assert(0, "Unknown video skip policy."); break;
+    }
+
+    if (shouldSeek)
+    {
+        video.seek(targetFrameIdx);
+    }
+    else
+    {
+        analysis_stage_timer_c timer(analysis_stats_c::stage_e::Skip);
+
+        for (uint i = 0; i < skipLength; i++)
+        {
+            if (!video.grab())
+            {
+                break;
+            }
+        }
+    }
+
+    return;
+}
+
+// The number of subsequent frames that activity in one frame will cause to be
+// marked as active, as well.
+//
+uint video_activity_c::time_granularity(void) const
+{
+    if (this->settings.activityHoldSeconds > 0)
+    {
+        return std::max(1u, uint(std::round(this->settings.activityHoldSeconds * this->videoInfo.frame_rate())));
+    }
+
+    return (this->videoInfo.num_frames() / TIME_GRANULARITY_DIVISOR);
+}
+
+// Returns true if the analysis keeps a score of each of the video's frames.
+//
+bool video_activity_c::keeps_frame_scores(void) const
+{
+    return (this->settings.keepFrameScores &&
+            (this->settings.videoAnalysisMode != video_activity_settings_s::video_analysis_mode_e::Sampled));
+}
+
+// The number of frames between the frames compared in sampled analysis.
+//
+uint video_activity_c::sample_stride(void) const
+{
+    return std::max(1u, uint(std::round(this->settings.sampleStrideSeconds * this->videoInfo.frame_rate())));
+}
+
+// Compares the video's frames in pairs, and marks a given frame as active if
+// its color values differ notably from those of the preceding frame.
+//
+void video_activity_c::mark_video_frame_activity(void)
+{
+    if (this->keeps_frame_scores())
+    {
+        this->videoFrameScore.fill(-1, this->videoInfo.num_frames());
+    }
+
+    if (this->settings.usePacketPrefilter &&
+        this->mark_video_frame_activity_prefiltered())
+    {
+        k_assert(uint(this->videoFrameIsActive.size()) == this->videoInfo.num_frames(), "Some frames were skipped while marking activity.");
+        return;
+    }
+
+    switch (this->settings.videoAnalysisMode)
+    {
+        case video_activity_settings_s::video_analysis_mode_e::Sequential: this->mark_video_frame_activity_sequential(); break;
+        case video_activity_settings_s::video_analysis_mode_e::Segmented: this->mark_video_frame_activity_segmented(); break;
+        case video_activity_settings_s::video_analysis_mode_e::Sampled: this->mark_video_frame_activity_sampled(); break;
+        default: k_assert(0, "Unknown video analysis mode."); break;
+    }
+
+    k_assert(uint(this->videoFrameIsActive.size()) == this->videoInfo.num_frames(), "Some frames were skipped while marking activity.");
+
+    return;
+}
+
+// The number of threads across which to spread the decoding and comparison of
+// the video's frames.
+//
+uint video_activity_c::num_video_analysis_threads(void) const
+{
+    const int poolNumThreads = (this->settings.sharedThreadPool != nullptr)? this->settings.sharedThreadPool->maxThreadCount()
+                                                                           : QThread::idealThreadCount();
+
+    return ((this->settings.numVideoAnalysisThreads > 0)? this->settings.numVideoAnalysisThreads
+                                                         : uint(std::max(1, poolNumThreads)));
+}
+
+// Marks the video's frame activity in a single pass over the whole video.
+//
+void video_activity_c::mark_video_frame_activity_sequential(void)
+{
+    const std::unique_ptr<video_decoder_c> video(this->open_video());
+    INFO(("Decoding video frames via the %s backend.", video->backend_name()));
+
+    QVector<uint> activityHits;
+    this->mark_video_frame_range(*video, 0, this->videoInfo.num_frames(), true, activityHits, nullptr);
+
+    return;
+}
+
+// Splits the video into segments whose frame activity is marked in parallel, each
+// segment with its own decoder. The segments are then stitched together such that
+// the result is identical to that of a sequential pass: where activity found near
+// the end of one segment would have caused a sequential pass to skip into the next
+// segment, the head of that next segment is re-processed from the frame at which
+// the sequential pass would have resumed, until the re-processing falls in step
+// with the segment's original results.
+//
+void video_activity_c::mark_video_frame_activity_segmented(void)
+{
+    struct video_segment_s
+    {
+        uint startFrameIdx;
+        uint endFrameIdx;
+
+        // The frames in this segment at which activity was found (each of which
+        // will have caused the frames following it to be skipped).
+        QVector<uint> activityHits;
+    };
+
+    const uint numFrames = this->videoInfo.num_frames();
+    const uint timeGranularity = this->time_granularity();
+    const uint numThreads = this->num_video_analysis_threads();
+    const uint numSegmentsPerThread = ((this->settings.sharedThreadPool != nullptr)? NUM_SHARED_POOL_SEGMENTS_PER_THREAD : 1);
+    const uint numSegments = std::max(1u, std::min((numThreads * numSegmentsPerThread), (numFrames / MIN_VIDEO_SEGMENT_LENGTH)));
+
+    if (numSegments == 1)
+    {
+        this->mark_video_frame_activity_sequential();
+        return;
+    }
+
+    QVector<video_segment_s> segments(numSegments);
+    for (uint i = 0; i < numSegments; i++)
+    {
+        segments[i].startFrameIdx = ((numFrames / numSegments) * i);
+        segments[i].endFrameIdx = ((i == (numSegments - 1))? numFrames
+                                                           : ((numFrames / numSegments) * (i + 1)));
+    }
+
+    // Process the segments in parallel. Each segment other than the first starts by
+    // comparing its first frame against the last frame of the preceding segment,
+    // as a sequential pass would, assuming no activity was found just before it.
+    {
+        std::vector<std::function<bool(void)>> segmentTasks;
+
+        for (auto &segment: segments)
+        {
+            segmentTasks.push_back([this, &segment]
+            {
+                // On a shared pool, this segment might only get its turn after
+                // we've been asked to stop.
+                if (this->workerThreadsShouldStop)
+                {
+                    return true;
+                }
+
+                analysis_stats_scope_c statsScope(&this->analysisStats);
+                const std::unique_ptr<video_decoder_c> video(this->open_video());
+                const bool isFirstSegment = (segment.startFrameIdx == 0);
+
+                if (isFirstSegment)
+                {
+                    INFO(("Decoding video frames via the %s backend.", video->backend_name()));
+                }
+
+                this->mark_video_frame_range(*video,
+                                             (isFirstSegment? 0 : (segment.startFrameIdx - 1)),
+                                             segment.endFrameIdx,
+                                             isFirstSegment,
+                                             segment.activityHits,
+                                             nullptr);
+
+                return true;
+            });
+        }
+
+        this->run_pooled_tasks(segmentTasks);
+    }
+
+    if (this->workerThreadsShouldStop)
+    {
+        return;
+    }
 
-    if (!sourceVideo.is_valid_video())
+    // With every frame scored, the segments' activity can be re-judged from the
+    // scores as a sequential pass would have judged it, without re-processing any.
+    if (this->keeps_frame_scores())
     {
+        this->mark_video_frame_activity_from_scores();
         return;
     }
 
-    // Pre-reserve room for the frame activity data.
+    // Stitch the segments together.
     {
-        k_assert((this->videoInfo.num_frames() > 0), "The video contains no frames.");
+        const std::unique_ptr<video_decoder_c> video(this->open_video());
 
-        this->videoFrameIsActive.resize(this->videoInfo.num_frames());
-        this->audioFrameIsActive.resize(this->videoInfo.num_frames());
+        bool haveActivity = false;
+        uint lastActivityHit = 0;
 
-        qFill(this->videoFrameIsActive, activity_type_e::Uninitialized);
-        qFill(this->audioFrameIsActive, activity_type_e::Uninitialized);
-    }
+        for (auto &segment: segments)
+        {
+            // See whether activity found in the preceding segments reaches into
+            // this one.
+            if (haveActivity &&
+                ((lastActivityHit + timeGranularity) >= segment.startFrameIdx))
+            {
+                const uint resumeFrameIdx = (lastActivityHit + timeGranularity);
 
-    // Start processing the video's activity in separate worker threads.
-    workerThreadsShouldStop = false;
-    this->videoStripThread = QtConcurrent::run(this, &video_activity_c::mark_video_frame_activity);
-    this->audioStripThread = QtConcurrent::run(this, &video_activity_c::mark_audio_frame_activity);
+                this->videoFrameIsActive.set_range(segment.startFrameIdx, std::min(resumeFrameIdx, segment.endFrameIdx),
+                                                   activity_type_e::Active);
 
-    return;
-}
+                // The skip spans this whole segment, so its own results are void.
+                if (resumeFrameIdx >= segment.endFrameIdx)
+                {
+                    segment.activityHits.clear();
+                    continue;
+                }
 
-video_activity_c::~video_activity_c()
-{
-    workerThreadsShouldStop = true;
-    this->videoStripThread.waitForFinished();
-    this->audioStripThread.waitForFinished();
+                QVector<uint> redoneHits;
+                const uint syncFrameIdx = this->mark_video_frame_range(*video, resumeFrameIdx, segment.endFrameIdx, true,
+                                                                       redoneHits, &segment.activityHits);
+
+                if (this->workerThreadsShouldStop)
+                {
+                    return;
+                }
+
+                for (const uint hit: segment.activityHits)
+                {
+                    if (hit >= syncFrameIdx)
+                    {
+                        redoneHits << hit;
+                    }
+                }
 
-    delete audio;
+                segment.activityHits = redoneHits;
+            }
+
+            if (!segment.activityHits.isEmpty())
+            {
+                haveActivity = true;
+                lastActivityHit = segment.activityHits.last();
+            }
+        }
+    }
 
     return;
 }
 
-bool video_activity_c::is_active_frame_at(const uint offs, const uint videoOrAudioOrBoth) const
+// Marks the video's frame activity in two tiers: a scan of the sizes of its
+// compressed frames first picks out the stretches of the video that might contain
+// activity, and only those then get decoded and compared, the rest being marked
+// inactive. The stretches are shared out among worker threads, each taking the
+// next stretch not yet taken and keeping its decoder open from one to the next.
+// Returns false without marking anything if the pre-filter isn't of use on this
+// video, e.g. because the stretches would cover most of it.
+//
+bool video_activity_c::mark_video_frame_activity_prefiltered(void)
 {
-    switch (videoOrAudioOrBoth)
+    const uint numFrames = this->videoInfo.num_frames();
+    const uint marginFrames = uint(this->settings.prefilterMarginSeconds * this->videoInfo.frame_rate());
+    std::vector<std::pair<uint, uint>> candidateRanges;
+    bool haveCandidates = false;
+
     {
-    case 0: return bool(this->videoFrameIsActive.at(offs) == activity_type_e::Active);
-    case 1: return bool(this->audioFrameIsActive.at(offs) == activity_type_e::Active);
-    case 2: return bool((this->audioFrameIsActive.at(offs) == activity_type_e::Active) ||
-                        (this->videoFrameIsActive.at(offs) == activity_type_e::Active));
-    default: k_assert(0, "Unknown track type."); return false;
+        analysis_stage_timer_c timer(analysis_stats_c::stage_e::PacketPrefilter);
+
+        haveCandidates = packet_prefilter_find_candidates(this->videoInfo.file_name(), numFrames, this->settings.prefilterThresholdDeviations,
+                                                          marginFrames, this->settings.keyframeInterval, this->workerThreadsShouldStop,
+                                                          candidateRanges);
     }
-}
 
-bool video_activity_c::has_valid_audio() const
-{
-    return bool((this->audio != nullptr) &&
-                this->audio->has_valid_audio_data());
+    if (!haveCandidates)
+    {
+        INFO(("The packet pre-filter couldn't be applied to this video."));
+        return false;
+    }
+
+    u64 numCandidateFrames = 0;
+    for (const auto &range: candidateRanges)
+    {
+        numCandidateFrames += (range.second - range.first);
+    }
+
+    if (numCandidateFrames > (numFrames * MAX_PREFILTER_COVERAGE))
+    {
+        INFO(("The packet pre-filter would leave too much of this video to decode to be of use."));
+        return false;
+    }
+
+    INFO(("The packet pre-filter left %.1f%% of the video to decode, in %u stretches.",
+          (100.0 * numCandidateFrames / numFrames), uint(candidateRanges.size())));
+
+    // Everything outside of the candidate ranges is taken to be inactive.
+    {
+        uint prevEndFrameIdx = 0;
+
+        for (const auto &range: candidateRanges)
+        {
+            this->videoFrameIsActive.set_range(prevEndFrameIdx, range.first, activity_type_e::Inactive);
+            prevEndFrameIdx = range.second;
+        }
+
+        this->videoFrameIsActive.set_range(prevEndFrameIdx, numFrames, activity_type_e::Inactive);
+    }
+
+    // Decode and compare the candidate ranges.
+    std::vector<QVector<uint>> rangeActivityHits(candidateRanges.size());
+    this->process_frame_ranges(candidateRanges.size(), [this, &candidateRanges, &rangeActivityHits](video_decoder_c &video, const uint rangeIdx)
+    {
+        this->mark_video_frame_range(video, candidateRanges[rangeIdx].first, candidateRanges[rangeIdx].second,
+                                     true, rangeActivityHits[rangeIdx], nullptr);
+    });
+
+    if (this->workerThreadsShouldStop)
+    {
+        return true;
+    }
+
+    if (this->keeps_frame_scores())
+    {
+        this->mark_video_frame_activity_from_scores();
+    }
+    else
+    {
+        this->carry_activity_past_ranges(candidateRanges, rangeActivityHits);
+    }
+
+    return true;
 }
 
-// Returns true once the video and audio activity strips have finished
-// processing.
+// Marks the video's frame activity by sampling it sparsely: frames a stride apart
+// are compared, and only the intervals across which they differ get refined down
+// to the frames at which the change happened. The video is split into segments
+// that get sampled in parallel, each from the last frame of the preceding one.
 //
-bool video_activity_c::strip_build_has_finished() const
+void video_activity_c::mark_video_frame_activity_sampled(void)
 {
-    return bool(videoStripThread.isFinished() && audioStripThread.isFinished());
+    const uint numFrames = this->videoInfo.num_frames();
+    const uint numSegments = std::max(1u, std::min(this->num_video_analysis_threads(), (numFrames / MIN_VIDEO_SEGMENT_LENGTH)));
+
+    std::vector<std::pair<uint, uint>> segments(numSegments);
+    for (uint i = 0; i < numSegments; i++)
+    {
+        segments[i].first = ((numFrames / numSegments) * i);
+        segments[i].second = ((i == (numSegments - 1))? numFrames
+                                                      : ((numFrames / numSegments) * (i + 1)));
+    }
+
+    std::vector<QVector<uint>> segmentActivityHits(segments.size());
+    this->process_frame_ranges(segments.size(), [this, &segments, &segmentActivityHits](video_decoder_c &video, const uint segmentIdx)
+    {
+        const bool isFirstSegment = (segments[segmentIdx].first == 0);
+
+        this->mark_video_frame_range_sampled(video,
+                                             (isFirstSegment? 0 : (segments[segmentIdx].first - 1)),
+                                             segments[segmentIdx].second,
+                                             isFirstSegment,
+                                             segmentActivityHits[segmentIdx]);
+    });
+
+    if (this->workerThreadsShouldStop)
+    {
+        return;
+    }
+
+    this->carry_activity_past_ranges(segments, segmentActivityHits);
+
+    return;
 }
 
-// Assumes that the given frame is active; iterates backwards from it to find the
-// frame in which that activity began.
+// Runs the given function on each of the given number of ranges of frames (as
+// identified by their index), sharing the ranges out among worker threads. Each
+// worker takes the next range not yet taken, and keeps one decoder open from one
+// range to the next.
 //
-uint video_activity_c::get_start_of_active_segment(const uint startFrameIdx, const uint videoOrAudio) const
+void video_activity_c::process_frame_ranges(const uint numRanges,
+                                            const std::function<void(video_decoder_c &video, const uint rangeIdx)> &process)
 {
-    uint closest = startFrameIdx;
-    const auto &frameActivity = ((videoOrAudio == 0)? this->videoFrameIsActive
-                                                    : this->audioFrameIsActive);
+    const uint numWorkers = std::max(1u, std::min(this->num_video_analysis_threads(), numRanges));
+    std::atomic<uint> nextRangeIdx(0);
 
-    while (frameActivity.at(closest) == activity_type_e::Active)
+    const std::function<bool(void)> worker = [this, numRanges, &process, &nextRangeIdx]
     {
-        closest--;
-        if (closest == 0) // If reached the end.
+        // On a shared pool, this worker might only get its turn after we've
+        // been asked to stop.
+        if (this->workerThreadsShouldStop)
         {
-            return 0;
+            return true;
         }
-    }
 
-    return (closest + 1);
+        const int priority = this->pooledWork->priority;
+
+        analysis_stats_scope_c statsScope(&this->analysisStats);
+        const std::unique_ptr<video_decoder_c> video(this->open_video());
+
+        for (uint rangeIdx = nextRangeIdx++; rangeIdx < numRanges; rangeIdx = nextRangeIdx++)
+        {
+            if (this->workerThreadsShouldStop)
+            {
+                return true;
+            }
+
+            process(*video, rangeIdx);
+
+            // If the analysis has since been given a lower priority, give the
+            // thread over to any higher-priority work, and carry on with the
+            // remaining ranges on a later turn.
+            if ((this->pooledWork->priority < priority) &&
+                (nextRangeIdx < numRanges))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    };
+
+    this->run_pooled_tasks(std::vector<std::function<bool(void)>>(numWorkers, worker));
+
+    return;
 }
 
-// Calls FFMPEG as an external process to extract the video's audio into an easier-
-// to-process WAV file. This is purely for programmer convenience.
+// Runs the given pieces of work on the analysis' thread pool, at the analysis'
+// priority, and waits for all of them to be done. See pooled_work_queue_s.
 //
-void video_activity_c::extract_audio(void)
+void video_activity_c::run_pooled_tasks(const std::vector<std::function<bool(void)>> &tasks)
 {
-    const QString audioFilename = (this->videoInfo.file_name() + ".wav");
+    QSemaphore tasksDone;
 
-    // Run FFMPEG to extract the audio file. Assumes that the user already has
-    // FFMPEG available on their system, and that it's callable globally. If not,
-    // no audio activity information will be available.
     {
-        QString cmd = QString("ffmpeg -i \"%1\" -flags bitexact -map_metadata -1 -acodec pcm_s16le -ac 1 -y \"%2\"")
-                      .arg(this->videoInfo.file_name())
-                      .arg(audioFilename);
+        std::lock_guard<std::mutex> lock(this->pooledWork->mutex);
 
-        const int ret = system(cmd.toStdString().c_str());
-        if (ret != 0)
+        for (const auto &task: tasks)
         {
-            NBENE(("Failed to extract the video's audio using FFMPEG. Audio information will not be available."));
-            emit message_to_user("The audio track could not be processed.");
-            return;
+            this->pooledWork->tasks.push_back([task, &tasksDone]
+            {
+                if (!task())
+                {
+                    return false;
+                }
+
+                tasksDone.release();
+                return true;
+            });
+
+            pooled_task_runner_c::queue_runner(this->pooledWork);
         }
     }
 
-    // Load the audio file's data into its own object, which we can then process
-    // for activity, later.
-    this->audio = new audio_file_c(audioFilename, this->messager);
-
-    // We can delete the temporary audio file from disk now.
-    QFile(audioFilename).remove();
+    tasksDone.acquire(int(tasks.size()));
 
     return;
 }
 
-// Works through all the audio samples in the video's (extracted) audio track
-// to find ones whose amplitude is notably above the baseline. The corresponding
-// frames in the video will be marked as having acoustic activity.
+// Sets the priority at which the analysis' work runs on its thread pool, relative
+// to the work of other analyses sharing the pool. Work already queued on the pool
+// takes on the new priority, too; and work under way gives up its thread, where
+// it can, on being lowered.
 //
-/// TODO. Cleanup.
-void video_activity_c::mark_audio_frame_activity(void)
+void video_activity_c::set_thread_priority(const int priority)
 {
-    const uint timeGranularity = (this->videoInfo.num_frames() / TIME_GRANULARITY_DIVISOR);
+    std::lock_guard<std::mutex> lock(this->pooledWork->mutex);
 
-    this->extract_audio();
-    if (!this->has_valid_audio())
+    if (priority == this->pooledWork->priority)
     {
-        qFill(this->audioFrameIsActive, activity_type_e::NoData);
         return;
     }
 
-    k_assert(this->has_valid_audio(), "Was asked to mark audio activity, but the audio was not valid.")
-    k_assert((this->videoInfo.num_frames() > 0), "Asked to mark audio activity, but there are no frames to mark it for.");
+    this->pooledWork->priority = priority;
+
+    for (size_t i = 0; i < this->pooledWork->tasks.size(); i++)
+    {
+        pooled_task_runner_c::queue_runner(this->pooledWork);
+    }
+
+    return;
+}
+
+// For ranges of frames whose activity was marked independently of each other:
+// activity near the end of a range would, in a single pass, have caused the
+// frames following it to be skipped over and marked active, too; so mark them.
+//
+void video_activity_c::carry_activity_past_ranges(const std::vector<std::pair<uint, uint>> &ranges,
+                                                  const std::vector<QVector<uint>> &rangeActivityHits)
+{
+    const uint numFrames = this->videoInfo.num_frames();
+    const uint timeGranularity = this->time_granularity();
+
+    for (uint i = 0; i < ranges.size(); i++)
+    {
+        if (!rangeActivityHits[i].isEmpty())
+        {
+            const uint resumeFrameIdx = std::min((rangeActivityHits[i].last() + timeGranularity), numFrames);
+
+            if (resumeFrameIdx > ranges[i].second)
+            {
+                this->videoFrameIsActive.set_range(ranges[i].second, resumeFrameIdx, activity_type_e::Active);
+            }
+        }
+    }
+
+    return;
+}
+
+// Marks the video's frame activity by judging the frames' kept scores under the
+// current thresholds, the frames following an active one being marked active as
+// they are in a sequential pass. Frames that weren't compared (e.g. those outside
+// the packet pre-filter's stretches) are taken to be inactive.
+//
+void video_activity_c::mark_video_frame_activity_from_scores(void)
+{
+    const uint numFrames = this->videoInfo.num_frames();
+    const uint timeGranularity = std::max(1u, this->time_granularity());
+    const std::unique_ptr<motion_detector_c> detector(motion_detector_c::create(this->settings));
+
+    k_assert((uint(this->videoFrameScore.size()) == numFrames), "Asked to mark video activity without the frames' scores.");
 
-    // Get the average and maximum amplitudes in the audio's samples.
-    real avgAmplitude = 0;
-    uint maxAmplitude = 0;
+    activity_timeline_writer_c frameActivity(this->videoFrameIsActive);
+
+    frameActivity.set(0, activity_type_e::Inactive);
+
+    for (uint i = 1; i < numFrames; i++)
     {
-        i64 sumAmplitude = 0;
+        const float score = this->videoFrameScore.at(i);
+        const bool isActive = ((score >= 0) && detector->score_is_active(score));
 
-        for (uint i = 0; i < this->audio->num_samples(); i++)
+        frameActivity.set(i, (isActive? activity_type_e::Active
+                                      : activity_type_e::Inactive));
+
+        // As in a sequential pass, the frames following an active one are marked
+        // active, and the first frame past them is only compared against.
+        if (isActive)
         {
-            const auto &sample = this->audio->sample_at(i);
+            const uint resumeFrameIdx = std::min((i + timeGranularity), numFrames);
 
-            sumAmplitude += sample;
+            frameActivity.set_range(i, resumeFrameIdx, activity_type_e::Active);
+            i = resumeFrameIdx;
 
-            if (abs(sample) > maxAmplitude)
+            if (i < numFrames)
             {
-                maxAmplitude = abs(sample);
+                frameActivity.set(i, activity_type_e::Inactive);
             }
         }
+    }
 
-        avgAmplitude = (sumAmplitude / (real)this->audio->num_samples());
+    return;
+}
+
+// Compares each frame in the range (seedFrameIdx, endFrameIdx) against the frame
+// preceding it, and marks the frames' activity accordingly. The seed frame is
+// only read in to be compared against; it'll be marked as inactive if markSeed is
+// true, and left alone otherwise. The index of each frame at which activity is
+// found gets appended to activityHits.
+//
+// If syncHits is given, it's taken to be the list of activity hits of an earlier
+// pass over this range that began from a different seed frame. Processing then
+// stops on reaching a frame which that earlier pass also compared against its
+// predecessor, since from there on the two passes would produce identical results.
+//
+// If frame scores are being kept, each frame compared gets its score logged; and
+// rather than the frames following an active frame being skipped, they get scored
+// too, though still marked as active.
+//
+// Returns the index of the frame at which processing ended.
+//
+uint video_activity_c::mark_video_frame_range(video_decoder_c &video,
+                                              const uint seedFrameIdx,
+                                              const uint endFrameIdx,
+                                              const bool markSeed,
+                                              QVector<uint> &activityHits,
+                                              const QVector<uint> *const syncHits)
+{
+    k_assert((seedFrameIdx < endFrameIdx), "Was asked to mark an empty range of frames.");
+    k_assert((endFrameIdx <= this->videoInfo.num_frames()), "Was asked to mark frames out of bounds.");
+
+    const uint timeGranularity = this->time_granularity();
+    float *const frameScores = (this->keeps_frame_scores()? this->videoFrameScore.data() : nullptr);
+    int syncHitIdx = 0;
+
+    // The results get committed to the timeline in batches as we go, and the
+    // rest when we return.
+    activity_timeline_writer_c frameActivity(this->videoFrameIsActive);
+
+    // Judge each frame in the range, given the ones before it, to find which
+    // segments of the video contain no activity.
+    const std::unique_ptr<motion_detector_c> detector(motion_detector_c::create(this->settings));
+    cv::Mat thisFrame, prevFrame;
+
+    if (!this->detectorHasBeenLogged.exchange(true))
+    {
+        INFO(("Detecting motion by %s.", detector->name()));
     }
 
-    // Mark the frames based on whether audio corresponding to each frame is
-    // exceeding the average amplitude across the whole audio track.
-    /// Temp hack. Could instead use quartiles or something.
-    const real thresholdAmplitude = ((maxAmplitude - avgAmplitude) * 0.001);
+    video.seek(seedFrameIdx);
+    this->read_comparison_frame(video, seedFrameIdx, thisFrame);
+    detector->reset(thisFrame);
+    if (markSeed)
     {
-        for (uint i = 0; i < this->videoInfo.num_frames(); i++)
+        frameActivity.set(seedFrameIdx, activity_type_e::Inactive);
+    }
+
+    for (uint i = (seedFrameIdx + 1); i < endFrameIdx; i++)
+    {
+        // See whether the earlier pass compared this frame (i.e. whether the frame
+        // was not skipped over following a hit of activity).
+        if (syncHits != nullptr)
         {
-            const uint sampleOffs = ((this->audio->num_samples() / (real)this->videoInfo.num_frames()) * i);
-            const bool loudSample = bool(fabs(this->audio->sample_at(sampleOffs)) > fabs(thresholdAmplitude));
+            while ((syncHitIdx < syncHits->size()) &&
+                   ((syncHits->at(syncHitIdx) + timeGranularity) < i))
+            {
+                syncHitIdx++;
+            }
+
+            if ((syncHitIdx >= syncHits->size()) ||
+                (syncHits->at(syncHitIdx) >= i))
+            {
+                return i;
+            }
+        }
+
+        // The previous frame's buffer gets recycled to receive the new frame.
+        cv::swap(prevFrame, thisFrame);
+        this->read_comparison_frame(video, i, thisFrame);
 
-            this->audioFrameIsActive[i] = loudSample? activity_type_e::Active
-                                                    : activity_type_e::Inactive;
+        k_assert((thisFrame.channels() == prevFrame.channels()),
+                 "Found mismatched frames while reading the video.");
+        k_assert((thisFrame.total() == prevFrame.total()),
+                 "Found mismatched frames while reading the video.");
 
-            if (loudSample)
+        bool isActive = false;
+        {
+            analysis_stage_timer_c timer(analysis_stats_c::stage_e::Comparison);
+
+            if (frameScores != nullptr)
+            {
+                frameScores[i] = detector->activity_score(thisFrame, prevFrame);
+                isActive = detector->score_is_active(frameScores[i]);
+            }
+            else
             {
-                const uint numFramesToSkip = ((i + timeGranularity) > this->videoInfo.num_frames())? (this->videoInfo.num_frames() - i)
-                                                                                                   : timeGranularity;
+                isActive = detector->is_active(thisFrame, prevFrame);
+            }
+        }
+
+        frameActivity.set(i, (isActive? activity_type_e::Active
+                                      : activity_type_e::Inactive));
+
+        // If we get an active frame, assume (for performance reasons) that the
+        // next x frames will also contain activity, so skip through them.
+        if (isActive)
+        {
+            activityHits << i;
+
+            const uint resumeFrameIdx = std::min((i + timeGranularity), endFrameIdx);
 
-                for (uint p = 0; p < numFramesToSkip; (p++, i++))
+            frameActivity.set_range(i, resumeFrameIdx, activity_type_e::Active);
+
+            // When keeping scores, score the frames through to the one we'd resume
+            // from, too, leaving the last of them for the next iteration of the
+            // loop to compare against.
+            if (frameScores != nullptr)
+            {
+                for (uint f = (i + 1); f <= std::min(resumeFrameIdx, (endFrameIdx - 1)); f++)
                 {
-                    this->audioFrameIsActive[i] = activity_type_e::Active;
+                    cv::swap(prevFrame, thisFrame);
+                    this->read_comparison_frame(video, f, thisFrame);
+
+                    analysis_stage_timer_c timer(analysis_stats_c::stage_e::Comparison);
+                    frameScores[f] = detector->activity_score(thisFrame, prevFrame);
                 }
             }
 
-            // Periodically check to make sure the user doesn't want us to stop processing.
-            if (((i % 200) == 0) &&
-                this->workerThreadsShouldStop)
+            i = resumeFrameIdx;
+
+            if (i >= endFrameIdx)
             {
-                return;
+                break;
+            }
+
+            frameActivity.set(i, activity_type_e::Inactive);
+
+            // Skip to the next frame we want to capture, and grab it, so that it
+            // becomes the previous frame on the next iteration of the loop. The
+            // decoder is currently positioned just past the active frame.
+            if (frameScores == nullptr)
+            {
+                this->skip_to_frame(video, (activityHits.last() + 1), i);
+                this->read_comparison_frame(video, i, thisFrame);
+                detector->reset(thisFrame);
             }
         }
+
+        // Periodically check to make sure the user doesn't want us to stop processing.
+        if (((i % 200) == 0) &&
+            this->workerThreadsShouldStop)
+        {
+            return i;
+        }
     }
 
-    return;
+    return endFrameIdx;
 }
 
-bool video_activity_c::frames_differ(const cv::Mat &frame1, const cv::Mat &frame2,
-                                     const u8 threshold)
+// Samples the frames in the range (seedFrameIdx, endFrameIdx) a stride apart,
+// compares each sample against the one before it, and marks the frames' activity
+// accordingly. Where two samples are found to differ, the interval between them
+// gets refined with refine_sampled_interval(). The seed frame and activityHits
+// are treated as in mark_video_frame_range().
+//
+void video_activity_c::mark_video_frame_range_sampled(video_decoder_c &video,
+                                                      const uint seedFrameIdx,
+                                                      const uint endFrameIdx,
+                                                      const bool markSeed,
+                                                      QVector<uint> &activityHits)
 {
-    k_assert(((frame1.rows == frame2.rows) && (frame1.cols == frame2.cols)),
-             "Frame sizes do not match.");
+    k_assert((seedFrameIdx < endFrameIdx), "Was asked to mark an empty range of frames.");
+    k_assert((endFrameIdx <= this->videoInfo.num_frames()), "Was asked to mark frames out of bounds.");
+
+    const uint timeGranularity = this->time_granularity();
+    const uint stride = this->sample_stride();
+
+    activity_timeline_writer_c frameActivity(this->videoFrameIsActive);
+
+    frame_difference_detector_c detector(this->settings.pixelDiffThreshold, this->settings.maskRegions);
+
+    // The sampled frames at the start and the end of the current interval, and the
+    // frames read in to refine it.
+    cv::Mat intervalStartFrame, intervalEndFrame;
+    std::vector<cv::Mat> refinementFrames;
+
+    // The index of the frame the decoder will read next.
+    uint nextFrameIdx = (seedFrameIdx + 1);
 
-    cv::Mat difference = (frame1 - frame2);
+    video.seek(seedFrameIdx);
+    this->read_comparison_frame(video, seedFrameIdx, intervalStartFrame);
+    if (markSeed)
+    {
+        frameActivity.set(seedFrameIdx, activity_type_e::Inactive);
+    }
 
-    for (int y = 0; y < frame1.rows; y++)
+    uint intervalStartIdx = seedFrameIdx;
+    while ((intervalStartIdx + 1) < endFrameIdx)
     {
-        for (int x = 0; x < frame1.cols; x++)
+        const uint intervalEndIdx = std::min((intervalStartIdx + stride), (endFrameIdx - 1));
+
+        this->skip_to_frame(video, nextFrameIdx, intervalEndIdx);
+        this->read_comparison_frame(video, intervalEndIdx, intervalEndFrame);
+        nextFrameIdx = (intervalEndIdx + 1);
+
+        if (!sampled_frames_differ(intervalStartFrame, intervalEndFrame, detector))
         {
-            const auto diffPixel = difference.at<cv::Vec3b>(y, x);
+            frameActivity.set_range((intervalStartIdx + 1), (intervalEndIdx + 1), activity_type_e::Inactive);
+        }
+        else
+        {
+            // Go back to the start of the interval to look for where the change
+            // happened.
+            video.seek(intervalStartIdx + 1);
+            nextFrameIdx = (intervalStartIdx + 1);
+
+            const uint lastHitIdx = this->refine_sampled_interval(video, intervalStartIdx, intervalEndIdx,
+                                                                  intervalStartFrame, intervalEndFrame,
+                                                                  refinementFrames, nextFrameIdx, detector,
+                                                                  frameActivity, activityHits);
+
+            // As in a full pass, assume (for performance reasons) that the next x
+            // frames after activity will also contain activity, so skip through
+            // them.
+            const uint resumeFrameIdx = std::min((lastHitIdx + timeGranularity), endFrameIdx);
 
-            if ((abs(diffPixel[0]) > threshold) ||
-                (abs(diffPixel[1]) > threshold) ||
-                (abs(diffPixel[2]) > threshold))
+            frameActivity.set_range(lastHitIdx, resumeFrameIdx, activity_type_e::Active);
+
+            if (resumeFrameIdx > (intervalEndIdx + 1))
             {
-                return true;
+                if (resumeFrameIdx >= endFrameIdx)
+                {
+                    break;
+                }
+
+                // Resume sampling from the first frame past the skipped ones.
+                frameActivity.set(resumeFrameIdx, activity_type_e::Inactive);
+                this->skip_to_frame(video, nextFrameIdx, resumeFrameIdx);
+                this->read_comparison_frame(video, resumeFrameIdx, intervalStartFrame);
+                nextFrameIdx = (resumeFrameIdx + 1);
+                intervalStartIdx = resumeFrameIdx;
+
+                continue;
             }
         }
+
+        // The interval's start frame's buffer gets recycled to receive the next
+        // interval's end frame.
+        cv::swap(intervalStartFrame, intervalEndFrame);
+        intervalStartIdx = intervalEndIdx;
+
+        if (this->workerThreadsShouldStop)
+        {
+            return;
+        }
     }
 
-    return false;
+    return;
 }
 
-// Compares the video's frames in pairs, and marks a given frame as active if
-// its color values differ notably from those of the preceding frame.
+// Finds the frames in the interval (startFrameIdx, endFrameIdx) at which the
+// video changed, given that the interval's end frames (startFrame and endFrame)
+// differ, and marks the interval's frames' activity accordingly.
 //
-void video_activity_c::mark_video_frame_activity(void)
+// The interval is divided into cells of frames by halving it as many times as
+// the refinement depth allows, or down to single frames, and the frames at the
+// cells' boundaries are read in, in a single forward pass from nextFrameIdx
+// (which gets updated to match). The interval is then bisected over the cell
+// boundaries, descending only into halves whose end frames differ by the given
+// detector; each cell reached this way is marked active, with its first frame
+// logged in activityHits. Should neither half of a differing stretch differ by
+// itself (i.e. the change was too gradual to notice between any closer pair of
+// frames), the whole stretch is taken to be active.
+//
+// Returns the index of the last frame logged as a hit.
+//
+uint video_activity_c::refine_sampled_interval(video_decoder_c &video,
+                                               const uint startFrameIdx,
+                                               const uint endFrameIdx,
+                                               const cv::Mat &startFrame,
+                                               const cv::Mat &endFrame,
+                                               std::vector<cv::Mat> &boundaryFrames,
+                                               uint &nextFrameIdx,
+                                               frame_difference_detector_c &detector,
+                                               activity_timeline_writer_c &frameActivity,
+                                               QVector<uint> &activityHits)
 {
-    const uint timeGranularity = (this->videoInfo.num_frames() / TIME_GRANULARITY_DIVISOR);
+    k_assert((startFrameIdx < endFrameIdx), "Was asked to refine an empty interval.");
 
-    cv::VideoCapture video(this->videoInfo.file_name().toStdString());
-    k_assert(video.isOpened(), "Failed to open the video file in OpenCV.");
+    const uint length = (endFrameIdx - startFrameIdx);
+    const uint cellLength = std::max(1u, (length >> std::min(31u, this->settings.sampleRefinementDepth)));
+    const uint numCells = ((length + cellLength - 1) / cellLength);
 
-    // Compare each frame in the video to the previous one to find which segments
-    // of the video contain no activity, i.e. between which no single pixel varies
-    // by more than the allowed threshold.
+    // The frames at the cell boundaries strictly inside the interval. The end
+    // frames are kept separate, so that reading into these buffers never
+    // overwrites them.
+    boundaryFrames.resize(std::max(boundaryFrames.size(), size_t(numCells)));
+    for (uint i = 1; i < numCells; i++)
     {
-        cv::Mat thisFrame, prevFrame;
+        const uint frameIdx = (startFrameIdx + (i * cellLength));
 
-        video.set(CV_CAP_PROP_POS_FRAMES, 0);
-        video >> thisFrame;
-        this->videoFrameIsActive[0] = activity_type_e::Inactive;
+        this->skip_to_frame(video, nextFrameIdx, frameIdx);
+        this->read_comparison_frame(video, frameIdx, boundaryFrames[i]);
+        nextFrameIdx = (frameIdx + 1);
+    }
 
-        for (uint i = 1; i < this->videoInfo.num_frames(); i++)
-        {
-            prevFrame = thisFrame.clone();
-            video >> thisFrame;
+    const auto boundary_frame_idx = [=](const uint boundaryIdx)->uint
+    {
+        return ((boundaryIdx == numCells)? endFrameIdx : (startFrameIdx + (boundaryIdx * cellLength)));
+    };
 
-            k_assert((thisFrame.channels() == 3),
-                     "Expected three colors channels in the video frame.");
-            k_assert((thisFrame.channels() == prevFrame.channels()),
-                     "Found mismatched frames while reading the video.");
-            k_assert((thisFrame.total() == size_t(this->videoInfo.width() * this->videoInfo.height())),
-                     "Encountered a frame with an unexpected size.");
-            k_assert((thisFrame.total() == prevFrame.total()),
-                     "Found mismatched frames while reading the video.");
+    const auto boundary_frame = [&](const uint boundaryIdx)->const cv::Mat&
+    {
+        return ((boundaryIdx == 0)? startFrame : ((boundaryIdx == numCells)? endFrame : boundaryFrames[boundaryIdx]));
+    };
 
-            this->videoFrameIsActive[i] = frames_differ(thisFrame, prevFrame, 30)? activity_type_e::Active
-                                                                                 : activity_type_e::Inactive;
+    // Bisects the stretch between the given cell boundaries, whose frames are known
+    // to differ.
+    std::function<void(const uint, const uint)> bisect = [&](const uint firstBoundaryIdx, const uint lastBoundaryIdx)
+    {
+        const uint midBoundaryIdx = ((firstBoundaryIdx + lastBoundaryIdx) / 2);
+        const bool firstHalfDiffers = ((lastBoundaryIdx - firstBoundaryIdx) > 1) &&
+                                      sampled_frames_differ(boundary_frame(firstBoundaryIdx), boundary_frame(midBoundaryIdx), detector);
+        const bool lastHalfDiffers = ((lastBoundaryIdx - firstBoundaryIdx) > 1) &&
+                                     sampled_frames_differ(boundary_frame(midBoundaryIdx), boundary_frame(lastBoundaryIdx), detector);
 
-            // If we get an active frame, assume (for performance reasons) that the
-            // next x frames will also contain activity, so skip through them.
-            if (this->videoFrameIsActive[i] == activity_type_e::Active)
-            {
-                const uint numFramesToSkip = ((i + timeGranularity) > this->videoInfo.num_frames())? (this->videoInfo.num_frames() - i)
-                                                                                                   : timeGranularity;
+        if (!firstHalfDiffers &&
+            !lastHalfDiffers)
+        {
+            const uint firstActiveIdx = (boundary_frame_idx(firstBoundaryIdx) + 1);
 
-                for (uint p = 0; p < numFramesToSkip; (p++, i++))
-                {
-                    this->videoFrameIsActive[i] = activity_type_e::Active;
-                }
+            frameActivity.set_range(firstActiveIdx, (boundary_frame_idx(lastBoundaryIdx) + 1), activity_type_e::Active);
+            activityHits << firstActiveIdx;
 
-                // Seek to the next frame we want to capture, and grab it, so that it
-                // becomes the previous frame on the next iteration of the loop.
-                this->videoFrameIsActive[i] = activity_type_e::Inactive;
-                video.set(CV_CAP_PROP_POS_FRAMES, i);
-                video >> thisFrame;
-            }
+            return;
+        }
 
-            // Periodically check to make sure the user doesn't want us to stop processing.
-            if (((i % 200) == 0) &&
-                this->workerThreadsShouldStop)
-            {
-                return;
-            }
+        if (firstHalfDiffers)
+        {
+            bisect(firstBoundaryIdx, midBoundaryIdx);
+        }
+        else
+        {
+            frameActivity.set_range((boundary_frame_idx(firstBoundaryIdx) + 1), (boundary_frame_idx(midBoundaryIdx) + 1),
+                                    activity_type_e::Inactive);
         }
-    }
 
-    k_assert(uint(this->videoFrameIsActive.size()) == this->videoInfo.num_frames(), "Some frames were skipped while marking activity.");
+        if (lastHalfDiffers)
+        {
+            bisect(midBoundaryIdx, lastBoundaryIdx);
+        }
+        else
+        {
+            frameActivity.set_range((boundary_frame_idx(midBoundaryIdx) + 1), (boundary_frame_idx(lastBoundaryIdx) + 1),
+                                    activity_type_e::Inactive);
+        }
 
-    return;
+        return;
+    };
+
+    bisect(0, numCells);
+
+    return activityHits.last();
 }
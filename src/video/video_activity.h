@@ -7,18 +7,220 @@
 #ifndef VIDEO_FRAME_ACTIVITY_H
 #define VIDEO_FRAME_ACTIVITY_H
 
+#include <QThreadPool>
 #include <QFuture>
 #include <QObject>
+#include <functional>
 #include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "../../src/video/activity_timeline.h"
+#include "../../src/video/thumbnail_sheet.h"
+#include "../../src/video/activity_mask.h"
+#include "../../src/video/analysis_stats.h"
 #include "../../src/video/video_info.h"
+#include "../../src/audio/audio_decoder.h"
 #include "../../src/audio/audio_file.h"
 #include "../../src/common.h"
 
+class frame_difference_detector_c;
+class activity_cache_c;
+class video_decoder_c;
+struct pooled_work_queue_s;
+
 namespace cv
 {
     class Mat;
 }
 
+// User-adjustable parameters that control how video_activity_c goes about
+// computing the video's activity.
+struct video_activity_settings_s
+{
+    // How to work through the video's frames when looking for visual activity.
+    enum class video_analysis_mode_e
+    {
+        Sequential, // Decode and compare the whole video in one pass on one thread.
+        Segmented,  // Split the video into segments, each decoded and compared on its own thread.
+        Sampled,    // Compare frames a stride apart, refining only the intervals across which they differ.
+    } videoAnalysisMode = video_analysis_mode_e::Segmented;
+
+    // In sampled analysis, the time in seconds between the frames compared; and
+    // how many times an interval across which they differ may be halved in looking
+    // for the frames at which the change happened. At the default depth, strides
+    // of up to 32 frames get refined down to single frames. Each level of depth
+    // doubles the number of frames a worker thread may hold in memory at once, which
+    // in precise comparison mode can add up.
+    real sampleStrideSeconds = 1;
+    uint sampleRefinementDepth = 5;
+
+    // How to tell whether a frame shows activity. Sampled analysis always goes by
+    // frame differences, as its comparisons are between frames a stride apart.
+    // The background model always compares proxies (see videoComparisonMode), its
+    // per-sample running average being too costly to keep of full-color frames.
+    enum class motion_detector_e
+    {
+        FrameDifference, // A frame is active if any of its pixels differs notably from the previous frame's.
+        BackgroundModel, // A frame is active if enough of some tile of it differs notably from a running average of the frames before it.
+    } motionDetector = motion_detector_e::FrameDifference;
+
+    // The difference in value needed for two samples (color channels of a pixel)
+    // to count as differing: between a frame and the one before it, or, for the
+    // background model, between a frame and the background.
+    u8 pixelDiffThreshold = 30;
+
+    // The regions of the frame in which to look for visual activity, or not to;
+    // see activity_mask_c. With none, all of the frame gets looked at.
+    QVector<activity_mask_region_s> maskRegions;
+
+    // For the background model: the weight given to each new frame in the running
+    // average, i.e. how quickly the background adapts to changes in the scene; the
+    // size of the tiles, in pixels per side; and the fraction of a tile's samples
+    // that need to differ notably from the background for the frame to be active.
+    real backgroundLearningRate = 0.05;
+    uint backgroundTileSize = 16;
+    real backgroundTileMinForeground = 0.05;
+
+    // For how long, in seconds, activity in a frame causes the frames following it
+    // to be marked as active, too. A value of 0 means 1/50th of the video's length.
+    real activityHoldSeconds = 0;
+
+    // The maximum number of threads to use in segmented video analysis. A value
+    // of 0 means to use as many threads as there are CPU cores (or as the shared
+    // thread pool has, if one is given).
+    uint numVideoAnalysisThreads = 0;
+
+    // If set, the segments of segmented video analysis get run on this pool -
+    // e.g. one shared by several videos being analyzed at once - rather than on
+    // one of the video's own. Its work is queued on the pool with the given
+    // priority, which can be changed as the analysis goes on (see
+    // video_activity_c::set_thread_priority()); higher-priority work gets run
+    // first.
+    QThreadPool *sharedThreadPool = nullptr;
+    int threadPriority = 0;
+
+    // In what form to compare the video's frames with each other.
+    enum class video_comparison_mode_e
+    {
+        Precise, // Compare every pixel of the frames in full color.
+        Proxy,   // Compare downscaled versions of the frames' luma.
+    } videoComparisonMode = video_comparison_mode_e::Precise;
+
+    // The resolution to which frames are downscaled in proxy comparison mode.
+    uint proxyWidth = 160;
+    uint proxyHeight = 90;
+
+    // What to decode the video's frames with for analysis. The hardware backends
+    // are only used in proxy comparison mode, and fall back to the software one
+    // if their device isn't available or can't decode the video.
+    enum class video_decode_backend_e
+    {
+        Software,     // OpenCV's default software decoding.
+        Auto,         // The first of the hardware backends below that's available for the video.
+        Vaapi,        // VA-API, e.g. on Intel and AMD GPUs under Linux.
+        Nvdec,        // NVDEC, on NVIDIA GPUs.
+        Qsv,          // Intel Quick Sync Video.
+        VideoToolbox, // VideoToolbox, on macOS.
+    } videoDecodeBackend = video_decode_backend_e::Software;
+
+    // How many frames the video decoder may get ahead of the comparisons, decoding
+    // on a thread of its own. Each frame ahead takes up a frame buffer per analysis
+    // thread (about 6 MB at 1080p in precise comparison mode). A value of 0 means
+    // to decode on the comparing thread, as needed.
+    uint numDecodeAheadFrames = 3;
+
+    // How to skip over the frames that follow a frame found to be active.
+    enum class video_skip_policy_e
+    {
+        Seek,     // Always seek to the frame after the skipped ones.
+        Grab,     // Always decode through the skipped frames, discarding them.
+        Adaptive, // Seek if skipping more than a keyframe interval's worth of frames, else decode through.
+    } videoSkipPolicy = video_skip_policy_e::Adaptive;
+
+    // The assumed number of frames between keyframes in the video, for the adaptive
+    // skip policy. OpenCV doesn't tell us the actual interval; 250 is the default
+    // maximum of common H.264 encoders.
+    uint keyframeInterval = 250;
+
+    // Whether to first scan the sizes of the video's compressed frames, which
+    // needs no decoding, and then decode and compare only the stretches around
+    // frames notably larger than is typical for the video, taking the rest to be
+    // inactive. Much faster on mostly static footage, but activity too slight to
+    // enlarge the compressed frames goes unnoticed.
+    bool usePacketPrefilter = false;
+
+    // How many median absolute deviations above the median size a compressed
+    // (predicted) frame needs to be to mark a stretch for decoding; and how much
+    // of the video, in seconds, around each such frame to decode.
+    real prefilterThresholdDeviations = 3;
+    real prefilterMarginSeconds = 1;
+
+    // How to decode the video's audio track.
+    enum class audio_decoder_e
+    {
+        Native,         // Decode in-process via FFmpeg's libraries, streaming the samples.
+        ExternalFfmpeg, // Have the FFmpeg program extract the audio into a temporary WAV file.
+    } audioDecoder = audio_decoder_e::Native;
+
+    // How to measure the loudness of the audio within each video frame.
+    enum class audio_energy_measure_e
+    {
+        Rms,    // The root mean square of the frame's samples.
+        Peak,   // The largest magnitude among the frame's samples.
+    } audioEnergyMeasure = audio_energy_measure_e::Rms;
+
+    // How many median absolute deviations above the median loudness a frame's
+    // audio needs to be for the frame to count as active.
+    real audioThresholdDeviations = 5;
+
+    // Whether to keep, for each frame, the score it was judged by (see
+    // motion_detector_c::activity_score()), so that the video's activity can later
+    // be re-judged under other thresholds - the pixel difference threshold (for the
+    // frame difference detector), the tiles' minimum foreground, the activity hold,
+    // and the audio's threshold - without having to analyze the video again (see
+    // video_activity_c::rethreshold()). Every frame then gets decoded and scored,
+    // none being skipped after an active one, which makes for a slower analysis;
+    // and the background model goes unreset after an active frame, which can make
+    // its results differ a little from those of an analysis without scores. Has no
+    // effect in sampled analysis, whose frames aren't all compared.
+    bool keepFrameScores = false;
+
+    // Whether to make thumbnails of the video's frames as they get decoded for the
+    // analysis (see thumbnail_sheet_c), for previewing the video by. In proxy
+    // comparison mode, they're of the frames' luma only. If the video's activity
+    // gets loaded from a cache entry that has no thumbnails, there'll be none.
+    bool keepThumbnails = false;
+
+    // Whether to store the results of the analysis on disk, and to look for results
+    // stored earlier before analyzing a video.
+    bool useActivityCache = true;
+
+    // If set, the timings of each of the analysis' stages get logged as it runs,
+    // and written into this file once it's done, as a trace that Chrome's trace
+    // viewer and Perfetto can show. Takes up memory in proportion to the video's
+    // length (some tens of MB for an hour), so is best left off unless needed.
+    QString traceFileName;
+};
+
+// How far along the analysis of a video is.
+struct video_activity_progress_s
+{
+    uint numFrames = 0;
+
+    // How many of the frames have had their activity on each track worked out.
+    uint numVideoFramesDone = 0;
+    uint numAudioFramesDone = 0;
+
+    // How long the analysis has been running for, or took; and how much longer it
+    // can be expected to take, as extrapolated from its progress so far, or -1
+    // while there's no progress yet to go by.
+    real elapsedSeconds = 0;
+    real etaSeconds = -1;
+
+    bool isFinished = false;
+};
+
 class video_activity_c : public QObject
 {
     Q_OBJECT
@@ -26,38 +228,110 @@ class video_activity_c : public QObject
     friend class video_object_c;
 
 public:
-    video_activity_c(const video_info_c &sourceVideo, const messager_c *const messager);
+    video_activity_c(const video_info_c &sourceVideo, const message_sink_c *const messager,
+                     const video_activity_settings_s &settings = video_activity_settings_s());
     ~video_activity_c(void);
 
     bool is_active_frame_at(const uint offs, const uint videoOrAudioOrBoth = 2/*2 means both*/) const;
 
     bool has_valid_audio(void) const;
 
+    uint audio_sample_rate(void) const;
+
+    const activity_timeline_c& frame_activity(const uint videoOrAudio) const;
+
+    const thumbnail_sheet_c& thumbnails(void) const;
+
     bool strip_build_has_finished(void) const;
 
+    video_activity_progress_s progress(void) const;
+
+    const analysis_stats_c& stats(void) const;
+
+    bool has_frame_scores(void) const;
+
+    bool rethreshold(const video_activity_settings_s &thresholds);
+
+    void set_thread_priority(const int priority);
+
     uint get_start_of_active_segment(const uint startFrameIdx, const uint videoOrAudio) const;
 
-    // One of these identifiers will be assigned to each frame.
-    enum class activity_type_e
-    {
-        NoData = -2,        // When we don't have data for this frame (e.g. for sound frames when no sound is present on the video).
-        Uninitialized = -1, // The frame's activity type hasn't yet been computed.
-        Inactive = 0,       // This frame doesn't differ notably from the previous one.
-        Active = 1,         // This frame differs notably from the previous one.
-    };
+    bool get_next_active_segment(const uint frameIdx, const uint videoOrAudioOrBoth, uint &segmentStartIdx) const;
+
+    bool get_previous_active_segment(const uint frameIdx, const uint videoOrAudioOrBoth, uint &segmentStartIdx) const;
+
+    std::vector<std::pair<uint, uint>> active_segments(const uint videoOrAudioOrBoth) const;
+
+    typedef activity_timeline_c::activity_type_e activity_type_e;
 
 signals:
     void message_to_user(const QString message);
 
 private:
     void mark_video_frame_activity(void);
+    void mark_video_frame_activity_sequential(void);
+    void mark_video_frame_activity_segmented(void);
+    bool mark_video_frame_activity_prefiltered(void);
+    void mark_video_frame_activity_sampled(void);
     void mark_audio_frame_activity(void);
+    void mark_video_frame_activity_from_scores(void);
+    void mark_audio_frame_activity_from_energies(void);
+
+    uint mark_video_frame_range(video_decoder_c &video, const uint seedFrameIdx, const uint endFrameIdx, const bool markSeed,
+                                QVector<uint> &activityHits, const QVector<uint> *const syncHits);
+
+    void mark_video_frame_range_sampled(video_decoder_c &video, const uint seedFrameIdx, const uint endFrameIdx, const bool markSeed,
+                                        QVector<uint> &activityHits);
+
+    uint refine_sampled_interval(video_decoder_c &video, const uint startFrameIdx, const uint endFrameIdx,
+                                 const cv::Mat &startFrame, const cv::Mat &endFrame, std::vector<cv::Mat> &boundaryFrames,
+                                 uint &nextFrameIdx, frame_difference_detector_c &detector,
+                                 activity_timeline_writer_c &frameActivity, QVector<uint> &activityHits);
+
+    void process_frame_ranges(const uint numRanges, const std::function<void(video_decoder_c &video, const uint rangeIdx)> &process);
+
+    void run_pooled_tasks(const std::vector<std::function<bool(void)>> &tasks);
+
+    void carry_activity_past_ranges(const std::vector<std::pair<uint, uint>> &ranges, const std::vector<QVector<uint>> &rangeActivityHits);
+
+    video_decoder_c* open_video(void) const;
+
+    void skip_to_frame(video_decoder_c &video, const uint nextFrameIdx, const uint targetFrameIdx) const;
+
+    void read_comparison_frame(video_decoder_c &video, const uint frameIdx, cv::Mat &frame);
+
+    uint time_granularity(void) const;
 
-    bool frames_differ(const cv::Mat &frame1, const cv::Mat &frame2, const u8 threshold);
+    bool keeps_frame_scores(void) const;
+
+    uint sample_stride(void) const;
+
+    uint num_video_analysis_threads(void) const;
+
+    QByteArray settings_signature(void) const;
+
+    bool look_up_cached_activity(void);
+
+    bool load_cached_activity(void);
+
+    void save_activity_to_cache(void) const;
+
+    void analysis_worker_finished(void);
 
     // For each frame in the video, whether there's visual or acoustic activity.
-    QVector<activity_type_e> videoFrameIsActive;
-    QVector<activity_type_e> audioFrameIsActive;
+    activity_timeline_c videoFrameIsActive;
+    activity_timeline_c audioFrameIsActive;
+
+    // For each frame in the video, the loudness of its audio.
+    QVector<float> audioFrameEnergy;
+
+    // If frame scores are being kept, the score of each frame in the video against
+    // the one before it, or -1 for frames that weren't compared; otherwise, empty.
+    QVector<float> videoFrameScore;
+
+    // If thumbnails are being kept, a thumbnail for each stretch of the video's
+    // frames; otherwise, empty.
+    thumbnail_sheet_c videoThumbnails;
 
     // For threading frame analysis.
     QFuture<void> videoStripThread;
@@ -66,14 +340,50 @@ private:
     // Set to true to signal to any worker threads to quit their stuff.
     std::atomic<bool> workerThreadsShouldStop;
 
-    const messager_c *const messager;
+    // Set to true once the first of the analysis' motion detectors has said which
+    // it is.
+    std::atomic<bool> detectorHasBeenLogged;
+
+    // Set to true once the audio track has been decoded.
+    std::atomic<bool> audioIsValid;
+
+    // The sample rate of the audio track, once it's been decoded by this analysis;
+    // until then, or if its results came from the cache, 0.
+    std::atomic<uint> audioSampleRate;
+
+    // How many of the analysis worker threads have finished.
+    std::atomic<uint> numFinishedWorkers;
+
+    // Where the results of the analysis get stored for later reuse, if at all.
+    // Gets opened by the analysis workers, as they start.
+    activity_cache_c *activityCache = nullptr;
+
+    // For the analysis workers to look for earlier results in the cache once
+    // between them; and whether they found any.
+    std::once_flag cacheLookupOnce;
+    bool activityWasCached = false;
+
+    // The counts and timings of the analysis' stages.
+    analysis_stats_c analysisStats;
+
+    const message_sink_c *const messager;
+
+    // Only the thresholds may change, and only once the analysis has finished
+    // (see rethreshold()).
+    video_activity_settings_s settings;
+
+    // The pool the analysis' work runs on, unless it's been given a shared one.
+    QThreadPool ownThreadPool;
+
+    // The analysis' work waiting for its turn on the pool, and the priority at
+    // which it's to be run.
+    std::shared_ptr<pooled_work_queue_s> pooledWork;
 
     const video_info_c &videoInfo;
 
-    // The video's audio as a separate WAV data object.
-    audio_file_c *audio = nullptr;
+    bool extract_audio(const QString &audioFilename);
 
-    void extract_audio(void);
+    bool decode_audio(const audio_sample_sink_f &sampleSink, uint &sampleRate);
 };
 
 #endif
@@ -0,0 +1,801 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors
+ *
+ * Decoders of video frames for activity analysis. The software decoder goes
+ * through OpenCV; the hardware one through FFmpeg's hwaccel API, which lets the
+ * frames' luma be read off the decoded surfaces with only the luma plane ever
+ * being touched by the CPU - and, where the surfaces can be mapped into memory,
+ * without copying the whole surface over first.
+ *
+ * Either can be run behind a pipelined decoder, which decodes ahead of the reader
+ * on a thread of its own.
+ *
+ */
+
+extern "C"
+{
+    #include <libavformat/avformat.h>
+    #include <libavcodec/avcodec.h>
+    #include <libavutil/hwcontext.h>
+    #include <libavutil/pixdesc.h>
+    #include <libavutil/avutil.h>
+}
+
+#include <QByteArray>
+#include <QVector>
+#include <algorithm>
+#include <opencv2/imgproc/imgproc.hpp>
+#include "../../src/video/analysis_stats.h"
+#include "../../src/video/video_decoder.h"
+#include "../../src/video/video_activity.h"
+#include "../../src/video/video_info.h"
+#include "../../src/common.h"
+
+// FFmpeg's API for hooking hardware devices up to its decoders arrived in
+// version 4.0; against older versions, only software decoding is available.
+#define HARDWARE_DECODING_IS_SUPPORTED (LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(58, 18, 100))
+
+video_decoder_c::~video_decoder_c()
+{
+    return;
+}
+
+// Returns a new decoder of the backend asked for in the settings, if it's available
+// for the video, or else of the software backend.
+//
+static video_decoder_c* create_backend_decoder(const video_info_c &videoInfo, const video_activity_settings_s &settings)
+{
+    typedef video_activity_settings_s::video_decode_backend_e decode_backend_e;
+
+    // The FFmpeg names of the hardware device types to try, in order.
+    QVector<const char*> deviceTypeNames;
+
+    switch (settings.videoDecodeBackend)
+    {
+        case decode_backend_e::Software: break;
+        case decode_backend_e::Vaapi: deviceTypeNames << "vaapi"; break;
+        case decode_backend_e::Nvdec: deviceTypeNames << "cuda"; break;
+        case decode_backend_e::Qsv: deviceTypeNames << "qsv"; break;
+        case decode_backend_e::VideoToolbox: deviceTypeNames << "videotoolbox"; break;
+        case decode_backend_e::Auto:
+        {
+            #ifdef __APPLE__
+                deviceTypeNames << "videotoolbox";
+            #else
+                deviceTypeNames << "cuda" << "vaapi" << "qsv";
+            #endif
+
+            break;
+        }
+        default: k_assert(0, "Unknown video decode backend."); break;
+    }
+
+    // The hardware decoder only produces luma proxies.
+    if (settings.videoComparisonMode != video_activity_settings_s::video_comparison_mode_e::Proxy)
+    {
+        deviceTypeNames.clear();
+    }
+
+    for (const char *const deviceTypeName: deviceTypeNames)
+    {
+        hardware_video_decoder_c *const decoder = new hardware_video_decoder_c(videoInfo, settings, deviceTypeName);
+
+        if (decoder->is_open())
+        {
+            return decoder;
+        }
+
+        delete decoder;
+    }
+
+    return new software_video_decoder_c(videoInfo, settings);
+}
+
+video_decoder_c* video_decoder_c::create(const video_info_c &videoInfo, const video_activity_settings_s &settings)
+{
+    video_decoder_c *const decoder = create_backend_decoder(videoInfo, settings);
+
+    if (decoder->is_open() &&
+        (settings.numDecodeAheadFrames > 0))
+    {
+        return new pipelined_video_decoder_c(decoder, settings.numDecodeAheadFrames);
+    }
+
+    return decoder;
+}
+
+software_video_decoder_c::software_video_decoder_c(const video_info_c &videoInfo, const video_activity_settings_s &settings) :
+    settings(settings),
+    videoInfo(videoInfo)
+{
+    this->video.open(this->videoInfo.file_name().toStdString());
+
+    // Proxy comparison only needs the frames' luma, so ask the decoder to give us
+    // the frames in their native format rather than converted to BGR. Not all
+    // decoders will oblige, but read() copes with either case.
+    if (this->video.isOpened() &&
+        (this->settings.videoComparisonMode == video_activity_settings_s::video_comparison_mode_e::Proxy))
+    {
+        this->video.set(CV_CAP_PROP_CONVERT_RGB, 0);
+    }
+
+    return;
+}
+
+bool software_video_decoder_c::is_open() const
+{
+    return this->video.isOpened();
+}
+
+const char* software_video_decoder_c::backend_name() const
+{
+    return "software";
+}
+
+bool software_video_decoder_c::seek(const uint frameIdx)
+{
+    analysis_stage_timer_c timer(analysis_stats_c::stage_e::Seek);
+
+    return this->video.set(CV_CAP_PROP_POS_FRAMES, frameIdx);
+}
+
+bool software_video_decoder_c::grab()
+{
+    analysis_stage_timer_c timer(analysis_stats_c::stage_e::Decode);
+
+    return this->video.grab();
+}
+
+// Decodes the frame and then retrieves it, which is what VideoCapture::read()
+// would do, but kept apart here so that the two can be timed separately; the
+// retrieving being where OpenCV converts the frame into BGR.
+//
+bool software_video_decoder_c::read(cv::Mat &frame)
+{
+    if (!this->grab())
+    {
+        return false;
+    }
+
+    analysis_stage_timer_c timer(analysis_stats_c::stage_e::ColorConversion);
+
+    switch (this->settings.videoComparisonMode)
+    {
+        case video_activity_settings_s::video_comparison_mode_e::Precise:
+        {
+            if (!this->video.retrieve(frame) ||
+                frame.empty())
+            {
+                return false;
+            }
+
+            k_assert((frame.channels() == 3),
+                     "Expected three colors channels in the video frame.");
+            k_assert((frame.total() == size_t(this->videoInfo.width() * this->videoInfo.height())),
+                     "Encountered a frame with an unexpected size.");
+
+            break;
+        }
+        case video_activity_settings_s::video_comparison_mode_e::Proxy:
+        {
+            if (!this->video.retrieve(this->decodeBuffer) ||
+                this->decodeBuffer.empty())
+            {
+                return false;
+            }
+
+            k_assert(((uint(this->decodeBuffer.cols) == this->videoInfo.width()) &&
+                      (uint(this->decodeBuffer.rows) >= this->videoInfo.height())),
+                     "Encountered a frame with an unexpected size.");
+
+            const cv::Size proxySize(this->settings.proxyWidth, this->settings.proxyHeight);
+
+            switch (this->decodeBuffer.channels())
+            {
+                // Planar YUV (or plain grayscale), in which case the luma plane is
+                // at the top of the frame, and the chroma planes can be ignored.
+                case 1:
+                {
+                    const cv::Mat lumaPlane = this->decodeBuffer(cv::Rect(0, 0, this->videoInfo.width(), this->videoInfo.height()));
+                    cv::resize(lumaPlane, frame, proxySize, 0, 0, cv::INTER_AREA);
+                    break;
+                }
+
+                // Packed YUV 4:2:2, in which luma is the first of each pixel's two channels.
+                case 2:
+                {
+                    cv::resize(this->decodeBuffer, this->scaleBuffer, proxySize, 0, 0, cv::INTER_AREA);
+                    cv::extractChannel(this->scaleBuffer, frame, 0);
+                    break;
+                }
+
+                // BGR, from which luma still needs to be computed. Doing so after
+                // the downscaling means converting only a fraction of the pixels.
+                case 3:
+                {
+                    cv::resize(this->decodeBuffer, this->scaleBuffer, proxySize, 0, 0, cv::INTER_AREA);
+                    cv::cvtColor(this->scaleBuffer, frame, cv::COLOR_BGR2GRAY);
+                    break;
+                }
+
+                default: k_assert(0, "Encountered a frame with an unsupported pixel format."); break;
+            }
+
+            break;
+        }
+        default: k_assert(0, "Unknown video comparison mode."); break;
+    }
+
+    return true;
+}
+
+// Picks, from among the pixel formats the decoder offers for the video, that of
+// the device's surfaces. If the device can't decode this video, its format won't
+// be on offer, and decoding fails.
+//
+static AVPixelFormat pick_surface_format(AVCodecContext *codecContext, const AVPixelFormat *formats)
+{
+    const int surfacePixelFormat = *(const int*)codecContext->opaque;
+
+    for (const AVPixelFormat *format = formats; *format != AV_PIX_FMT_NONE; format++)
+    {
+        if (*format == surfacePixelFormat)
+        {
+            return *format;
+        }
+    }
+
+    return AV_PIX_FMT_NONE;
+}
+
+// Leaves the decoder closed if the device isn't available or can't decode this
+// video.
+//
+hardware_video_decoder_c::hardware_video_decoder_c(const video_info_c &videoInfo, const video_activity_settings_s &settings,
+                                                   const char *const deviceTypeName) :
+    deviceTypeName(deviceTypeName),
+    settings(settings)
+{
+    #if HARDWARE_DECODING_IS_SUPPORTED
+        const QByteArray filename = videoInfo.file_name().toUtf8();
+
+        const AVHWDeviceType deviceType = av_hwdevice_find_type_by_name(deviceTypeName);
+        if (deviceType == AV_HWDEVICE_TYPE_NONE)
+        {
+            DEBUG(("This build of FFmpeg doesn't support %s decoding.", deviceTypeName));
+            return;
+        }
+
+        if (avformat_open_input(&this->formatContext, filename.constData(), nullptr, nullptr) < 0)
+        {
+            NBENE(("Failed to open '%s' for video decoding.", filename.constData()));
+            this->formatContext = nullptr;
+            return;
+        }
+
+        if (avformat_find_stream_info(this->formatContext, nullptr) < 0)
+        {
+            NBENE(("Failed to find stream information in '%s'.", filename.constData()));
+            return;
+        }
+
+        this->streamIdx = av_find_best_stream(this->formatContext, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+        if (this->streamIdx < 0)
+        {
+            NBENE(("No video stream found in '%s'.", filename.constData()));
+            return;
+        }
+
+        const AVCodecParameters *const codecParams = this->formatContext->streams[this->streamIdx]->codecpar;
+        const AVCodec *codec = nullptr;
+
+        // QSV decodes via dedicated decoders (e.g. h264_qsv), whereas the other
+        // devices plug into FFmpeg's native decoders.
+        if (deviceType == AV_HWDEVICE_TYPE_QSV)
+        {
+            const AVCodecDescriptor *const codecDesc = avcodec_descriptor_get(codecParams->codec_id);
+
+            if (codecDesc != nullptr)
+            {
+                codec = avcodec_find_decoder_by_name((QByteArray(codecDesc->name) + "_qsv").constData());
+            }
+        }
+        else
+        {
+            codec = avcodec_find_decoder(codecParams->codec_id);
+        }
+
+        if (codec == nullptr)
+        {
+            DEBUG(("No %s decoder available for the video stream in '%s'.", deviceTypeName, filename.constData()));
+            return;
+        }
+
+        for (int i = 0; ; i++)
+        {
+            const AVCodecHWConfig *const config = avcodec_get_hw_config(codec, i);
+
+            if (config == nullptr)
+            {
+                break;
+            }
+
+            if ((config->methods & AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX) &&
+                (config->device_type == deviceType))
+            {
+                this->surfacePixelFormat = config->pix_fmt;
+                break;
+            }
+        }
+
+        if (this->surfacePixelFormat == AV_PIX_FMT_NONE)
+        {
+            DEBUG(("The %s device can't decode the video stream in '%s'.", deviceTypeName, filename.constData()));
+            return;
+        }
+
+        if (av_hwdevice_ctx_create(&this->deviceContext, deviceType, nullptr, nullptr, 0) < 0)
+        {
+            DEBUG(("No %s device available.", deviceTypeName));
+            this->deviceContext = nullptr;
+            return;
+        }
+
+        this->codecContext = avcodec_alloc_context3(codec);
+
+        if ((this->codecContext == nullptr) ||
+            (avcodec_parameters_to_context(this->codecContext, codecParams) < 0))
+        {
+            NBENE(("Failed to set up the %s decoder for '%s'.", deviceTypeName, filename.constData()));
+            avcodec_free_context(&this->codecContext);
+            return;
+        }
+
+        this->codecContext->hw_device_ctx = av_buffer_ref(this->deviceContext);
+        this->codecContext->opaque = &this->surfacePixelFormat;
+        this->codecContext->get_format = pick_surface_format;
+
+        if (avcodec_open2(this->codecContext, codec, nullptr) < 0)
+        {
+            NBENE(("Failed to open the %s decoder for '%s'.", deviceTypeName, filename.constData()));
+            avcodec_free_context(&this->codecContext);
+            return;
+        }
+
+        // Let the demuxer drop packets of streams we're not interested in.
+        for (uint i = 0; i < this->formatContext->nb_streams; i++)
+        {
+            if (int(i) != this->streamIdx)
+            {
+                this->formatContext->streams[i]->discard = AVDISCARD_ALL;
+            }
+        }
+
+        this->packet = av_packet_alloc();
+        this->decodedFrame = av_frame_alloc();
+        this->mappedFrame = av_frame_alloc();
+
+        k_assert(((this->packet != nullptr) && (this->decodedFrame != nullptr) && (this->mappedFrame != nullptr)),
+                 "Failed to allocate memory for video decoding.");
+
+        // Decode the first frame up front, so that a device that turns out not to
+        // handle this particular video gets found out while there's still a chance
+        // to fall back to another backend.
+        if (!this->decode_next_frame())
+        {
+            DEBUG(("The %s device failed to decode '%s'.", deviceTypeName, filename.constData()));
+            avcodec_free_context(&this->codecContext);
+            return;
+        }
+
+        this->haveUnreadFrame = true;
+    #else
+        (void)videoInfo;
+        DEBUG(("This build of FFmpeg is too old for %s decoding.", deviceTypeName));
+    #endif
+
+    return;
+}
+
+hardware_video_decoder_c::~hardware_video_decoder_c()
+{
+    av_frame_free(&this->mappedFrame);
+    av_frame_free(&this->decodedFrame);
+    av_packet_free(&this->packet);
+    avcodec_free_context(&this->codecContext);
+    av_buffer_unref(&this->deviceContext);
+    avformat_close_input(&this->formatContext);
+
+    return;
+}
+
+bool hardware_video_decoder_c::is_open() const
+{
+    return bool(this->codecContext != nullptr);
+}
+
+const char* hardware_video_decoder_c::backend_name() const
+{
+    return this->deviceTypeName;
+}
+
+bool hardware_video_decoder_c::seek(const uint frameIdx)
+{
+    k_assert(this->is_open(), "Was asked to seek in an unopened video.");
+
+    analysis_stage_timer_c timer(analysis_stats_c::stage_e::Seek);
+
+    if (frameIdx == this->nextFrameIdx)
+    {
+        return true;
+    }
+
+    const AVStream *const stream = this->formatContext->streams[this->streamIdx];
+    const i64 startTime = ((stream->start_time == AV_NOPTS_VALUE)? 0 : stream->start_time);
+    const AVRational frameRate = ((stream->avg_frame_rate.num > 0)? stream->avg_frame_rate : stream->r_frame_rate);
+
+    if ((frameRate.num <= 0) ||
+        (frameRate.den <= 0))
+    {
+        return false;
+    }
+
+    const i64 targetTimestamp = (startTime + av_rescale_q(frameIdx, av_inv_q(frameRate), stream->time_base));
+
+    if (av_seek_frame(this->formatContext, this->streamIdx, targetTimestamp, AVSEEK_FLAG_BACKWARD) < 0)
+    {
+        return false;
+    }
+
+    avcodec_flush_buffers(this->codecContext);
+    this->streamEnded = false;
+    this->haveUnreadFrame = false;
+
+    // The seek will have landed on a keyframe at or before the target, from which
+    // we decode (but don't retrieve) our way up to the target.
+    while (this->decode_next_frame())
+    {
+        i64 decodedFrameIdx = frameIdx;
+
+        // Frames whose position can't be told are taken to be the target.
+        if (!this->frame_index(this->decodedFrame, decodedFrameIdx) ||
+            (decodedFrameIdx >= i64(frameIdx)))
+        {
+            this->haveUnreadFrame = true;
+            this->unreadFrameIdx = uint(std::max(decodedFrameIdx, i64(frameIdx)));
+            this->nextFrameIdx = frameIdx;
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool hardware_video_decoder_c::grab()
+{
+    k_assert(this->is_open(), "Was asked to decode an unopened video.");
+
+    if (this->haveUnreadFrame)
+    {
+        // Until we're up to the unread frame's own index, it stands in for the
+        // frames missing before it.
+        this->haveUnreadFrame = (this->nextFrameIdx < this->unreadFrameIdx);
+    }
+    else if (!this->decode_next_frame())
+    {
+        return false;
+    }
+
+    this->nextFrameIdx++;
+
+    return true;
+}
+
+bool hardware_video_decoder_c::read(cv::Mat &frame)
+{
+    return (this->grab() &&
+            this->retrieve_luma(this->decodedFrame, frame));
+}
+
+// Decodes the stream's next frame into decodedFrame. Returns false at the end of
+// the stream, or if the decoder fails.
+//
+bool hardware_video_decoder_c::decode_next_frame()
+{
+    analysis_stage_timer_c timer(analysis_stats_c::stage_e::Decode);
+
+    av_frame_unref(this->decodedFrame);
+
+    while (true)
+    {
+        const int receiveRet = avcodec_receive_frame(this->codecContext, this->decodedFrame);
+
+        if (receiveRet == 0)
+        {
+            return true;
+        }
+        else if ((receiveRet != AVERROR(EAGAIN)) ||
+                 this->streamEnded)
+        {
+            return false;
+        }
+
+        // The decoder needs more input. Feed it the stream's next packet; or, at
+        // the end of the stream, a null packet so that it'll flush out what it
+        // has left.
+        if (av_read_frame(this->formatContext, this->packet) < 0)
+        {
+            avcodec_send_packet(this->codecContext, nullptr);
+            this->streamEnded = true;
+        }
+        else
+        {
+            const int sendRet = ((this->packet->stream_index == this->streamIdx)? avcodec_send_packet(this->codecContext, this->packet)
+                                                                                  : 0);
+            av_packet_unref(this->packet);
+
+            // Corrupt packets can be skipped, but other errors (e.g. the device
+            // not handling the stream's profile) won't go away by themselves.
+            if ((sendRet < 0) &&
+                (sendRet != AVERROR_INVALIDDATA))
+            {
+                return false;
+            }
+        }
+    }
+}
+
+// Derives from its timestamp the index in the stream of the given decoded frame.
+// Returns false, leaving frameIdx as it was, if the frame's position can't be
+// told.
+//
+bool hardware_video_decoder_c::frame_index(const AVFrame *const frame, i64 &frameIdx) const
+{
+    const AVStream *const stream = this->formatContext->streams[this->streamIdx];
+    const i64 timestamp = frame->best_effort_timestamp;
+    const i64 startTime = ((stream->start_time == AV_NOPTS_VALUE)? 0 : stream->start_time);
+    const AVRational frameRate = ((stream->avg_frame_rate.num > 0)? stream->avg_frame_rate : stream->r_frame_rate);
+
+    if ((timestamp == AV_NOPTS_VALUE) ||
+        (frameRate.num <= 0) ||
+        (frameRate.den <= 0))
+    {
+        return false;
+    }
+
+    frameIdx = av_rescale_q((timestamp - startTime), stream->time_base, av_inv_q(frameRate));
+
+    return true;
+}
+
+// Downscales the luma plane of the given decoded frame into the given matrix.
+// If the frame is still on the device, its surface is mapped into memory for
+// the duration, or failing that, copied over.
+//
+bool hardware_video_decoder_c::retrieve_luma(const AVFrame *const surface, cv::Mat &frame)
+{
+    analysis_stage_timer_c timer(analysis_stats_c::stage_e::ColorConversion);
+
+    const AVFrame *lumaSource = surface;
+
+    if (surface->format == this->surfacePixelFormat)
+    {
+        k_assert((surface->hw_frames_ctx != nullptr), "Expected a device surface to have a frames context.");
+
+        const AVPixelFormat softwareFormat = ((const AVHWFramesContext*)surface->hw_frames_ctx->data)->sw_format;
+
+        av_frame_unref(this->mappedFrame);
+        this->mappedFrame->format = softwareFormat;
+
+        if (av_hwframe_map(this->mappedFrame, surface, AV_HWFRAME_MAP_READ) < 0)
+        {
+            av_frame_unref(this->mappedFrame);
+            this->mappedFrame->format = softwareFormat;
+
+            if (av_hwframe_transfer_data(this->mappedFrame, surface, 0) < 0)
+            {
+                NBENE(("Failed to retrieve a decoded frame from the %s device.", this->deviceTypeName));
+                return false;
+            }
+        }
+
+        lumaSource = this->mappedFrame;
+    }
+
+    // We can read the luma of any YUV format that stores it in a plane of its
+    // own, with 8 bits per sample or with up to 16 in native-endian words.
+    const AVPixFmtDescriptor *const formatDesc = av_pix_fmt_desc_get(AVPixelFormat(lumaSource->format));
+    if ((formatDesc == nullptr) ||
+        (formatDesc->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BE)) ||
+        (formatDesc->comp[0].plane != 0) ||
+        (formatDesc->comp[0].offset != 0) ||
+        (formatDesc->comp[0].step != ((formatDesc->comp[0].depth + 7) / 8)) ||
+        (formatDesc->comp[0].step > 2) ||
+        (lumaSource->linesize[0] <= 0))
+    {
+        NBENE(("The %s device produced frames in an unsupported pixel format.", this->deviceTypeName));
+        av_frame_unref(this->mappedFrame);
+        return false;
+    }
+
+    const cv::Size proxySize(this->settings.proxyWidth, this->settings.proxyHeight);
+    const cv::Mat lumaPlane(lumaSource->height, lumaSource->width,
+                            ((formatDesc->comp[0].step == 1)? CV_8UC1 : CV_16UC1),
+                            lumaSource->data[0], size_t(lumaSource->linesize[0]));
+
+    if (formatDesc->comp[0].step == 1)
+    {
+        cv::resize(lumaPlane, frame, proxySize, 0, 0, cv::INTER_AREA);
+    }
+    else
+    {
+        const int numExtraBits = (formatDesc->comp[0].shift + formatDesc->comp[0].depth - 8);
+
+        cv::resize(lumaPlane, this->scaleBuffer, proxySize, 0, 0, cv::INTER_AREA);
+        this->scaleBuffer.convertTo(frame, CV_8U, (1.0 / (1 << numExtraBits)));
+    }
+
+    // Release the mapping (or copy) of the surface.
+    av_frame_unref(this->mappedFrame);
+
+    return true;
+}
+
+pipelined_video_decoder_c::pipelined_video_decoder_c(video_decoder_c *const decoder, const uint numBuffers) :
+    decoder(decoder),
+    stats(analysis_stats_scope_c::current()),
+    ring(std::max(1u, numBuffers))
+{
+    this->decodeThread = std::thread([this]{ this->decode_ahead(); });
+
+    return;
+}
+
+pipelined_video_decoder_c::~pipelined_video_decoder_c()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+
+        this->threadShouldStop = true;
+        this->stateChanged.notify_all();
+    }
+
+    this->decodeThread.join();
+
+    return;
+}
+
+bool pipelined_video_decoder_c::is_open() const
+{
+    return this->decoder->is_open();
+}
+
+const char* pipelined_video_decoder_c::backend_name() const
+{
+    return this->decoder->backend_name();
+}
+
+bool pipelined_video_decoder_c::seek(const uint frameIdx)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    this->pause_decoding(lock);
+
+    // The frames decoded ahead are of the old position.
+    this->ringHead = 0;
+    this->numReadyFrames = 0;
+    this->endReached = false;
+
+    return this->decoder->seek(frameIdx);
+}
+
+bool pipelined_video_decoder_c::grab()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    this->pause_decoding(lock);
+
+    if (this->numReadyFrames > 0)
+    {
+        this->ringHead = ((this->ringHead + 1) % this->ring.size());
+        this->numReadyFrames--;
+
+        return true;
+    }
+
+    return (!this->endReached && this->decoder->grab());
+}
+
+bool pipelined_video_decoder_c::read(cv::Mat &frame)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    if (this->decodeIsPaused)
+    {
+        this->decodeIsPaused = false;
+        this->stateChanged.notify_all();
+    }
+
+    this->stateChanged.wait(lock, [this]{ return ((this->numReadyFrames > 0) || this->endReached); });
+
+    if (this->numReadyFrames == 0)
+    {
+        return false;
+    }
+
+    // Hand the frame over by swapping buffers with the caller, whose old buffer
+    // then gets decoded into in its turn.
+    cv::swap(frame, this->ring[this->ringHead]);
+    this->ringHead = ((this->ringHead + 1) % this->ring.size());
+    this->numReadyFrames--;
+
+    this->stateChanged.notify_all();
+
+    return true;
+}
+
+// Stops the decoding thread from starting on any more frames until the next read,
+// and waits for it to finish with the frame it's on, if any; after which the
+// decoder is free for the calling thread to use. Expects the mutex to be locked.
+//
+void pipelined_video_decoder_c::pause_decoding(std::unique_lock<std::mutex> &lock)
+{
+    this->decodeIsPaused = true;
+    this->stateChanged.wait(lock, [this]{ return !this->decoderIsBusy; });
+
+    return;
+}
+
+// The decoding thread's loop: while not paused, decodes frames into the ring's
+// free buffers until the ring is full, then waits for frames to be read off it.
+//
+void pipelined_video_decoder_c::decode_ahead(void)
+{
+    // Record the decoding's stages as if it were done on the creating thread.
+    analysis_stats_scope_c statsScope(this->stats);
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    while (true)
+    {
+        this->stateChanged.wait(lock, [this]
+        {
+            return (this->threadShouldStop ||
+                    (!this->decodeIsPaused &&
+                     !this->endReached &&
+                     (this->numReadyFrames < this->ring.size())));
+        });
+
+        if (this->threadShouldStop)
+        {
+            break;
+        }
+
+        // The buffer past the ready frames isn't touched by the reader, so can be
+        // decoded into without holding the lock.
+        cv::Mat &buffer = this->ring[(this->ringHead + this->numReadyFrames) % this->ring.size()];
+
+        this->decoderIsBusy = true;
+        lock.unlock();
+
+        const bool frameWasRead = this->decoder->read(buffer);
+
+        lock.lock();
+        this->decoderIsBusy = false;
+
+        if (frameWasRead)
+        {
+            this->numReadyFrames++;
+        }
+        else
+        {
+            this->endReached = true;
+        }
+
+        this->stateChanged.notify_all();
+    }
+
+    return;
+}
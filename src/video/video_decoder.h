@@ -0,0 +1,220 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors
+ *
+ */
+
+#ifndef VIDEO_DECODER_H
+#define VIDEO_DECODER_H
+
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/core/core.hpp>
+#include <condition_variable>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <vector>
+#include "../../src/types.h"
+
+class video_info_c;
+class analysis_stats_c;
+struct video_activity_settings_s;
+
+struct AVFormatContext;
+struct AVCodecContext;
+struct AVBufferRef;
+struct AVPacket;
+struct AVFrame;
+
+// Decodes a video's frames for activity analysis, handing them out in the form
+// in which they're to be compared: in full BGR color in precise comparison mode,
+// and as downscaled luma in proxy mode. Reading is sequential, but the decoder
+// can be repositioned by seeking, and frames can be skipped over by grabbing
+// them without retrieving.
+//
+class video_decoder_c
+{
+public:
+    virtual ~video_decoder_c(void);
+
+    // Returns a new decoder for the given video, using the decode backend asked
+    // for in the settings if it's available for this video, and the software
+    // backend otherwise; and decoding ahead of the reader on a thread of its own
+    // if the settings so ask. The caller takes ownership of the decoder.
+    static video_decoder_c* create(const video_info_c &videoInfo, const video_activity_settings_s &settings);
+
+    virtual bool is_open(void) const = 0;
+
+    virtual const char* backend_name(void) const = 0;
+
+    // Positions the decoder such that the next frame read or grabbed will be the
+    // one at the given index.
+    virtual bool seek(const uint frameIdx) = 0;
+
+    // Decodes the next frame but doesn't retrieve it.
+    virtual bool grab(void) = 0;
+
+    // Decodes the next frame and retrieves it into the given matrix. Returns
+    // false if no frame could be read.
+    virtual bool read(cv::Mat &frame) = 0;
+};
+
+// Decodes via OpenCV's default, software video decoding.
+//
+class software_video_decoder_c : public video_decoder_c
+{
+public:
+    software_video_decoder_c(const video_info_c &videoInfo, const video_activity_settings_s &settings);
+
+    bool is_open(void) const override;
+
+    const char* backend_name(void) const override;
+
+    bool seek(const uint frameIdx) override;
+
+    bool grab(void) override;
+
+    bool read(cv::Mat &frame) override;
+
+private:
+    cv::VideoCapture video;
+
+    // In proxy mode, frames are decoded into decodeBuffer and, if need be,
+    // downscaled into scaleBuffer, before being reduced down to their luma.
+    cv::Mat decodeBuffer;
+    cv::Mat scaleBuffer;
+
+    const video_activity_settings_s &settings;
+
+    const video_info_c &videoInfo;
+};
+
+// Decodes via FFmpeg's hardware-accelerated decoding (VAAPI, NVDEC, QSV or
+// VideoToolbox), reading the frames' luma straight off the decoded surfaces
+// where the device allows them to be mapped. Produces downscaled luma only,
+// so is only of use in proxy comparison mode.
+//
+class hardware_video_decoder_c : public video_decoder_c
+{
+public:
+    hardware_video_decoder_c(const video_info_c &videoInfo, const video_activity_settings_s &settings,
+                             const char *const deviceTypeName);
+    ~hardware_video_decoder_c(void);
+
+    bool is_open(void) const override;
+
+    const char* backend_name(void) const override;
+
+    bool seek(const uint frameIdx) override;
+
+    bool grab(void) override;
+
+    bool read(cv::Mat &frame) override;
+
+private:
+    bool decode_next_frame(void);
+
+    bool retrieve_luma(const AVFrame *const surface, cv::Mat &frame);
+
+    bool frame_index(const AVFrame *const frame, i64 &frameIdx) const;
+
+    AVFormatContext *formatContext = nullptr;
+    AVCodecContext *codecContext = nullptr;
+    AVBufferRef *deviceContext = nullptr;
+
+    AVPacket *packet = nullptr;
+    AVFrame *decodedFrame = nullptr;
+    AVFrame *mappedFrame = nullptr;
+
+    // The index in the container of the video stream we're decoding.
+    int streamIdx = -1;
+
+    // The pixel format (an AVPixelFormat) of the device's decoded surfaces.
+    int surfacePixelFormat = -1;
+
+    // Set once the last of the stream's packets has been sent for decoding.
+    bool streamEnded = false;
+
+    // Set when decodedFrame holds a frame that has yet to be handed out, as is
+    // the case after opening the video and after seeking.
+    bool haveUnreadFrame = false;
+
+    // The index of the frame that'll be read or grabbed next.
+    uint nextFrameIdx = 0;
+
+    // The index, by its timestamp, of the frame in decodedFrame while it's unread.
+    // A seek can land past the frame it was asked for, if the stream has none at
+    // that index; the frame landed on then gets handed out for each index up to
+    // its own, so that the frames after it are read at their actual indices.
+    uint unreadFrameIdx = 0;
+
+    // Downscaled luma of more than 8 bits per sample gets staged in here.
+    cv::Mat scaleBuffer;
+
+    const char *const deviceTypeName;
+
+    const video_activity_settings_s &settings;
+};
+
+// Runs another decoder on a thread of its own, decoding frames ahead of the reader
+// into a ring of frame buffers, so that decoding one frame overlaps with comparing
+// the last. The buffers get allocated once, as they're first decoded into, and a
+// frame is read by swapping its buffer with the reader's rather than copying it,
+// the reader's old buffer taking its place in the ring. Grabbing and seeking pause
+// the decoding ahead until the next read, so frames that are being skipped over
+// don't get retrieved needlessly.
+//
+class pipelined_video_decoder_c : public video_decoder_c
+{
+public:
+    // Takes ownership of the given decoder.
+    pipelined_video_decoder_c(video_decoder_c *const decoder, const uint numBuffers);
+    ~pipelined_video_decoder_c(void);
+
+    bool is_open(void) const override;
+
+    const char* backend_name(void) const override;
+
+    bool seek(const uint frameIdx) override;
+
+    bool grab(void) override;
+
+    bool read(cv::Mat &frame) override;
+
+private:
+    void pause_decoding(std::unique_lock<std::mutex> &lock);
+
+    void decode_ahead(void);
+
+    const std::unique_ptr<video_decoder_c> decoder;
+
+    // The stats that the creating thread was recording its stages into, if any,
+    // for the decoding thread to record its own into.
+    analysis_stats_c *const stats;
+
+    // The buffers decoded into. Those from ringHead on, numReadyFrames of them,
+    // hold frames ready to be read, in order.
+    std::vector<cv::Mat> ring;
+    uint ringHead = 0;
+    uint numReadyFrames = 0;
+
+    // While paused, the decoding thread doesn't start on any new frames.
+    bool decodeIsPaused = true;
+
+    // Set while the decoding thread is decoding a frame, during which only it may
+    // use the decoder.
+    bool decoderIsBusy = false;
+
+    // Set once the decoder has run out of frames to read.
+    bool endReached = false;
+
+    bool threadShouldStop = false;
+
+    // Guards the variables above, and signals changes in them.
+    std::mutex mutex;
+    std::condition_variable stateChanged;
+
+    std::thread decodeThread;
+};
+
+#endif
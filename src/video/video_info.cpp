@@ -2,23 +2,22 @@
  * Tarpeeksi Hyvae Soft 2018 /
  * AV Scissors.
  *
- * Loads up the given video, and polls OpenCV on it for some metadata, like frame
- * rate, duration, etc.
+ * Loads up the given video's metadata, like frame rate, duration, etc.
  *
  */
 
 #include <QDebug>
-#include <opencv2/highgui/highgui.hpp>
-#include "../../src/messager/messager.h"
+#include "../../src/messager/message_sink.h"
 #include "../../src/audio/audio_file.h"
 #include "../../src/video/video_info.h"
+#include "../../src/video/video_probe.h"
 #include "../../src/common.h"
 
-video_info_c::video_info_c(const QString videoFilename, const messager_c *const messager) :
+video_info_c::video_info_c(const QString videoFilename, const message_sink_c *const messager) :
     filename(videoFilename)
 {
     connect(    this, &video_info_c::message_to_user,
-            messager, &messager_c::new_message);
+            messager, &message_sink_c::new_message);
 
     INFO(("Loading video file '%s'...", this->file_name().toStdString().c_str()));
 
@@ -36,34 +35,22 @@ video_info_c::video_info_c(const QString videoFilename, const messager_c *const
         return;
     }
 
-    // Initialize the video information.
+    // Initialize the video information. If the file has been probed already, e.g.
+    // by the GUI before showing it, this comes from the probe's cache.
     {
-        cv::VideoCapture video(this->file_name().toStdString());
-        if (!video.isOpened())
+        video_metadata_s metadata;
+        if (!video_probe_c::probe(this->file_name(), metadata) ||
+            (metadata.numFrames < 100))
         {
             emit message_to_user("That is not a supported video file.");
             this->videoIsValid = false;
             return;
         }
 
-        if ((int)video.get(CV_CAP_PROP_FRAME_COUNT) <= 0)
-        {
-            emit message_to_user("That is not a supported video file.");
-            this->videoIsValid = false;
-            return;
-        }
-        else if ((int)video.get(CV_CAP_PROP_FRAME_COUNT) < 100)
-        {
-            emit message_to_user("That is not a supported video file.");
-            this->videoIsValid = false;
-            return;
-        }
-
-        this->numVideoFrames = (int)video.get(CV_CAP_PROP_FRAME_COUNT);
-        this->framerate = video.get(CV_CAP_PROP_FPS);
-        this->durationMs = int(video.get(CV_CAP_PROP_FRAME_COUNT) / (real)video.get(CV_CAP_PROP_FPS) * 1000.0);
-        this->resolution.setWidth((int)video.get(CV_CAP_PROP_FRAME_WIDTH));
-        this->resolution.setHeight((int)video.get(CV_CAP_PROP_FRAME_HEIGHT));
+        this->numVideoFrames = metadata.numFrames;
+        this->framerate = metadata.frameRate;
+        this->durationMs = metadata.durationMs;
+        this->resolution = metadata.resolution;
     }
 
     this->videoIsValid = true;
@@ -91,7 +78,7 @@ real video_info_c::frame_rate() const
     return this->framerate;
 }
 
-uint video_info_c::duration_ms() const
+u64 video_info_c::duration_ms() const
 {
     return this->durationMs;
 }
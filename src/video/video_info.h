@@ -10,18 +10,18 @@
 #include <QFileInfo>
 #include <QString>
 #include <QVector>
-#include <QImage>
+#include <QSize>
 #include "../../src/types.h"
 
 class audio_file_c;
-class messager_c;
+class message_sink_c;
 
 class video_info_c : public QObject
 {
     Q_OBJECT
 
 public:
-    video_info_c(const QString videoFilename, const messager_c *const messager);
+    video_info_c(const QString videoFilename, const message_sink_c *const messager);
     ~video_info_c(void);
 
     const QString& file_name(void) const;
@@ -30,7 +30,7 @@ public:
 
     real frame_rate(void) const;
 
-    uint duration_ms(void) const;
+    u64 duration_ms(void) const;
 
     uint width(void) const;
 
@@ -51,7 +51,7 @@ private:
     QSize resolution = QSize();
     uint numVideoFrames = 0;
     real framerate = 0;
-    uint durationMs = 0;
+    u64 durationMs = 0;
 
     // Will be set to true if we were able to successfully load the video.
     bool videoIsValid = false;
@@ -11,10 +11,11 @@
 #include "../../src/video/video_player.h"
 #include "../../src/messager/messager.h"
 
-video_object_c::video_object_c(const QString filename, const messager_c *const messager) :
+video_object_c::video_object_c(const QString filename, const messager_c *const messager,
+                               const video_activity_settings_s &activitySettings) :
     videoFilename(filename),
     videoInfo(videoFilename, messager),
-    videoActivity(videoInfo, messager)
+    videoActivity(videoInfo, messager, activitySettings)
 {
     connect(    this, &video_object_c::message_to_user,
             messager, &messager_c::new_message);
@@ -29,11 +30,7 @@ video_object_c::video_object_c(const QString filename, const messager_c *const m
 
 video_object_c::~video_object_c()
 {
-    if (associatedPlayer != nullptr)
-    {
-        associatedPlayer->remove_video_file(this);
-        associatedPlayer = nullptr;
-    }
+    this->detach_from_player();
 
     return;
 }
@@ -51,6 +48,20 @@ void video_object_c::assign_to_player(video_player_c *const player)
     return;
 }
 
+// Removes the video from the player it's been assigned to, if any, so that it can
+// later be assigned to a player again.
+//
+void video_object_c::detach_from_player(void)
+{
+    if (associatedPlayer != nullptr)
+    {
+        associatedPlayer->remove_video_file(this);
+        associatedPlayer = nullptr;
+    }
+
+    return;
+}
+
 const video_info_c& video_object_c::info() const
 {
     return videoInfo;
@@ -61,12 +72,34 @@ const video_activity_c& video_object_c::activity() const
     return videoActivity;
 }
 
-const QVector<video_activity_c::activity_type_e>& video_object_c::video_activity_data() const
+// Re-judges the video's activity under the given thresholds; see
+// video_activity_c::rethreshold().
+//
+bool video_object_c::rethreshold(const video_activity_settings_s &thresholds)
+{
+    return this->videoActivity.rethreshold(thresholds);
+}
+
+// Sets the priority of the video's analysis relative to others sharing its thread
+// pool; see video_activity_c::set_thread_priority().
+//
+void video_object_c::set_analysis_priority(const int priority)
+{
+    this->videoActivity.set_thread_priority(priority);
+
+    return;
+}
+
+// The timelines are handed out for writable so that their viewer can collect their
+// changes (see activity_timeline_c::take_dirty_ranges()); the activity itself is
+// only to be written by the analysis.
+//
+activity_timeline_c& video_object_c::video_activity_data()
 {
     return this->videoActivity.videoFrameIsActive;
 }
 
-const QVector<video_activity_c::activity_type_e>& video_object_c::audio_activity_data() const
+activity_timeline_c& video_object_c::audio_activity_data()
 {
     return this->videoActivity.audioFrameIsActive;
 }
@@ -12,23 +12,31 @@
 #include "../../src/video/video_info.h"
 
 class video_player_c;
+class messager_c;
 
 class video_object_c : public QObject
 {
     Q_OBJECT
 
 public:
-    video_object_c(const QString filename, const messager_c *const messager);
+    video_object_c(const QString filename, const messager_c *const messager,
+                   const video_activity_settings_s &activitySettings = video_activity_settings_s());
     ~video_object_c(void);
 
     void assign_to_player(video_player_c *const player);
 
+    void detach_from_player(void);
+
     const video_info_c& info(void) const;
 
     const video_activity_c& activity(void) const;
 
-    const QVector<video_activity_c::activity_type_e>& video_activity_data(void) const;
-    const QVector<video_activity_c::activity_type_e>& audio_activity_data(void) const;
+    bool rethreshold(const video_activity_settings_s &thresholds);
+
+    void set_analysis_priority(const int priority);
+
+    activity_timeline_c& video_activity_data(void);
+    activity_timeline_c& audio_activity_data(void);
 
 signals:
     void message_to_user(const QString message);
@@ -36,7 +44,7 @@ signals:
 private:
     const QString videoFilename;
     const video_info_c videoInfo;
-    const video_activity_c videoActivity;
+    video_activity_c videoActivity;
 
     // Which player this video has been assigned to.
     video_player_c *associatedPlayer = nullptr;
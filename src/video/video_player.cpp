@@ -4,29 +4,48 @@
  *
  * Uses QVideoWidget to display videos to the user.
  *
+ * Rather than having Qt's media player report the playback position every
+ * millisecond, and moving the playback icon on each report, the player has the
+ * position reported only a few times a second, and in between extrapolates it
+ * from the last report, once per frame of the display. The icon then gets moved
+ * no more often than it could be seen to move.
+ *
  */
 
 #include <QMediaPlaylist>
 #include <QVideoWidget>
+#include <QGuiApplication>
 #include <QPainter>
+#include <QScreen>
 #include <QDebug>
 #include <QLabel>
+#include <QTimer>
+#include <algorithm>
+#include <cmath>
 #include "../../src/video/video_player.h"
 #include "../../src/video/video_object.h"
 #include "../../src/video/video_info.h"
 
+// How often, in milliseconds, Qt's media player is to report the playback position
+// while the video plays. The position is extrapolated in between the reports.
+static const int POSITION_NOTIFY_INTERVAL_MS = 250;
+
+// The display refresh rate assumed if the actual one can't be found out.
+static const real DEFAULT_DISPLAY_REFRESH_RATE = 60;
+
 video_player_c::video_player_c(QWidget *const parent) :
     parentWidget(parent),
     mediaPlaylist(new QMediaPlaylist(parent)),
     mediaPlayer(new QMediaPlayer(parent)),
-    videoWidget(new QVideoWidget(parent))
+    videoWidget(new QVideoWidget(parent)),
+    displayTimer(new QTimer(this))
 {
     this->mediaPlaylist->setCurrentIndex(0);
     this->mediaPlaylist->setPlaybackMode(QMediaPlaylist::CurrentItemOnce);
 
     this->mediaPlayer->setPlaylist(this->mediaPlaylist);
     this->mediaPlayer->setVideoOutput(this->videoWidget);
-    this->mediaPlayer->setNotifyInterval(1); // So we get frequent info on the current playback position.
+    this->mediaPlayer->setNotifyInterval(POSITION_NOTIFY_INTERVAL_MS);
     this->mediaPlayer->pause();
 
     this->videoWidget->setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);   // We'll use a separate kludge function to resize the widget to fit its parent.
@@ -98,6 +117,10 @@ video_player_c::video_player_c(QWidget *const parent) :
     connect(this->mediaPlayer, &QMediaPlayer::stateChanged,
             this, &video_player_c::new_video_state);
 
+    this->displayTimer->setTimerType(Qt::PreciseTimer);
+    connect(this->displayTimer, &QTimer::timeout,
+            this, &video_player_c::display_frame_tick);
+
     return;
 }
 
@@ -172,10 +195,8 @@ void video_player_c::fit_player_to_parent()
     }
 
     // Make sure the playback icon's position reflects the new size.
-    {
-        const uint pixelPosX = (((this->playbackIcon->parentWidget())->width() / (real)this->video_info().duration_ms()) * curPlaybackPosMs);
-        this->playbackIcon->move((pixelPosX - this->playbackIcon->width()), this->playbackIcon->y());
-    }
+    this->playbackIconX = -1;
+    this->update_playback_pos(curPlaybackPosMs);
 
     this->videoWidget->show();
     this->videoWidget->raise();
@@ -183,6 +204,14 @@ void video_player_c::fit_player_to_parent()
     return;
 }
 
+// Returns the area, in the parent widget's coordinates, that the video is shown
+// in.
+//
+QRect video_player_c::video_rect(void) const
+{
+    return this->videoWidget->geometry();
+}
+
 // Make the given video the one this player plays. Note that although this makes
 // reference to QMediaPlaylist, no more than one video can be in that list at any
 // given time, at the moment.
@@ -288,9 +317,9 @@ void video_player_c::seek_to_ms(qint64 newPosMs)
     }
     // Leave a buffer at the end when seeking manually, so that the video doesn't
     // immediately jump back to the beginning when seeking to the end.
-    else if (newPosMs >= (this->video_info().duration_ms() - 1500))
+    else if (newPosMs >= (qint64(this->video_info().duration_ms()) - 1500))
     {
-        newPosMs = (this->video_info().duration_ms() - 1500);
+        newPosMs = (qint64(this->video_info().duration_ms()) - 1500);
     }
 
     this->mediaPlayer->setPosition(newPosMs);
@@ -379,22 +408,66 @@ const video_activity_c& video_player_c::video_activity()
     return video->activity();
 }
 
-uint video_player_c::playback_pos_ms() const
+qint64 video_player_c::playback_pos_ms() const
 {
     return curPlaybackPosMs;
 }
 
-// Gets signaled by Qt's media player when the video playback position changes.
+// Gets signaled by Qt's media player when the video playback position changes;
+// which, while the video plays, is every POSITION_NOTIFY_INTERVAL_MS, and at
+// once on seeking.
 //
 void video_player_c::new_video_pos(const qint64 newPosMs)
 {
-    // Position the play icon to reflect the new position, with the assumption
-    // that the total width of the icon's parent represents the entire length
-    // of the video.
-    if (this->playbackIcon->parent() != nullptr)
+    this->reportedPlaybackPosMs = newPosMs;
+    this->reportedPlaybackPosAge.start();
+
+    this->update_playback_pos(newPosMs);
+
+    return;
+}
+
+// Gets signaled by the display timer once per frame of the display while the
+// video plays. Advances the playback position from where the media player last
+// reported it to be, by as much as the video will have played since then.
+//
+void video_player_c::display_frame_tick(void)
+{
+    if ((this->video == nullptr) ||
+        !this->reportedPlaybackPosAge.isValid())
     {
-        uint pixelPosX = (((this->playbackIcon->parentWidget())->width() / (real)this->video_info().duration_ms()) * newPosMs);
-        this->playbackIcon->move((pixelPosX - this->playbackIcon->width()), this->playbackIcon->y());
+        return;
+    }
+
+    // Qt reports a playback rate of 0 for the default rate on some platforms.
+    const real playbackRate = ((this->mediaPlayer->playbackRate() > 0)? this->mediaPlayer->playbackRate() : 1);
+
+    qint64 posMs = (this->reportedPlaybackPosMs + qint64(this->reportedPlaybackPosAge.elapsed() * playbackRate));
+    posMs = std::min(posMs, qint64(this->video_info().duration_ms()));
+
+    this->update_playback_pos(posMs);
+
+    return;
+}
+
+// Makes the given position the current playback position, and positions the play
+// icon to reflect it, with the assumption that the total width of the icon's
+// parent represents the entire length of the video.
+//
+void video_player_c::update_playback_pos(const qint64 newPosMs)
+{
+    if ((this->video != nullptr) &&
+        (this->playbackIcon->parent() != nullptr))
+    {
+        const int pixelPosX = (((this->playbackIcon->parentWidget())->width() / (real)this->video_info().duration_ms()) * newPosMs);
+
+        // Moving the icon has it repainted, so only move it if it'd end up
+        // somewhere else.
+        if (pixelPosX != this->playbackIconX)
+        {
+            this->playbackIcon->move((pixelPosX - this->playbackIcon->width()), this->playbackIcon->y());
+            this->playbackIconX = pixelPosX;
+        }
 
         if (!this->playbackIcon->isVisible())
         {
@@ -405,6 +478,8 @@ void video_player_c::new_video_pos(const qint64 newPosMs)
     curPlaybackPosMs = newPosMs;
 
     emit video_pos_changed(newPosMs);
+
+    return;
 }
 
 // Gets signaled by Qt's media player when the video's state changes.
@@ -420,6 +495,11 @@ void video_player_c::new_video_state(const QMediaPlayer::State state)
 
             this->playbackIcon->setPixmap(*this->iconPaused);
 
+            // Go by where the media player says playback stopped, rather than by
+            // where it was extrapolated to.
+            this->displayTimer->stop();
+            this->new_video_pos(this->mediaPlayer->position());
+
             break;
         }
         case QMediaPlayer::PlayingState:
@@ -429,6 +509,16 @@ void video_player_c::new_video_state(const QMediaPlayer::State state)
 
             this->playbackIcon->setPixmap(*this->iconPlaying);
 
+            // Tick once per frame of the display, so that the playback icon
+            // moves as smoothly as it can be shown to.
+            {
+                const QScreen *const screen = QGuiApplication::primaryScreen();
+                const real refreshRate = (((screen != nullptr) && (screen->refreshRate() > 0))? screen->refreshRate()
+                                                                                                 : DEFAULT_DISPLAY_REFRESH_RATE);
+
+                this->displayTimer->start(std::max(1, int(std::round(1000 / refreshRate))));
+            }
+
             break;
         }
         case QMediaPlayer::StoppedState:
@@ -7,12 +7,16 @@
 #ifndef VIDEO_PLAYER_H_
 #define VIDEO_PLAYER_H_
 
+#include <QElapsedTimer>
 #include <QMediaPlayer>
+#include <QWidget>
+#include <QPixmap>
 #include "../../src/common.h"
 
 class QMediaPlaylist;
 class QVideoWidget;
 class QLabel;
+class QTimer;
 class video_activity_c;
 class video_object_c;
 class video_info_c;
@@ -31,6 +35,8 @@ public:
 
     void fit_player_to_parent(void);
 
+    QRect video_rect(void) const;
+
     void add_video_file(const video_object_c *const _video);
 
     void remove_video_file(const video_object_c *const video);
@@ -63,7 +69,7 @@ public:
 
     const video_activity_c& video_activity(void);
 
-    uint playback_pos_ms(void) const;
+    qint64 playback_pos_ms(void) const;
 
 signals:
     void video_pos_changed(const qint64 newPosMs);
@@ -75,7 +81,11 @@ private slots:
 
     void new_video_state(const QMediaPlayer::State state);
 
+    void display_frame_tick(void);
+
 private:
+    void update_playback_pos(const qint64 newPosMs);
+
     const QWidget *const parentWidget;
     QMediaPlaylist *const mediaPlaylist;
     QMediaPlayer *const mediaPlayer;
@@ -83,6 +93,19 @@ private:
 
     qint64 curPlaybackPosMs = 0;
 
+    // While the video plays, fires once per frame of the display, for the playback
+    // position to be advanced between the media player's (sparse) reports of it.
+    QTimer *const displayTimer;
+
+    // The playback position that the media player last reported, and how long ago
+    // that was; from which the position is extrapolated for each displayed frame.
+    qint64 reportedPlaybackPosMs = 0;
+    QElapsedTimer reportedPlaybackPosAge;
+
+    // The x coordinate the playback icon was last moved to, so that it's moved
+    // (and repainted) only when the playback position shows up as having changed.
+    int playbackIconX = -1;
+
     // The icon shown in the GUI to indicate the current playback position.
     QLabel *playbackIcon = nullptr;
 
@@ -0,0 +1,242 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors
+ *
+ * Probes video files for their metadata - resolution, frame rate, length - by
+ * reading their container's headers via libavformat, and caches the results.
+ *
+ * Probing a file over a slow network share can take seconds, so this can be done
+ * on a thread of its own, signalling when done. The probe can be cancelled even
+ * while it's waiting on the file, as libavformat checks back with us between its
+ * reads. And since the results get cached (by the file's name, size and time of
+ * modification), the file's eventual video_info_c needn't go back to the file.
+ *
+ * The frame count and frame rate are derived the way OpenCV's FFmpeg backend
+ * derives them, so that they agree with the frame indices of the video decoders.
+ *
+ */
+
+extern "C"
+{
+    #include <libavformat/avformat.h>
+    #include <libavutil/avutil.h>
+}
+
+#include <QtConcurrent/QtConcurrent>
+#include <QFutureWatcher>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QHash>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <mutex>
+#include "../../src/video/video_probe.h"
+#include "../../src/common.h"
+
+namespace
+{
+    struct cache_entry_s
+    {
+        qint64 fileSize;
+        QDateTime lastModified;
+        bool isValidVideo;
+        video_metadata_s metadata;
+    };
+
+    // The results of the probes so far, by filename.
+    QHash<QString, cache_entry_s> PROBE_CACHE;
+    std::mutex PROBE_CACHE_MUTEX;
+}
+
+// Called by libavformat while it waits on the file, to ask whether to give up.
+//
+static int should_interrupt(void *const shouldCancel)
+{
+    return ((shouldCancel != nullptr) &&
+            ((const std::atomic<bool>*)shouldCancel)->load());
+}
+
+// Reads the given file's metadata from its container. Returns false if the file
+// couldn't be read as a video, or if shouldCancel got set in the meantime.
+//
+static bool read_metadata(const QString &filename, video_metadata_s &metadata, const std::atomic<bool> *const shouldCancel)
+{
+    AVFormatContext *formatContext = avformat_alloc_context();
+    k_assert((formatContext != nullptr), "Failed to allocate memory for probing a video.");
+
+    formatContext->interrupt_callback.callback = should_interrupt;
+    formatContext->interrupt_callback.opaque = (void*)shouldCancel;
+
+    // On failure, avformat_open_input() frees the context itself.
+    if (avformat_open_input(&formatContext, filename.toUtf8().constData(), nullptr, nullptr) < 0)
+    {
+        return false;
+    }
+
+    const int streamIdx = ((avformat_find_stream_info(formatContext, nullptr) < 0)? -1
+                                                                                   : av_find_best_stream(formatContext, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0));
+    if (streamIdx < 0)
+    {
+        avformat_close_input(&formatContext);
+        return false;
+    }
+
+    const AVStream *const stream = formatContext->streams[streamIdx];
+
+    real frameRate = av_q2d(stream->avg_frame_rate);
+    if (frameRate <= 0)
+    {
+        frameRate = av_q2d(stream->r_frame_rate);
+    }
+
+    real durationSec = (real(formatContext->duration) / AV_TIME_BASE);
+    if (durationSec <= 0)
+    {
+        durationSec = (stream->duration * av_q2d(stream->time_base));
+    }
+
+    // Without an explicit frame count, estimate it from the duration.
+    i64 numFrames = stream->nb_frames;
+    if (numFrames <= 0)
+    {
+        numFrames = i64(std::floor((durationSec * frameRate) + 0.5));
+    }
+
+    metadata.resolution = QSize(stream->codecpar->width, stream->codecpar->height);
+    metadata.numFrames = uint(std::max(i64(0), std::min(numFrames, i64(UINT_MAX))));
+    metadata.frameRate = frameRate;
+    metadata.durationMs = ((frameRate > 0)? u64(metadata.numFrames / frameRate * 1000.0) : 0);
+
+    avformat_close_input(&formatContext);
+
+    return ((frameRate > 0) &&
+            (metadata.numFrames > 0) &&
+            !metadata.resolution.isEmpty());
+}
+
+video_probe_c::video_probe_c(const QString &filename, QObject *parent) :
+    QObject(parent),
+    filename(filename)
+{
+    threadShouldStop = false;
+
+    return;
+}
+
+video_probe_c::~video_probe_c()
+{
+    this->cancel();
+    this->probeThread.waitForFinished();
+
+    return;
+}
+
+// Begins probing the file. This is kept apart from construction so that the
+// caller can connect to finished() first.
+//
+void video_probe_c::start()
+{
+    k_assert(!this->hasStarted, "Tried to re-start a video probe.");
+
+    this->hasStarted = true;
+
+    this->probeThread = QtConcurrent::run([this]
+    {
+        video_metadata_s metadata;
+        const bool isValidVideo = probe(this->filename, metadata, &this->threadShouldStop);
+
+        if (!this->threadShouldStop)
+        {
+            emit finished(this->filename, isValidVideo);
+        }
+    });
+
+    return;
+}
+
+// Asks the probe to give up. It does so asynchronously, without signalling
+// finished().
+//
+void video_probe_c::cancel()
+{
+    this->threadShouldStop = true;
+
+    return;
+}
+
+// Cancels the probe, and has it delete itself once its thread has wound down.
+// Unlike deleting the probe, doesn't wait for that to happen, so the calling
+// thread (e.g. the GUI's) isn't held up by a file slow to respond.
+//
+void video_probe_c::discard()
+{
+    this->cancel();
+
+    QFutureWatcher<void> *const watcher = new QFutureWatcher<void>(this);
+    connect(watcher, &QFutureWatcher<void>::finished,
+               this, &video_probe_c::deleteLater);
+    watcher->setFuture(this->probeThread);
+
+    return;
+}
+
+const QString& video_probe_c::file_name() const
+{
+    return this->filename;
+}
+
+// Gets the given file's metadata, from the cache if the file has been probed
+// before (and hasn't changed since), and otherwise by reading it from the file,
+// which may take a while. Returns false if the file isn't a readable video, or if
+// shouldCancel got set in the meantime, in which case nothing gets cached.
+//
+bool video_probe_c::probe(const QString &filename, video_metadata_s &metadata,
+                          const std::atomic<bool> *const shouldCancel)
+{
+    const QFileInfo fileInfo(filename);
+
+    {
+        std::lock_guard<std::mutex> lock(PROBE_CACHE_MUTEX);
+
+        const auto cached = PROBE_CACHE.constFind(filename);
+
+        if ((cached != PROBE_CACHE.constEnd()) &&
+            (cached->fileSize == fileInfo.size()) &&
+            (cached->lastModified == fileInfo.lastModified()))
+        {
+            metadata = cached->metadata;
+            return cached->isValidVideo;
+        }
+    }
+
+    const bool isValidVideo = read_metadata(filename, metadata, shouldCancel);
+
+    if ((shouldCancel != nullptr) &&
+        *shouldCancel)
+    {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(PROBE_CACHE_MUTEX);
+
+        cache_entry_s &entry = PROBE_CACHE[filename];
+        entry.fileSize = fileInfo.size();
+        entry.lastModified = fileInfo.lastModified();
+        entry.isValidVideo = isValidVideo;
+        entry.metadata = metadata;
+    }
+
+    return isValidVideo;
+}
+
+// Returns true if the given file has been probed already, such that (unless the
+// file has since changed) probe() would return immediately.
+//
+bool video_probe_c::is_cached(const QString &filename)
+{
+    std::lock_guard<std::mutex> lock(PROBE_CACHE_MUTEX);
+
+    return PROBE_CACHE.contains(filename);
+}
@@ -0,0 +1,69 @@
+/*
+ * Tarpeeksi Hyvae Soft 2018 /
+ * AV Scissors
+ *
+ */
+
+#ifndef VIDEO_PROBE_H
+#define VIDEO_PROBE_H
+
+#include <QObject>
+#include <QFuture>
+#include <QString>
+#include <QSize>
+#include <atomic>
+#include "../../src/types.h"
+
+// Metadata about a video file, as read from its container.
+struct video_metadata_s
+{
+    QSize resolution = QSize();
+    uint numFrames = 0;
+    real frameRate = 0;
+    u64 durationMs = 0;
+};
+
+// Reads a video file's metadata on a thread of its own, signalling when done.
+// The results get cached, so that the video's video_info_c - or another probe of
+// the same file - can then pick them up without touching the file again.
+//
+class video_probe_c : public QObject
+{
+    Q_OBJECT
+
+public:
+    video_probe_c(const QString &filename, QObject *parent = nullptr);
+    ~video_probe_c(void);
+
+    void start(void);
+
+    void cancel(void);
+
+    void discard(void);
+
+    const QString& file_name(void) const;
+
+    static bool probe(const QString &filename, video_metadata_s &metadata,
+                      const std::atomic<bool> *const shouldCancel = nullptr);
+
+    static bool is_cached(const QString &filename);
+
+signals:
+    // Emitted from the probing thread once the file has been probed, unless the
+    // probe was cancelled. The file's metadata can then be had from probe().
+    void finished(const QString filename, const bool isValidVideo);
+
+private:
+    // For threading the probe.
+    QFuture<void> probeThread;
+
+    bool hasStarted = false;
+
+    // Set to true to signal to the probing thread to give up, which it does even
+    // in the middle of reading the file.
+    std::atomic<bool> threadShouldStop;
+
+    const QString filename;
+};
+
+#endif